@@ -105,6 +105,11 @@ def save_mesh(filepath, bm, use_ascii, use_normals, use_uv, use_color):
         fw(b"format %s 1.0\n" % file_format)
         fw(b"comment Created by Blender %s - www.blender.org\n" %
             bpy.app.version_string.encode("utf-8"))
+        if ply_verts:
+            # allows lightwave to load meshes lazily (only when first hit by a ray)
+            lo = [min(v.co[i] for v, _, _, _ in ply_verts) for i in range(3)]
+            hi = [max(v.co[i] for v, _, _, _ in ply_verts) for i in range(3)]
+            fw(b"comment bounds %.9g %.9g %.9g %.9g %.9g %.9g\n" % (*lo, *hi))
 
         fw(b"element vertex %d\n" % len(ply_verts))
         fw(
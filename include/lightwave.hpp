@@ -10,11 +10,13 @@
 #include <lightwave/core.hpp>
 #include <lightwave/logger.hpp>
 #include <lightwave/math.hpp>
+#include <lightwave/distribution.hpp>
 #include <lightwave/properties.hpp>
 #include <lightwave/registry.hpp>
 
 // MARK: - utilities
 #include <lightwave/iterators.hpp>
+#include <lightwave/memory.hpp>
 #include <lightwave/parallel.hpp>
 #include <lightwave/streaming.hpp>
 #include <lightwave/warp.hpp>
@@ -23,10 +25,12 @@
 #include <lightwave/bsdf.hpp>
 #include <lightwave/camera.hpp>
 #include <lightwave/emission.hpp>
+#include <lightwave/film.hpp>
 #include <lightwave/image.hpp>
 #include <lightwave/instance.hpp>
 #include <lightwave/integrator.hpp>
 #include <lightwave/light.hpp>
+#include <lightwave/medium.hpp>
 #include <lightwave/postprocess.hpp>
 #include <lightwave/sampler.hpp>
 #include <lightwave/shape.hpp>
@@ -18,6 +18,10 @@ struct BsdfSample {
     /// @brief The weight of the sample, given by @code cos(theta) * B(wi, wo) /
     /// p(wi) @endcode
     Color weight;
+    /// @brief The probability density of sampling @c wi (in solid angle), or
+    /// infinity if @c wi was chosen from a Dirac delta distribution (e.g., by
+    /// perfectly specular materials).
+    float pdf;
 
     /// @brief Return an invalid sample, used to denote that sampling has
     /// failed.
@@ -25,9 +29,14 @@ struct BsdfSample {
         return {
             .wi     = Vector(0),
             .weight = Color(0),
+            .pdf    = 0,
         };
     }
 
+    /// @brief Tests whether the sample was chosen from a Dirac delta
+    /// distribution, which cannot be found by light sampling.
+    bool isDelta() const { return std::isinf(pdf); }
+
     /// @brief Tests whether the sample is invalid (i.e., sampling has failed).
     bool isInvalid() const { return weight == Color(0); }
 };
@@ -37,11 +46,15 @@ struct BsdfEval {
     /// @brief The value of the Bsdf, given by @code cos(theta) * B(wi, wo)
     /// @endcode
     Color value;
+    /// @brief The probability density of @ref Bsdf::sample choosing @c wi (in
+    /// solid angle), needed to weight light samples against Bsdf samples.
+    float pdf;
 
     /// @brief Indicates the the Bsdf is zero for the given pair of directions.
     static BsdfEval invalid() {
         return {
             .value = Color(0),
+            .pdf   = 0,
         };
     }
 
@@ -78,6 +91,18 @@ public:
     virtual BsdfSample sample(const Point2 &uv, const Vector &wo,
                               Sampler &rng) const = 0;
     virtual Color albedo(const Point2 &uv){NOT_IMPLEMENTED}
+    /**
+     * @brief Reports whether the Bsdf is Lambertian, i.e., given by its albedo divided by pi for all pairs of
+     * directions, which allows integrators to work with irradiance instead of radiance.
+     */
+    virtual bool isDiffuse() const { return false; }
+    /**
+     * @brief Returns the index of refraction of the side below the surface relative to the side above it, for Bsdfs
+     * that refract light (and one for all others).
+     * Refraction scales radiance by the squared ratio of the indices, which the weights of @ref sample include, but
+     * which does not apply to importance (see @ref Intersection::sampleAdjointBsdf ).
+     */
+    virtual float ior(const Point2 &uv) const { return 1; }
 };
 
 } // namespace lightwave
@@ -22,6 +22,39 @@ struct CameraSample {
     Color weight;
 };
 
+/**
+ * @brief The result of connecting a point in the scene to a Camera using @ref Camera::sampleImportance , which is
+ * used to add the contribution of light paths to the image (e.g., for bidirectional path tracing).
+ */
+struct ImportanceSample {
+    /// @brief The normalized image coordinates (see @ref Camera::sample ) at which the point appears.
+    Point2 normalized;
+    /// @brief The direction vector, pointing from the query point towards the camera.
+    Vector wi;
+    /// @brief The distance from the query point to the sampled point on the camera.
+    float distance;
+    /**
+     * @brief The weight of the sample, given by @code We(-wi) / p(wi) @endcode , where the importance @c We is
+     * normalized such that light arriving uniformly over the entire image contributes the same to every pixel.
+     */
+    Color weight;
+
+    /// @brief Return an invalid sample, used to denote that the point cannot be seen by the camera.
+    static ImportanceSample invalid() {
+        return {
+            .normalized = Point2(),
+            .wi = Vector(),
+            .distance = 0,
+            .weight = Color(),
+        };
+    }
+
+    /// @brief Tests whether the sample is invalid (i.e., the point cannot be seen by the camera).
+    bool isInvalid() const {
+        return weight == Color(0);
+    }
+};
+
 /// @brief A Camera, representing the relationship between pixel coordinates and rays.
 class Camera : public Object {
 protected:
@@ -60,6 +93,21 @@ public:
      * @param rng A random number generator used to steer the sampling.
      */
     virtual CameraSample sample(const Point2 &normalized, Sampler &rng) const = 0;
+
+    /**
+     * @brief Samples a point on the camera that sees the given point in world space coordinates, which fails if the
+     * point lies outside of the image.
+     * @param origin The point in the scene that should be connected to the camera.
+     * @param rng A random number generator used to steer the sampling.
+     */
+    virtual ImportanceSample sampleImportance(const Point &origin, Sampler &rng) const NOT_IMPLEMENTED
+
+    /**
+     * @brief Returns the probability density (in solid angle) of @ref sample generating the direction of the given
+     * ray in world space coordinates, given its origin on the camera, for normalized coordinates that are uniformly
+     * distributed over the image.
+     */
+    virtual float pdfDirection(const Ray &ray) const NOT_IMPLEMENTED
 };
 
 }
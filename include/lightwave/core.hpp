@@ -118,6 +118,8 @@ struct DirectLightSample;
 struct DirectLightEval;
 class BackgroundLight;
 struct BackgroundLightEval;
+class Medium;
+struct MediumSample;
 
 /// @brief The base class used by all objects in lightwave.
 class Object {
@@ -0,0 +1,209 @@
+/**
+ * @file distribution.hpp
+ * @brief Contains discrete and piecewise-constant probability distributions that can be sampled efficiently.
+ */
+
+#pragma once
+
+#include <lightwave/core.hpp>
+#include <lightwave/math.hpp>
+
+#include <algorithm>
+#include <vector>
+
+namespace lightwave {
+
+/**
+ * @brief A discrete distribution over indices, with probabilities proportional to a list of weights, that can be
+ * sampled in constant time using Walker's alias method.
+ * Every index owns a bin of equal probability, which is split between the index itself and one other index (its
+ * alias), so that sampling only needs to pick a bin and decide between its two indices.
+ * @see "A Linear Algorithm For Generating Random Numbers With a Given Distribution" (Vose, 1991)
+ */
+class AliasTable {
+    struct Bin {
+        /// @brief The probability of keeping the index of the bin (rather than using its alias).
+        float threshold;
+        /// @brief The index that is used otherwise.
+        int alias;
+        /// @brief The probability of sampling the index of the bin.
+        float pmf;
+    };
+
+    std::vector<Bin> m_bins;
+
+public:
+    AliasTable() = default;
+
+    /// @brief Builds the table for the given (non-negative) weights, which fall back to uniform if all are zero.
+    explicit AliasTable(const std::vector<float> &weights) {
+        const int n = int(weights.size());
+        m_bins.resize(n);
+        if (n == 0) return;
+
+        double total = 0;
+        for (float weight : weights)
+            total += std::max(weight, 0.f);
+
+        // the weight of each index relative to the average, which is one for bins that need no alias
+        std::vector<double> scaled(n);
+        std::vector<int> small, large;
+        for (int i = 0; i < n; i++) {
+            const double pmf = total > 0 ? std::max(weights[i], 0.f) / total : 1.0 / n;
+            m_bins[i].pmf = float(pmf);
+            scaled[i]     = pmf * n;
+            (scaled[i] < 1 ? small : large).push_back(i);
+        }
+
+        // fill up bins with too little weight using bins with too much weight
+        while (!small.empty() && !large.empty()) {
+            const int under = small.back();
+            small.pop_back();
+            const int over = large.back();
+
+            m_bins[under].threshold = float(scaled[under]);
+            m_bins[under].alias     = over;
+            scaled[over] -= 1 - scaled[under];
+            if (scaled[over] < 1) {
+                large.pop_back();
+                small.push_back(over);
+            }
+        }
+
+        // whatever remains is (up to rounding errors) exactly full
+        for (int i : small)
+            m_bins[i] = { 1, i, m_bins[i].pmf };
+        for (int i : large)
+            m_bins[i] = { 1, i, m_bins[i].pmf };
+    }
+
+    /// @brief Maps a uniform random number in [0,1) to an index.
+    int sample(float u) const {
+        const float scaled = u * m_bins.size();
+        const int bin      = std::min(int(scaled), int(m_bins.size()) - 1);
+        const Bin &entry   = m_bins[bin];
+        return scaled - bin < entry.threshold ? bin : entry.alias;
+    }
+
+    /// @brief Returns the probability of sampling the given index.
+    float pmf(int index) const { return m_bins[index].pmf; }
+
+    /// @brief Returns the number of indices of the distribution.
+    int size() const { return int(m_bins.size()); }
+    /// @brief Reports whether the distribution has no indices.
+    bool empty() const { return m_bins.empty(); }
+};
+
+/**
+ * @brief A piecewise-constant density over [0,1), with values proportional to a list of non-negative weights.
+ * Samples are generated by inverting the cumulative distribution (using binary search), which preserves the
+ * stratification of the input random numbers.
+ */
+class Distribution1D {
+    /// @brief The weights of the pieces.
+    std::vector<float> m_function;
+    /// @brief The cumulative distribution at the start of each piece, followed by one.
+    std::vector<float> m_cdf;
+    /// @brief The integral of the (unnormalized) function over [0,1).
+    float m_integral = 0;
+
+public:
+    Distribution1D() = default;
+
+    /// @brief Builds the distribution for the given weights, which fall back to uniform if all are zero.
+    explicit Distribution1D(std::vector<float> function) : m_function(std::move(function)) {
+        const int n = int(m_function.size());
+        m_cdf.resize(n + 1);
+        m_cdf[0] = 0;
+
+        double sum = 0;
+        for (int i = 0; i < n; i++) {
+            m_function[i] = std::max(m_function[i], 0.f);
+            sum += m_function[i];
+            m_cdf[i + 1] = float(sum);
+        }
+        m_integral = float(sum / n);
+
+        for (int i = 1; i <= n; i++)
+            m_cdf[i] = sum > 0 ? float(m_cdf[i] / sum) : float(i) / n;
+        m_cdf[n] = 1;
+    }
+
+    /**
+     * @brief Maps a uniform random number in [0,1) to a point in [0,1) distributed according to the density.
+     * @param pdf Receives the density of the returned point.
+     * @param index Receives the index of the piece the returned point lies in.
+     */
+    float sample(float u, float &pdf, int &index) const {
+        // the last piece whose cdf does not exceed u
+        const int n = size();
+        index = int(std::upper_bound(m_cdf.begin(), m_cdf.end(), u) - m_cdf.begin()) - 1;
+        index = std::clamp(index, 0, n - 1);
+
+        pdf = this->pdf(index);
+        const float width = m_cdf[index + 1] - m_cdf[index];
+        const float offset = width > 0 ? (u - m_cdf[index]) / width : 0.5f;
+        return std::min((index + offset) / n, OneMinusEpsilon);
+    }
+
+    /// @brief Returns the density of points within the given piece.
+    float pdf(int index) const {
+        return m_integral > 0 ? m_function[index] / m_integral : 1;
+    }
+
+    /// @brief Returns the integral of the (unnormalized) function over [0,1).
+    float integral() const { return m_integral; }
+    /// @brief Returns the number of pieces.
+    int size() const { return int(m_function.size()); }
+};
+
+/**
+ * @brief A piecewise-constant density over the unit square, with values proportional to a grid of non-negative
+ * weights.
+ * The second coordinate is sampled first using the marginal density of the rows, followed by the first coordinate
+ * using the conditional density within the chosen row.
+ */
+class Distribution2D {
+    /// @brief The density within each row.
+    std::vector<Distribution1D> m_conditional;
+    /// @brief The density of the rows.
+    Distribution1D m_marginal;
+
+public:
+    Distribution2D() = default;
+
+    /// @brief Builds the distribution for a grid of weights, stored row after row.
+    Distribution2D(const std::vector<float> &function, const Point2i &resolution) {
+        m_conditional.reserve(resolution.y());
+        std::vector<float> rows(resolution.y());
+        for (int y = 0; y < resolution.y(); y++) {
+            const auto row = function.begin() + size_t(y) * resolution.x();
+            m_conditional.emplace_back(std::vector<float>(row, row + resolution.x()));
+            rows[y] = m_conditional.back().integral();
+        }
+        m_marginal = Distribution1D(std::move(rows));
+    }
+
+    /// @brief Maps a uniform random point in [0,1)^2 to a point distributed according to the density.
+    Point2 sample(const Point2 &u, float &pdf) const {
+        float pdfs[2];
+        int row, column;
+        const float y = m_marginal.sample(u.y(), pdfs[1], row);
+        const float x = m_conditional[row].sample(u.x(), pdfs[0], column);
+        pdf = pdfs[0] * pdfs[1];
+        return { x, y };
+    }
+
+    /// @brief Returns the density at the given point in [0,1)^2.
+    float pdf(const Point2 &p) const {
+        const int row = std::clamp(int(p.y() * m_marginal.size()), 0, m_marginal.size() - 1);
+        const Distribution1D &conditional = m_conditional[row];
+        const int column = std::clamp(int(p.x() * conditional.size()), 0, conditional.size() - 1);
+        return conditional.pdf(column) * m_marginal.pdf(row);
+    }
+
+    /// @brief Reports whether the distribution has been built.
+    bool empty() const { return m_conditional.empty(); }
+};
+
+}
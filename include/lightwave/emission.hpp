@@ -35,6 +35,11 @@ public:
      * @param wo The outgoing direction light is emitted in, pointing away from the surface, in local coordinates.
      */
     virtual EmissionEval evaluate(const Point2 &uv, const Vector &wo) const = 0;
+    /**
+     * @brief Returns the number of texels the emission varies over, or nothing for emission that is not given by
+     * texels (see @ref Texture::resolution ). Useful to decide how finely the emission needs to be tabulated.
+     */
+    virtual std::optional<Point2i> resolution() const { return std::nullopt; }
 };
 
 }
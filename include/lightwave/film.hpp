@@ -0,0 +1,60 @@
+/**
+ * @file film.hpp
+ * @brief Contains a film that accumulates contributions to arbitrary pixels from many threads at once.
+ */
+
+#pragma once
+
+#include <lightwave/core.hpp>
+#include <lightwave/color.hpp>
+#include <lightwave/math.hpp>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lightwave {
+
+class ThreadPool;
+
+/**
+ * @brief Accumulates contributions ("splats") to arbitrary pixels of an image, as needed by light paths that are
+ * connected to the camera, which can land anywhere in the image regardless of the pixel that is being rendered.
+ * Instead of synchronizing every splat, each thread accumulates into buffers of its own, which are allocated tile by
+ * tile once the thread first splats into a tile. The buffers of all threads are summed up once rendering is done.
+ * Threads outside the pool (such as the one waiting for a parallel loop) share the first buffer, which is locked.
+ */
+class SplatFilm {
+    /// @brief The width and height of the tiles in which buffers are allocated.
+    static constexpr int TileSize = 32;
+
+    /// @brief The tiles of one thread, which are null until the thread first splats into them.
+    struct ThreadBuffer {
+        std::vector<std::unique_ptr<Color[]>> tiles;
+    };
+
+    Point2i m_resolution;
+    /// @brief The pool whose threads splat into this film, stored so that splats need not look up the global pool.
+    ThreadPool *m_pool;
+    /// @brief The number of tiles along each axis.
+    Point2i m_numTiles;
+    /// @brief One buffer for each thread of the pool (see @ref ThreadPool::threadIndex ).
+    std::vector<ThreadBuffer> m_threads;
+    /// @brief Serializes splats into the buffer shared by all threads outside the pool.
+    std::mutex m_sharedMutex;
+
+    /// @brief Adds a contribution to the given pixel of the buffer of a single thread.
+    void splat(ThreadBuffer &buffer, const Point2i &pixel, const Color &value);
+
+public:
+    /// @brief Creates a film of the given resolution for the threads of the global thread pool.
+    explicit SplatFilm(const Point2i &resolution);
+
+    /// @brief Adds a contribution to the given pixel (safe to call concurrently from any thread).
+    void splat(const Point2i &pixel, const Color &value);
+
+    /// @brief Adds all contributions, multiplied by @c scale , to the pixels of the given image.
+    void addTo(Image &image, float scale) const;
+};
+
+}
@@ -14,13 +14,37 @@
 
 namespace lightwave {
 
+/**
+ * @brief An allocator that leaves elements uninitialized when a vector grows, so that memory is not touched by the
+ * thread that resizes the vector, but by the thread that first writes to it (which determines the NUMA node the memory
+ * is placed on).
+ */
+template <typename T>
+struct UninitializedAllocator : std::allocator<T> {
+    template <typename U>
+    struct rebind {
+        using other = UninitializedAllocator<U>;
+    };
+
+    UninitializedAllocator() = default;
+    template <typename U>
+    UninitializedAllocator(const UninitializedAllocator<U> &) {}
+
+    template <typename U>
+    void construct(U *) noexcept {}
+    template <typename U, typename... Args>
+    void construct(U *ptr, Args &&...args) {
+        ::new (static_cast<void *>(ptr)) U(std::forward<Args>(args)...);
+    }
+};
+
 /// @brief An image.
 class Image final : public Object {
     /// @brief The resolution of this image in pixels.
     Point2i m_resolution;
 
     /// @brief A sequence of the pixel colors of this image.
-    std::vector<Color> m_data;
+    std::vector<Color, UninitializedAllocator<Color>> m_data;
 
     /// @brief The folder the image was loaded from or should be stored to.
     std::filesystem::path m_basePath;
@@ -65,6 +89,10 @@ public:
         m_basePath = basePath;
     }
 
+    /// @brief Returns the folder the image will be stored in if no explicit path
+    /// is given.
+    const std::filesystem::path &basePath() const { return m_basePath; }
+
     /// @brief Copies the data and resolution from another image, but leaves all
     /// other attributes the same.
     void copy(const Image &image) {
@@ -82,14 +110,32 @@ public:
 
     /// @brief Changes the resolution and sets all pixels to black.
     void initialize(const Point2i &resolution) {
+        resize(resolution);
+        std::fill(m_data.begin(), m_data.end(), Color());
+    }
+
+    /**
+     * @brief Changes the resolution, but leaves the pixels uninitialized.
+     * Unlike @ref initialize , this does not touch the memory of the image, which allows the threads that will write
+     * the pixels to place the memory on their NUMA node.
+     * @warning All pixels need to be written before they are read.
+     */
+    void resize(const Point2i &resolution) {
         m_resolution = resolution;
         m_data.resize(resolution.x() * resolution.y());
-        std::fill(m_data.begin(), m_data.end(), Color());
     }
 
     /// @brief Saves the image as an EXR file at a given path.
     void saveAt(const std::filesystem::path &path) const;
 
+    /**
+     * @brief Saves several images of the same resolution as the layers of a single EXR file at a given path.
+     * Each layer is given by its name and image, and the layer with an empty name becomes the main image that viewers
+     * show by default.
+     */
+    static void saveLayers(const std::filesystem::path &path,
+                           const std::vector<std::pair<std::string, const Image *>> &layers);
+
     /// @brief Saves the image at its default path, given by the @ref basePath
     /// of this image and its @ref id .
     void save() const { saveAt(m_basePath / (id() + ".exr")); }
@@ -6,6 +6,7 @@
 #pragma once
 
 #include <lightwave/core.hpp>
+#include <lightwave/medium.hpp>
 #include <lightwave/shape.hpp>
 
 namespace lightwave {
@@ -28,24 +29,44 @@ class Instance : public Shape {
     ref<Bsdf> m_bsdf;
     /// @brief The distribution of light the shape should emit (can be null for non-emissive objects).
     ref<Emission> m_emission;
+    /// @brief The participating medium that fills the box [-1,-1,-1]..[+1,+1,+1] in object coordinates (can be null).
+    ref<Medium> m_medium;
     /// @brief The transformation applied to the shape, leading from object coordinates to world coordinates.
     ref<Transform> m_transform;
     /// @brief Flip the normal direction, used to correct for the change of handedness in case the transformation mirrors the object.
     bool m_flipNormal;
     /// @brief Tracks whether this instance has been added to the scene, i.e., could be hit by ray tracing.
     bool m_visible;
+    /// @brief Tracks whether points on this instance are sampled by area, see @ref Shape::markAsSampled .
+    bool m_sampled;
+    /// @brief The number of instances created so far, used to hand out indices.
+    inline static int s_instanceCount = 0;
+    /// @brief The order in which this instance has been created while loading the scene.
+    int m_index;
     
     /// @brief Transforms the frame from object coordinates to world coordinates.
     inline void transformFrame(SurfaceEvent &surf) const;
+    /// @brief Transforms a sample from object coordinates to world coordinates, including its density.
+    void transformSample(AreaSample &sample) const;
+    /// @brief Returns the factor by which the transformation scales areas on a surface with the given world normal.
+    float areaScale(const Vector &normal) const;
+    /**
+     * @brief Transforms a surface point from world coordinates to object coordinates, where its density is scaled by the
+     * given factor (see @ref areaScale ).
+     */
+    SurfaceEvent toLocal(const SurfaceEvent &surface, float scale) const;
 
 public:
     Instance(const Properties &properties) 
-        : m_light(nullptr) {
-        m_shape = properties.getChild<Shape>();
+        : m_light(nullptr), m_index(s_instanceCount++) {
+        m_medium = properties.getOptionalChild<Medium>();
+        // instances that only place a medium do not need a surface
+        m_shape = m_medium ? properties.getOptionalChild<Shape>() : properties.getChild<Shape>();
         m_bsdf = properties.getOptionalChild<Bsdf>();
         m_emission = properties.getOptionalChild<Emission>();
         m_transform = properties.getOptionalChild<Transform>();
         m_visible = false;
+        m_sampled = false;
         
         m_flipNormal = false;
         if (m_transform && m_transform->determinant() < 0) {
@@ -59,6 +80,12 @@ public:
     Emission *emission() const { return m_emission.get(); }
     /// @brief Returns the light object that contains this instance (or null if this instance is not part of any area light).
     Light *light() const { return m_light; }
+    /// @brief Returns the order in which this instance has been created, which identifies it (e.g., in ID images).
+    int index() const { return m_index; }
+    /// @brief Returns the participating medium placed by this instance (can be null).
+    Medium *medium() const { return m_medium.get(); }
+    /// @brief Returns the shape placed by this instance (can be null for instances that only place a medium).
+    Shape *shape() const { return m_shape.get(); }
 
     /// @brief Returns whether this instance has been added to the scene, i.e., could be hit by ray tracing.
     bool isVisible() const { return m_visible; }
@@ -66,6 +93,11 @@ public:
     void markAsVisible() override {
         m_visible = true;
     }
+    /// @brief Sets the sampled flag of this instance to true, and marks the wrapped shape as sampled.
+    void markAsSampled() override;
+    bool containsMedia() const override {
+        return m_medium || (m_shape && m_shape->containsMedia());
+    }
 
     /// @brief Sets the parent light object that contains this instance.
     void setLight(Light *light) {
@@ -92,6 +124,26 @@ public:
      * @param rng A random number generator used to steer sampling decisions.
      */
     AreaSample sampleArea(Sampler &rng) const override;
+    /// @brief Samples a point in world coordinates that is likely to be visible from the given origin (see @ref Shape::sampleArea ).
+    AreaSample sampleArea(const Point &origin, Sampler &rng) const override;
+    /// @brief Returns the density (in world space area) of sampling the given surface point in world coordinates.
+    float areaPdf(const SurfaceEvent &surface) const override;
+    /// @brief Returns the density (in world space area) of sampling the given surface point from the given origin.
+    float areaPdf(const Point &origin, const SurfaceEvent &surface) const override;
+    /**
+     * @brief Returns the surface area in world space.
+     * @note For transformations that do not scale uniformly, this is approximated by scaling with the cube root of the
+     * change in volume. This only affects how often groups pick the instance, as densities account for the
+     * transformation at each point.
+     */
+    float area() const override;
+    /// @brief Returns the point in world coordinates that has the given texture coordinates (see @ref Shape::sampleTexture ).
+    AreaSample sampleTexture(const Point2 &uv) const override;
+
+    /// @brief Samples the distance at which a ray in world coordinates scatters within the medium of this instance.
+    MediumSample sampleMedium(const Ray &ray, float tMax, Sampler &rng) const;
+    /// @brief Estimates the transmittance of the medium of this instance along a ray in world coordinates.
+    float transmittance(const Ray &ray, float tMax, Sampler &rng) const;
 
     /// @brief Returns a textual representation of this image.
     std::string toString() const override {
@@ -100,11 +152,13 @@ public:
             "  shape = %s,\n"
             "  bsdf = %s,\n"
             "  emission = %s,\n"
+            "  medium = %s,\n"
             "  transform = %s,\n"
             "]",
             indent(m_shape),
             indent(m_bsdf),
             indent(m_emission),
+            indent(m_medium),
             indent(m_transform)
         );
     }
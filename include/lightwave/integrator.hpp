@@ -10,10 +10,16 @@
 #include <lightwave/math.hpp>
 #include <lightwave/sampler.hpp>
 #include <lightwave/image.hpp>
+#include <lightwave/parallel.hpp>
 #include <lightwave/scene.hpp>
+#include <lightwave/memory.hpp>
+
+#include <functional>
 
 namespace lightwave {
 
+class Streaming;
+
 /**
  * @brief Integrators are rendering algorithms that take a scene and produce an image from them (e.g., using path tracing).
  * The term integrator refers to the key challenge of simulating light transport, namely solving the reflected radiance integral.
@@ -23,6 +29,27 @@ namespace lightwave {
 class Integrator : public Executable {
 public:
     Integrator(const Properties &properties) {
+        if (properties.has("threads")) {
+            // the number of threads to render with (zero uses all available cores), unless overridden on the command line
+            ThreadPool::setThreadCount(properties.get<int>("threads"));
+        }
+    }
+};
+
+/// @brief The options of the rendering loop of @ref SamplingIntegrator that an integrator supports.
+struct SamplingOptions {
+    /// @brief Whether the image can be rendered one sample per pixel at a time (@c progressive ).
+    bool progressive = false;
+    /// @brief Whether rendering can be stopped after a given wall-clock time (@c timeBudget ).
+    bool timeBudget = false;
+    /// @brief Whether pixels can stop sampling early once they have converged (@c adaptive and its parameters).
+    bool adaptive = false;
+    /// @brief Whether the order in which tiles are rendered can be chosen (@c tileOrder ).
+    bool tileOrder = false;
+
+    /// @brief The options of the rendering loop of @ref SamplingIntegrator::execute , which supports all of them.
+    static SamplingOptions all() {
+        return { .progressive = true, .timeBudget = true, .adaptive = true, .tileOrder = true };
     }
 };
 
@@ -30,6 +57,15 @@ public:
  * @brief A sampling integrator uses random numbers to solve the integration problem, e.g., by using Monte Carlo integration.
  */
 class SamplingIntegrator : public Integrator {
+public:
+    /// @brief The order in which the tiles of the image are rendered.
+    enum class TileOrder {
+        /// @brief Starts in the center of the image and spirals outwards, which gives early feedback in the viewer.
+        Spiral,
+        /// @brief Starts with the tiles that are estimated to be the most expensive (using a sparse prepass).
+        Cost,
+    };
+
 protected:
     /// @brief The random number generator used to steer sampling decisions.
     ref<Sampler> m_sampler;
@@ -37,15 +73,112 @@ protected:
     ref<Image> m_image;
     /// @brief The scene that should be rendered.
     ref<Scene> m_scene;
+    /// @brief The order in which the tiles of the image are rendered.
+    TileOrder m_tileOrder;
+    /// @brief Whether to render the entire image one sample per pixel at a time (see @ref executeProgressive ).
+    bool m_progressive;
+    /// @brief For progressive rendering: the wall-clock time in seconds after which rendering stops (zero for no limit).
+    float m_timeBudget;
+    /**
+     * @brief Whether to stop sampling pixels early once their estimate has converged.
+     * Pixels are sampled in batches, and after each batch the relative standard error of the mean luminance is
+     * estimated from the running variance of the samples. Sampling stops once it is below @c m_adaptiveThreshold , or
+     * the sample count of the sampler (which then acts as maximum) has been reached. Not used for progressive rendering.
+     */
+    bool m_adaptive;
+    /// @brief For adaptive sampling: the relative error below which a pixel is considered converged.
+    float m_adaptiveThreshold;
+    /// @brief For adaptive sampling: the number of samples taken before the error is (re-)evaluated.
+    int m_adaptiveBatch;
+    /// @brief For adaptive sampling: whether to save the sample count and error of each pixel as additional images.
+    bool m_adaptiveMaps;
 
-public:
-    SamplingIntegrator(const Properties &properties)
-    : Integrator(properties) {
-        m_sampler = properties.getChild<Sampler>();
-        m_image = properties.getOptionalChild<Image>();
-        m_scene = properties.getChild<Scene>();
+    /**
+     * @brief Renders the image in passes of one sample per pixel each, accumulating the results and regularly sending
+     * the running average to the viewer. Rendering stops once the sample count of the sampler has been reached, the
+     * time budget has been exceeded, or the user has pressed Ctrl+C. In the latter two cases, the current pass is
+     * still completed, so that all pixels have the same number of samples.
+     */
+    void executeProgressive();
+
+    /// @brief The samples of a pixel taken by @ref samplePixel .
+    struct PixelEstimate {
+        /// @brief The mean of the samples.
+        Color mean;
+        /// @brief The number of samples taken.
+        int samples;
+        /// @brief For adaptive sampling: the relative standard error of the mean luminance (zero otherwise).
+        float error;
+    };
+
+    /**
+     * @brief Renders all pixels of the image by calling @c renderPixel for each of them from parallel threads, each of
+     * which has a sampler of its own. The image is split into tiles that are started in the given order, preferably by
+     * threads of the NUMA node whose horizontal band of the image they fall into. Threads that have run out of tiles
+     * help out with the rows of the tiles that are still in progress. Every finished tile is passed to @c tileDone .
+     */
+    void renderTiles(TileOrder order, const std::function<void(const Point2i &pixel, Sampler &sampler)> &renderPixel,
+                     const std::function<void(const Bounds2i &tile)> &tileDone = nullptr);
+
+    /**
+     * @brief Takes the samples of a pixel, by calling @c sample with the sampler seeded for the pixel and the index of
+     * each sample. Without adaptive sampling, this takes the sample count of the sampler. Otherwise, the samples are
+     * taken in batches until the relative standard error of the mean luminance, estimated from the running variance of
+     * the samples, falls below @c m_adaptiveThreshold (or the sample count of the sampler has been reached).
+     */
+    template <typename F>
+    PixelEstimate samplePixel(const Point2i &pixel, Sampler &sampler, F sample) const {
+        const int maxSamples = m_sampler->samplesPerPixel();
+        // without adaptive sampling, all samples of a pixel are taken in a single batch
+        const int batchSize = m_adaptive ? m_adaptiveBatch : maxSamples;
+        auto &arena = MemoryArena::forThread();
+
+        Color sum;
+        int count = 0;
+        // running mean and variance (Welford's algorithm) of the luminance, used for adaptive sampling
+        float mean = 0, m2 = 0, error = 0;
+        while (count < maxSamples) {
+            const int batchEnd = std::min(count + batchSize, maxSamples);
+            for (; count < batchEnd; count++) {
+                sampler.seed(pixel, count);
+                const Color value = sample(sampler, count);
+                arena.reset();
+                sum += value;
+
+                if (m_adaptive) {
+                    const float delta = value.luminance() - mean;
+                    mean += delta / (count + 1);
+                    m2 += delta * (value.luminance() - mean);
+                }
+            }
+
+            if (!m_adaptive) break;
+            // the variance cannot be estimated from a single sample (e.g., with one sample per pixel)
+            if (count < 2) continue;
+            // the relative standard error of the mean (offset to avoid spending samples on dark pixels)
+            error = std::sqrt(m2 / ((count - 1) * float(count))) / (mean + 1e-3f);
+            if (error < m_adaptiveThreshold) break;
+        }
+        return { .mean = (1.0f / count) * sum, .samples = count, .error = error };
     }
 
+    /**
+     * @brief Renders all pixels of the image with @ref renderTiles in the order of @c tileOrder , writing the mean of
+     * the estimate returned by @c renderPixel (usually taken with @ref samplePixel ) into the image, and sending
+     * finished tiles to the viewer through @c stream . For adaptive sampling, the average sample count is logged, and the sample count and
+     * error of each pixel are saved next to the image if requested. The image itself is not saved.
+     */
+    void renderPixels(Streaming &stream,
+                      const std::function<PixelEstimate(const Point2i &pixel, Sampler &sampler)> &renderPixel);
+
+public:
+    /**
+     * @brief Reads the options of the rendering loop, and warns about those that are given but have no effect.
+     * @param supported The options that the integrator supports. Integrators that override @ref execute with their
+     * own rendering loop pass the options it implements, so that they are not silently ignored.
+     */
+    SamplingIntegrator(const Properties &properties, const SamplingOptions &supported = SamplingOptions::all());
+
     /// @brief Sets the output image that should be populated by rendering.
     void setImage(const ref<Image> &image) { m_image = image; }
 
@@ -9,6 +9,8 @@
 #include <lightwave/color.hpp>
 #include <lightwave/math.hpp>
 
+#include <optional>
+
 namespace lightwave {
 
 /// @brief The result of sampling a light from a given query point using @ref Light::sampleDirect .
@@ -19,6 +21,20 @@ struct DirectLightSample {
     Color weight;
     /// @brief The distance from the query point to the sampled point on the light source.
     float distance;
+    /**
+     * @brief The probability density of sampling @c wi (in solid angle), or infinity for lights that can only be
+     * reached by light sampling (e.g., point lights or directional lights).
+     */
+    float pdf;
+    /// @brief The surface normal at the sampled point, or zero for lights that do not lie on a surface.
+    Vector normal = Vector(0);
+    /**
+     * @brief For lights on a surface, the density of @ref Light::sampleEmission starting light paths at the sampled
+     * point (in area, see @ref EmissionSample::pdfPosition ).
+     */
+    float pdfPosition = 0;
+    /// @brief For lights on a surface, the texture coordinates of the sampled point (which @c pdfPosition can depend on).
+    Point2 uv = Point2(0);
 
     /// @brief Return an invalid sample, used to denote that sampling has failed.
     static DirectLightSample invalid() {
@@ -26,15 +42,83 @@ struct DirectLightSample {
             .wi = Vector(),
             .weight = Color(),
             .distance = 0,
+            .pdf = 0,
         };
     }
 
+    /// @brief Tests whether the light is a Dirac delta distribution, which cannot be hit by Bsdf sampling.
+    bool isDelta() const { return std::isinf(pdf); }
+
     /// @brief Tests whether the sample is invalid (i.e., sampling has failed). 
     bool isInvalid() const {
         return weight == Color(0);
     }
 };
 
+/**
+ * @brief The result of sampling a ray of light leaving a light source using @ref Light::sampleEmission , which is
+ * the starting point of light paths (e.g., for bidirectional path tracing).
+ * Lights that are infinitely far away emit from a disk that covers the scene, facing the emitted direction.
+ */
+struct EmissionSample {
+    /// @brief The ray along which light is emitted, starting on the light source.
+    Ray ray;
+    /// @brief The weight of the sample, given by @code Le * |cos(theta)| / (pdfPosition * pdfDirection) @endcode
+    Color weight;
+    /// @brief The surface normal at the origin of the ray, or zero for lights without surface (e.g., point lights).
+    Vector normal;
+    /// @brief The probability density of sampling the origin (in area), or one for Dirac delta positions.
+    float pdfPosition;
+    /// @brief The probability density of sampling the direction (in solid angle), or one for Dirac delta directions.
+    float pdfDirection;
+    /// @brief For lights on a surface, the texture coordinates of the origin (which @c pdfPosition can depend on).
+    Point2 uv = Point2(0);
+
+    /// @brief Return an invalid sample, used to denote that sampling has failed.
+    static EmissionSample invalid() {
+        return {
+            .ray = Ray(),
+            .weight = Color(),
+            .normal = Vector(),
+            .pdfPosition = 0,
+            .pdfDirection = 0,
+        };
+    }
+
+    /// @brief Tests whether the sample is invalid (i.e., sampling has failed).
+    bool isInvalid() const {
+        return weight == Color(0);
+    }
+};
+
+/// @brief The probability densities of @ref Light::sampleEmission generating a given ray.
+struct EmissionPdf {
+    /// @brief The density of the origin (in area), see @ref EmissionSample::pdfPosition .
+    float position;
+    /// @brief The density of the direction (in solid angle), see @ref EmissionSample::pdfDirection .
+    float direction;
+};
+
+/**
+ * @brief Bounds the positions and emission directions of a light source, which allows light hierarchies to estimate
+ * how much a light (or a group of lights) can at most contribute to a given point.
+ * @see "Importance Sampling of Many Lights with Adaptive Tree Splitting" (Conty Estevez and Kulla, 2018)
+ */
+struct LightBounds {
+    /// @brief The region of space the light emits from.
+    Bounds bounds;
+    /// @brief The total power emitted by the light, as scalar (e.g., its luminance).
+    float power;
+    /// @brief The central direction of the cone of surface normals of the light.
+    Vector axis;
+    /// @brief The cosine of the angle by which normals can deviate from @c axis (-1 if they cover the entire sphere).
+    float cosThetaO;
+    /// @brief The cosine of the angle beyond the normals into which light is emitted (0 for a cosine falloff).
+    float cosThetaE;
+    /// @brief Whether light is emitted on both sides of the surface (i.e., also around @c -axis ).
+    bool twoSided;
+};
+
 /**
  * @brief A light source that can be sampled for direct connections.
  * Some light sources can also be intersected by rays (e.g., area lights or the background light),
@@ -49,14 +133,72 @@ public:
      */
     virtual DirectLightSample sampleDirect(const Point &origin, Sampler &rng) const = 0;
 
+    /**
+     * @brief Evaluates the light that arrives at a point from a given point on the light source (e.g., one that
+     * @ref sampleDirect has found for a different query point), which allows light samples to be shared between
+     * nearby points (e.g., for reservoir resampling).
+     * The result is measured per unit of the domain the light is sampled in: per area for lights with a surface, per
+     * solid angle for lights that are infinitely far away, and as a whole for Dirac deltas (e.g., point lights), and is
+     * zero for lights that do not support this.
+     * @param origin The light receiving point.
+     * @param wi The direction from the receiving point towards the point on the light.
+     * @param distance The distance to the point on the light (infinity for lights that are infinitely far away).
+     * @param rng A random number generator used to steer ray tracing decisions (e.g., to find a point on a surface).
+     */
+    virtual Color evaluateDirect(const Point &origin, const Vector &wi, float distance, Sampler &rng) const {
+        return Color(0);
+    }
+
+    /**
+     * @brief Returns the density (in solid angle) of @ref sampleDirect choosing a point on the light that has been
+     * hit by a ray from the given origin, which is needed to weight light found by Bsdf sampling against light
+     * sampling. Lights that are infinitely far away report this through @ref BackgroundLight::evaluate instead.
+     */
+    virtual float directPdf(const Point &origin, const Intersection &its) const { return 0; }
+
     /// @brief Returns whether this light source can be hit by rays (i.e., has an area that has been placed within the scene).
     virtual bool canBeIntersected() const { return false; }
+
+    /// @brief Returns the spatial and directional bounds of the emission, or nothing for lights that are infinitely far away.
+    virtual std::optional<LightBounds> bounds() const { return std::nullopt; }
+
+    /**
+     * @brief Estimates the total power emitted into the scene, as scalar (e.g., luminance), which is used to pick
+     * bright lights more often than dim ones.
+     * @param sceneBounds The bounds of the scene geometry, which determine how much of the power of lights that are
+     * infinitely far away actually reaches the scene.
+     */
+    virtual float totalPower(const Bounds &sceneBounds) const NOT_IMPLEMENTED
+
+    /**
+     * @brief Samples a ray of light leaving the light source, which fails for lights that do not support starting
+     * light paths.
+     * @param sceneBounds The bounds of the scene geometry, which lights that are infinitely far away emit towards.
+     * @param rng A random number generator used to steer the sampling.
+     */
+    virtual EmissionSample sampleEmission(const Bounds &sceneBounds, Sampler &rng) const {
+        return EmissionSample::invalid();
+    }
+
+    /**
+     * @brief Returns the densities of @ref sampleEmission generating the given ray.
+     * For lights that are infinitely far away, only the direction of the ray matters, and the position density refers
+     * to the disk that covers the scene.
+     * @param surface The point on the light at the origin of the ray, whose normal is that of the surface (see
+     * @ref EmissionSample::normal ), and whose pdf is the density of the point as found by intersection or reported by
+     * sampling (see @ref EmissionSample::pdfPosition and @ref DirectLightSample::pdfPosition ).
+     */
+    virtual EmissionPdf emissionPdf(const Ray &ray, const SurfaceEvent &surface, const Bounds &sceneBounds) const {
+        return { .position = 0, .direction = 0 };
+    }
 };
 
 /// @brief The result of evaluating a @ref BackgroundLight for a incident direction.
 struct BackgroundLightEval {
     /// @brief The emission strength of the background light in the queried direction.
     Color value;
+    /// @brief The probability density of @ref Light::sampleDirect choosing the queried direction (in solid angle).
+    float pdf;
 };
 
 /**
@@ -77,6 +219,10 @@ public:
         return DirectLightSample::invalid();
     }
 
+    Color evaluateDirect(const Point &origin, const Vector &wi, float distance, Sampler &rng) const override {
+        return evaluate(wi).value;
+    }
+
     bool canBeIntersected() const override { return true; }
 };
 
@@ -50,6 +50,9 @@ static constexpr float Epsilon = 1e-4f;
 /// @brief Infinity
 static constexpr float Infinity = std::numeric_limits<float>::infinity();
 
+/// @brief The largest float below one, used to keep random numbers within [0,1) after remapping them.
+static constexpr float OneMinusEpsilon = 0x1.fffffep-1f;
+
 // MARK: - utility functions
 
 /// @brief Square root function.
@@ -83,6 +86,17 @@ inline float safe_sqrt(float v) { return v <= 0 ? 0 : std::sqrt(v); }
  */
 inline float safe_acos(float v) { return std::acos(clamp(v, -1, +1)); }
 
+/**
+ * @brief The power heuristic for multiple importance sampling, i.e., the weight of a sample drawn with density
+ * @c pdfA when the same point could also have been drawn with density @c pdfB by another strategy.
+ * @note An infinite density denotes a Dirac delta distribution, which the other strategy can never produce.
+ */
+inline float powerHeuristic(float pdfA, float pdfB) {
+    if (std::isinf(pdfA)) return 1;
+    if (std::isinf(pdfB) || pdfA <= 0) return 0;
+    return sqr(pdfA) / (sqr(pdfA) + sqr(pdfB));
+}
+
 // MARK: - points and vectors
 
 #define BUILD1(expr) \
@@ -772,6 +786,15 @@ struct Intersection : public SurfaceEvent {
     BsdfSample sampleBsdf(Sampler &rng) const;
     /// @brief Evaluates the Bsdf of the underlying surface.
     BsdfEval evaluateBsdf(const Vector &wi) const;
+    /**
+     * @brief Evaluates the Bsdf for light that arrives from @c wo and is scattered towards @c wi (times the cosine of
+     * @c wi ), as needed when tracing paths from light sources. This is the Bsdf with swapped directions (the adjoint
+     * Bsdf), which differs for Bsdfs that are not symmetric (e.g., diffuse surfaces reflect light arriving from below
+     * into the upper hemisphere).
+     */
+    Color evaluateAdjointBsdf(const Vector &wi) const;
+    /// @brief Samples the Bsdf for light that arrives from @c wo (see @ref evaluateAdjointBsdf ).
+    BsdfSample sampleAdjointBsdf(Sampler &rng) const;
 };
 
 /// @brief Print a given point to an output stream.
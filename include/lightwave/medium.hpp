@@ -0,0 +1,98 @@
+/**
+ * @file medium.hpp
+ * @brief Contains the Medium interface and related structures.
+ */
+
+#pragma once
+
+#include <lightwave/color.hpp>
+#include <lightwave/core.hpp>
+#include <lightwave/math.hpp>
+#include <lightwave/warp.hpp>
+
+namespace lightwave {
+
+/// @brief The result of sampling the distance a ray travels through a medium using @ref Medium::sampleFreeFlight .
+struct MediumSample {
+    /// @brief The distance at which the ray scatters, or infinity if it passes the medium without scattering.
+    float t;
+    /// @brief The weight of the sample, given by the albedo at the scattering point (one if the ray has passed).
+    Color weight;
+    /// @brief The medium the ray scatters in, or null if it has passed.
+    const Medium *medium;
+
+    /// @brief Returns a sample for rays that pass the medium without scattering.
+    static MediumSample passed() {
+        return {
+            .t      = Infinity,
+            .weight = Color(1),
+            .medium = nullptr,
+        };
+    }
+
+    /// @brief Tests whether the ray scatters within the medium.
+    bool scattered() const { return medium != nullptr; }
+};
+
+/// @brief The result of sampling a phase function using @ref Medium::samplePhase .
+struct PhaseSample {
+    /// @brief The direction vector, pointing away from the scattering point.
+    Vector wi;
+    /// @brief The probability density of sampling @c wi (in solid angle), which equals the phase function.
+    float pdf;
+};
+
+/// @brief Evaluates the Henyey-Greenstein phase function for the cosine between the two directions (pointing away).
+inline float henyeyGreenstein(float cosTheta, float g) {
+    // light continuing in its direction of travel has wo and wi pointing in opposite directions
+    const float denominator = 1 + sqr(g) + 2 * g * cosTheta;
+    return Inv4Pi * (1 - sqr(g)) / (denominator * safe_sqrt(denominator));
+}
+
+/// @brief Samples the Henyey-Greenstein phase function for the outgoing direction @c wo (pointing away).
+inline Vector squareToHenyeyGreenstein(const Point2 &sample, const Vector &wo, float g) {
+    float cosTheta;
+    if (std::abs(g) < 1e-3f) {
+        cosTheta = 1 - 2 * sample.x();
+    } else {
+        cosTheta = -(1 + sqr(g) - sqr((1 - sqr(g)) / (1 + g - 2 * g * sample.x()))) / (2 * g);
+    }
+    const float sinTheta = safe_sqrt(1 - sqr(cosTheta));
+    const float phi = 2 * Pi * sample.y();
+    const Frame frame { wo };
+    return frame.toWorld(Vector(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta));
+}
+
+/**
+ * @brief A participating medium, which absorbs and scatters light that travels through it (e.g., fog or smoke).
+ * Media are attached to instances, which place them in the scene using their transform. Queries are given in the
+ * object coordinates of the instance, with ray directions that are scaled such that the ray parameter @c t measures
+ * distances in world space (i.e., the extinction of a medium is given per unit of world space distance).
+ */
+class Medium : public Object {
+public:
+    /**
+     * @brief Samples the distance at which a ray scatters within the medium (e.g., using delta tracking).
+     * @param origin The origin of the ray in object coordinates.
+     * @param direction The direction of the ray in object coordinates, whose length is the object space distance that
+     * corresponds to a unit of world space distance.
+     * @param tMax The distance at which the ray is blocked by a surface (infinity if it is not).
+     */
+    virtual MediumSample sampleFreeFlight(const Point &origin, const Vector &direction, float tMax,
+                                          Sampler &rng) const = 0;
+    /**
+     * @brief Estimates the fraction of light that passes through the medium along a ray up to a distance without being
+     * absorbed or scattered (e.g., using ratio tracking), with the same conventions as @ref sampleFreeFlight .
+     */
+    virtual float transmittance(const Point &origin, const Vector &direction, float tMax, Sampler &rng) const = 0;
+
+    /**
+     * @brief Evaluates the phase function for a pair of directions in world space, both pointing away from the
+     * scattering point.
+     */
+    virtual float evaluatePhase(const Vector &wo, const Vector &wi) const = 0;
+    /// @brief Samples a direction proportional to the phase function, for the given direction @c wo (pointing away).
+    virtual PhaseSample samplePhase(const Vector &wo, Sampler &rng) const = 0;
+};
+
+}
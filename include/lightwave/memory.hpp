@@ -0,0 +1,125 @@
+/**
+ * @file memory.hpp
+ * @brief Utilities to keep the render path free of heap allocations, which are slow and contend for locks in the
+ * allocator when many threads are rendering.
+ */
+
+#pragma once
+
+#include <lightwave/core.hpp>
+#include <lightwave/logger.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace lightwave {
+
+/**
+ * @brief Suspends counting of heap allocations on the calling thread while in scope (see @ref AssertNoAllocations ).
+ * Use this for allocations on the render path that are known to be amortized, such as assets that are loaded on first
+ * use or scratch memory that grows until it has reached its working size.
+ */
+class AllowAllocations {
+public:
+#ifdef LW_COUNT_ALLOCATIONS
+    AllowAllocations();
+    ~AllowAllocations();
+#else
+    // user-provided, so that scope guards do not count as unused variables
+    AllowAllocations() {}
+    ~AllowAllocations() {}
+#endif
+};
+
+/**
+ * @brief Aborts if the calling thread performs any heap allocation while in scope.
+ * Only active in builds with @c LW_COUNT_ALLOCATIONS , which replace the global @c operator new to count allocations.
+ * In all other builds, this class does nothing and costs nothing.
+ */
+class AssertNoAllocations {
+#ifdef LW_COUNT_ALLOCATIONS
+    const char *m_what;
+    uint64_t m_start;
+
+public:
+    AssertNoAllocations(const char *what);
+    ~AssertNoAllocations();
+#else
+public:
+    AssertNoAllocations(const char *) {}
+#endif
+};
+
+#ifdef LW_COUNT_ALLOCATIONS
+/// @brief Returns the number of (counted) heap allocations the calling thread has performed so far.
+uint64_t threadAllocationCount();
+#endif
+
+/**
+ * @brief A bump allocator for temporary memory, which hands out memory from large blocks that are retained across
+ * @ref reset calls. After a short warm-up, allocating from an arena never touches the heap.
+ * @warning No destructors are run for objects allocated from an arena, so only use it for trivially destructible types.
+ */
+class MemoryArena {
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> m_blocks;
+    /// @brief The block we are currently allocating from.
+    size_t m_current = 0;
+    /// @brief The number of bytes already used in the current block.
+    size_t m_offset = 0;
+    size_t m_blockSize;
+
+public:
+    explicit MemoryArena(size_t blockSize = 64 * 1024) : m_blockSize(blockSize) {}
+
+    MemoryArena(const MemoryArena &) = delete;
+    MemoryArena &operator=(const MemoryArena &) = delete;
+
+    /// @brief Returns uninitialized memory of (at least) @c bytes bytes with the given alignment.
+    void *allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+        while (m_current < m_blocks.size()) {
+            const auto base    = reinterpret_cast<uintptr_t>(m_blocks[m_current].data.get());
+            const size_t start = ((base + m_offset + alignment - 1) & ~(alignment - 1)) - base;
+            if (start + bytes <= m_blocks[m_current].size) {
+                m_offset = start + bytes;
+                return m_blocks[m_current].data.get() + start;
+            }
+
+            // continue with the next (already allocated) block
+            m_current++;
+            m_offset = 0;
+        }
+
+        // the arena is still growing to its working size
+        AllowAllocations growth;
+        const size_t size = std::max(m_blockSize, bytes + alignment);
+        m_blocks.push_back({ std::make_unique<std::byte[]>(size), size });
+        return allocate(bytes, alignment);
+    }
+
+    /// @brief Returns uninitialized memory for @c count elements of type @c T .
+    template <typename T>
+    T *allocate(size_t count = 1) {
+        static_assert(std::is_trivially_destructible_v<T>, "arenas do not run destructors");
+        return static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    /// @brief Makes all memory available again, invalidating all previous allocations.
+    void reset() {
+        m_current = 0;
+        m_offset  = 0;
+    }
+
+    /// @brief Returns the arena of the calling thread, which is reset by the integrator after each sample.
+    static MemoryArena &forThread();
+};
+
+} // namespace lightwave
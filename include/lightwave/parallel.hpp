@@ -5,11 +5,20 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 #include <lightwave/color.hpp>
+#include <lightwave/iterators.hpp>
 #include <lightwave/logger.hpp>
+#include <lightwave/memory.hpp>
 
 #ifdef LW_DEBUG
 // if you feel uncomfortable debugging multi-threaded code, feel free to enable
@@ -19,6 +28,182 @@
 
 namespace lightwave {
 
+/**
+ * @brief A persistent pool of worker threads that executes tasks with work stealing.
+ * Each worker owns a deque of tasks: it pushes and pops work at the back (which keeps recently split, cache-warm work
+ * local), while idle workers steal from the front of other deques (which tends to hand out the largest pieces of work).
+ * Threads that wait for a parallel loop to finish help execute pending tasks in the meantime, so loops may be nested
+ * and the calling thread counts towards the configured number of threads.
+ * Creating threads is only paid once per process, which keeps short jobs (e.g., postprocessing) cheap.
+ */
+class ThreadPool {
+public:
+    /// @brief A unit of work that can be executed by the pool.
+    using Task = std::function<void()>;
+
+    /// @brief Creates a pool in which @c numThreads threads (including the thread waiting for results) execute tasks.
+    explicit ThreadPool(int numThreads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /// @brief Returns the number of threads that execute tasks of this pool, including the waiting thread.
+    int numThreads() const { return int(m_threads.size()) + 1; }
+    /**
+     * @brief Returns an index in [0, numThreads()) that identifies the calling thread, e.g., to access per-thread data.
+     * Workers of this pool are numbered from one, while all other threads (such as the waiting thread) share zero.
+     */
+    int threadIndex() const { return currentWorker() + 1; }
+
+    /// @brief Schedules a task for execution (or executes it immediately if the pool has no worker threads).
+    void enqueue(Task &&task);
+
+    /// @brief Schedules @c f for execution and returns a future that provides its result (or exception).
+    template <class Function>
+    auto submit(Function &&f) -> std::future<std::invoke_result_t<Function>> {
+        using Result = std::invoke_result_t<Function>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(f));
+        auto future = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return future;
+    }
+
+    /**
+     * @brief Invokes @c f for each index in @c range and blocks until all invocations have finished.
+     * The range is recursively split in halves until pieces contain at most @c grainSize indices, which are then
+     * processed sequentially by a single thread. Choose a larger grain size when the work per index is small.
+     * If any invocation throws, the first exception is rethrown once all other invocations have finished.
+     */
+    template <class Function>
+    void parallel_for(const Range &range, Function &&f, int grainSize = 1);
+
+    /// @brief Executes one pending task on the calling thread, returning false if no task was available.
+    bool runPendingTask();
+
+    /**
+     * @brief Returns the pool shared by the entire process, creating it on first use.
+     * Once the pool exists, this only costs a single atomic load, so it may be called on the render path.
+     */
+    static ThreadPool &global();
+    /**
+     * @brief Sets the number of threads used by the global pool (a value of zero or less selects the number of
+     * available cores). The pool is recreated if it already exists, hence this must not be called while it is busy.
+     * Has no effect if the thread count has been fixed by @ref fixThreadCount .
+     */
+    static void setThreadCount(int numThreads);
+    /// @brief Like @ref setThreadCount , but ignores all later requests (used for command line arguments).
+    static void fixThreadCount(int numThreads);
+
+    /// @brief Returns the number of NUMA nodes that worker threads are distributed across.
+    static int numNodes();
+    /// @brief Returns the NUMA node the calling thread is bound to (zero for threads that are not bound to a node).
+    static int currentNode();
+    /**
+     * @brief Runs @c f on a temporary thread bound to the given NUMA node and waits for it to finish.
+     * Since memory is placed on the node of the thread that touches it first, this can be used to create
+     * node-local copies of data.
+     */
+    static void runOnNode(int node, const std::function<void()> &f);
+
+private:
+    /// @brief The tasks owned by one worker.
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    /// @brief A piece of a parallel loop, which splits itself until it is small enough to be executed.
+    template <class Function>
+    struct LoopTask;
+
+    /// @brief The state shared by all pieces of a parallel loop.
+    struct LoopState {
+        std::atomic<int> remaining;
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::exception_ptr error;
+    };
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_threads;
+    /// @brief The number of tasks across all queues, used to let idle workers sleep.
+    std::atomic<int> m_pending { 0 };
+    /// @brief Distributes tasks enqueued by threads outside of the pool across the workers.
+    std::atomic<unsigned> m_nextQueue { 0 };
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeUp;
+    bool m_stop = false;
+
+    void workerLoop(int index);
+    /// @brief Returns the index of the worker of this pool that is running the calling thread, or -1.
+    int currentWorker() const;
+};
+
+template <class Function>
+struct ThreadPool::LoopTask {
+    ThreadPool *pool;
+    std::shared_ptr<LoopState> state;
+    Function *f;
+    int begin, end, grainSize;
+
+    void operator()() {
+        while (end - begin > grainSize) {
+            // hand the upper half to whoever is idle, and keep working on the lower half
+            const int middle = begin + (end - begin) / 2;
+            pool->enqueue(LoopTask { pool, state, f, middle, end, grainSize });
+            end = middle;
+        }
+
+        try {
+            for (int i = begin; i < end; i++)
+                (*f)(i);
+        } catch (...) {
+            std::unique_lock lock { state->mutex };
+            if (!state->error) state->error = std::current_exception();
+        }
+
+        if (state->remaining.fetch_sub(end - begin) == end - begin) {
+            std::unique_lock lock { state->mutex };
+            state->finished.notify_all();
+        }
+    }
+};
+
+template <class Function>
+void ThreadPool::parallel_for(const Range &range, Function &&f, int grainSize) {
+    grainSize = std::max(grainSize, 1);
+    if (range.count() <= 0) return;
+
+#ifndef SINGLE_THREADED
+    if (!m_threads.empty() && range.count() > grainSize) {
+        auto state = std::make_shared<LoopState>();
+        state->remaining = range.count();
+        LoopTask<std::remove_reference_t<Function>> { this, state, &f, *range.begin(), *range.end(), grainSize }();
+
+        // help out with pending tasks until all pieces of the loop have finished
+        while (state->remaining.load() > 0) {
+            if (runPendingTask()) continue;
+            std::unique_lock lock { state->mutex };
+            state->finished.wait_for(lock, std::chrono::milliseconds(1),
+                                     [&]() { return state->remaining.load() == 0; });
+        }
+
+        if (state->error) std::rethrow_exception(state->error);
+        return;
+    }
+#endif
+
+    for (int i : range)
+        f(i);
+}
+
+/// @brief Invokes @c f for each index in @c range using the global thread pool (see @ref ThreadPool::parallel_for ).
+template <class Function>
+void parallel_for(const Range &range, Function &&f, int grainSize = 1) {
+    ThreadPool::global().parallel_for(range, std::forward<Function>(f), grainSize);
+}
+
 /// @brief Invokes @c f for each element of the iterator, parallelized across
 /// all available cores.
 template <class ForwardIt, class UnaryFunction>
@@ -28,37 +213,12 @@ void for_each_parallel(ForwardIt first, ForwardIt last, UnaryFunction f) {
     return;
 #endif
 
-    std::mutex m_lock;
+    // materialize the work items, so that threads can fetch them without synchronization
+    std::vector<std::decay_t<decltype(*first)>> items;
+    for (; first != last; ++first)
+        items.push_back(*first);
 
-    const int numThreads = std::thread::hardware_concurrency();
-    std::vector<std::thread> m_threads;
-    m_threads.reserve(numThreads);
-
-    // build a thread pool
-    for (int i = 0; i < numThreads; i++) {
-        m_threads.emplace_back([&]() {
-            while (true) {
-                m_lock.lock();
-                if (!(first != last)) {
-                    // no more work to do
-                    m_lock.unlock();
-                    break;
-                }
-
-                // grab a work item
-                auto obj = *first;
-                ++first;
-                m_lock.unlock();
-
-                // execute the work item
-                f(obj);
-            }
-        });
-    }
-
-    // wait until all threads have finished
-    for (auto &thread : m_threads)
-        thread.join();
+    parallel_for(Range(0, int(items.size())), [&](int index) { f(items[index]); });
 }
 
 /// @brief Invokes @c f for each element of the iterator, parallelized across
@@ -68,6 +228,33 @@ void for_each_parallel(Iterator it, UnaryFunction f) {
     for_each_parallel(it.begin(), it.end(), f);
 }
 
+/**
+ * @brief Runs an initialization routine exactly once, even if multiple threads request it concurrently.
+ * Threads that arrive while initialization is in progress block until it has completed. Once initialized,
+ * checking the flag only costs a single atomic load, which makes it cheap enough to use on the render path
+ * (e.g., for assets that are only loaded when first accessed).
+ */
+class InitOnce {
+    std::once_flag m_flag;
+    std::atomic<bool> m_done { false };
+
+public:
+    /// @brief Returns whether the initialization routine has already completed.
+    bool isDone() const { return m_done.load(std::memory_order_acquire); }
+
+    /// @brief Invokes @c f unless it has already been invoked (successfully) before.
+    template <class Function>
+    void ensure(Function &&f) {
+        if (isDone()) return;
+        std::call_once(m_flag, [&]() {
+            // one-time initialization is amortized, even if it happens on the render path
+            AllowAllocations initialization;
+            f();
+            m_done.store(true, std::memory_order_release);
+        });
+    }
+};
+
 /// @brief Atomically increment a floating point number.
 inline float atomicAdd(float &dst, float delta) {
 #if defined(__clang__)
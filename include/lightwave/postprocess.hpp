@@ -27,6 +27,9 @@ public:
         m_input = properties.get<Image>("input");
         m_output = properties.getChild<Image>();
     }
+
+    /// @brief Gets the output image that will be produced.
+    const ref<Image> &output() const { return m_output; }
 };
 
 }
@@ -6,6 +6,9 @@
 #pragma once
 
 #include <lightwave/core.hpp>
+#include <lightwave/distribution.hpp>
+
+#include <unordered_map>
 #include <vector>
 
 namespace lightwave {
@@ -16,10 +19,27 @@ struct LightSample {
     const Light *light;
     /// @brief The probability of this light source having been picked.
     float probability;
+
+    /// @brief Tests whether no light could be picked (e.g., because none of them can illuminate the query point).
+    bool isInvalid() const { return light == nullptr; }
 };
 
+class LightBvh;
+
 /// @brief Scenes are the input to rendering algorithms: They contain all geometry, materials, lights and the camera.
 class Scene : public Object {
+public:
+    /// @brief How light sources are picked for light sampling.
+    enum class LightSampling {
+        /// @brief All lights are picked with the same probability.
+        Uniform,
+        /// @brief Lights are picked by traversing a hierarchy of lights, based on how much they can contribute.
+        Bvh,
+        /// @brief Lights are picked with probability proportional to their (estimated) total power.
+        Power,
+    };
+
+private:
     /// @brief The camera from which the image is to be rendered.
     ref<Camera> m_camera;
     /// @brief The geometry of the scene that should be rendered (typically an acceleration structure with instances in it).
@@ -31,6 +51,19 @@ class Scene : public Object {
      * @note Emissive objects will only be part of this list if explicitly requested (i.e., an AreaLight has been created for them).
      */
     std::vector<ref<Light>> m_lights;
+    /// @brief How light sources are picked for light sampling.
+    LightSampling m_lightSampling;
+    /// @brief The hierarchy over all lights, if lights are sampled using @ref LightSampling::Bvh .
+    ref<LightBvh> m_lightBvh;
+    /// @brief The distribution of the power of all lights, if lights are sampled using @ref LightSampling::Power .
+    AliasTable m_lightPower;
+    /// @brief The index of each light in @c m_lights , to look up selection probabilities.
+    std::unordered_map<const Light *, int> m_lightIndices;
+    /// @brief The instances of the scene that place participating media.
+    std::vector<ref<Instance>> m_media;
+
+    /// @brief Picks a light with uniform probability or proportional to power, depending on the light sampling mode.
+    LightSample pickLight(Sampler &rng) const;
 
 public:
     Scene(const Properties &properties);
@@ -46,15 +79,36 @@ public:
     /// @brief Evaluates the background illumination for a given direction pointing away from the scene.
     BackgroundLightEval evaluateBackground(const Vector &direction) const;
 
+    /// @brief Reports whether the scene contains participating media.
+    bool hasMedia() const { return !m_media.empty(); }
+    /**
+     * @brief Samples the distance at which a ray scatters within any of the media of the scene before reaching
+     * @c tMax (e.g., the distance to the closest surface).
+     */
+    MediumSample sampleMedium(const Ray &ray, float tMax, Sampler &rng) const;
+    /// @brief Estimates the fraction of light that passes through all media of the scene along a ray up to @c tMax .
+    float transmittance(const Ray &ray, float tMax, Sampler &rng) const;
+
     /// @brief Reports whether at least one light exists that could be sampled.
     bool hasLights() const { return !m_lights.empty(); }
     /// @brief Reports whether a background light exists. 
     bool hasBackground() const { return m_background != nullptr; }
-    /// @brief Randomly picks a light from the list of sampleable light sources. 
-    LightSample sampleLight(Sampler &rng) const;
+    /// @brief Returns the background light (or null if there is none).
+    const BackgroundLight *background() const { return m_background.get(); }
+    /**
+     * @brief Randomly picks a light from the list of sampleable light sources to illuminate the given point.
+     * @note Can fail if no light can illuminate the point (use @ref LightSample::isInvalid to check for this).
+     */
+    LightSample sampleLight(const Point &origin, Sampler &rng) const;
+    /**
+     * @brief Randomly picks a light independently of any query point (uniformly or proportional to power, but never
+     * using the light hierarchy), e.g., to start light paths from.
+     */
     LightSample sampleAreaLight(Sampler &rng) const;
-    /// @brief Returns the probability of randomly picking a light source via @ref sampleLight .
-    float lightSelectionProbability(const Light *light) const;
+    /// @brief Returns the probability of randomly picking a light source via @ref sampleAreaLight .
+    float areaLightSelectionProbability(const Light *light) const;
+    /// @brief Returns the probability of randomly picking a light source via @ref sampleLight for the given point.
+    float lightSelectionProbability(const Light *light, const Point &origin) const;
     /// @brief Returns the bounding box of the scene geometry.
     Bounds getBoundingBox() const;
 };
@@ -44,10 +44,42 @@ public:
      * lies within the bounding box and can be used for partitioning objects (e.g., when building a BVH structure).
      */
     virtual Point getCentroid() const = 0;
-    /// @brief Samples a random point on the surface of this shape.
+    /// @brief Samples a random point on the surface of this shape, uniformly distributed in area.
     virtual AreaSample sampleArea(Sampler &rng) const {
         NOT_IMPLEMENTED
     }
+    /**
+     * @brief Samples a random point on the surface of this shape that is likely to be visible from a given origin
+     * (e.g., uniformly in the solid angle the shape covers), which reduces noise when sampling emissive shapes.
+     * The density is still reported in area. Defaults to sampling uniformly in area.
+     */
+    virtual AreaSample sampleArea(const Point &origin, Sampler &rng) const {
+        return sampleArea(rng);
+    }
+    /**
+     * @brief Returns the density (in area) of @ref sampleArea choosing the given point, which has been found by
+     * intersecting or sampling this shape. Defaults to the uniform density.
+     */
+    virtual float areaPdf(const SurfaceEvent &surface) const {
+        return 1 / area();
+    }
+    /// @brief Returns the density (in area) of @ref sampleArea with the given origin choosing the given point.
+    virtual float areaPdf(const Point &origin, const SurfaceEvent &surface) const {
+        return areaPdf(surface);
+    }
+    /// @brief Returns the surface area of this shape.
+    virtual float area() const {
+        NOT_IMPLEMENTED
+    }
+    /**
+     * @brief Returns the point on the surface that has the given texture coordinates, for shapes whose texture
+     * coordinates parametrize their surface (e.g., to sample emission textures by their brightness).
+     * The density of the sample is that of points with uniformly distributed texture coordinates, in area. Shapes
+     * without such a parametrization return an invalid sample.
+     */
+    virtual AreaSample sampleTexture(const Point2 &uv) const {
+        return AreaSample::invalid();
+    }
 
     /**
      * @brief Marks that the shape is part of the scene geometry, i.e., can be hit through @ref Scene::intersect .
@@ -55,6 +87,13 @@ public:
      * using a reference.
      */
     virtual void markAsVisible() {}
+    /**
+     * @brief Marks that points on the shape are sampled by area (e.g., by an area light), so that shapes whose density
+     * varies over their surface report it in @ref SurfaceEvent::pdf when intersected, to be found by @ref areaPdf .
+     */
+    virtual void markAsSampled() {}
+    /// @brief Reports whether the shape, or any shape nested in it, places a participating medium.
+    virtual bool containsMedia() const { return false; }
 };
 
 }
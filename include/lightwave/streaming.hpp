@@ -8,6 +8,7 @@
 #include <lightwave/core.hpp>
 #include <lightwave/math.hpp>
 
+#include <atomic>
 #include <vector>
 #include <string>
 
@@ -21,7 +22,9 @@ class Streaming {
     const std::vector<std::string> m_channels = { "r", "g", "b" };
     const Image &m_image;
     std::mutex m_mutex;
-    float m_normalization = 1;
+    std::atomic<float> m_normalization { 1 };
+    /// @brief Scratch memory for the pixel data of a block, reused across updates to avoid allocations.
+    std::vector<float> m_scratch;
 
     std::unique_ptr<Stream> m_stream;
     std::unique_ptr<UpdateThread> m_updater;
@@ -30,6 +30,12 @@ public:
         // we would ideally have a separate texture interface for scalar values)
         return evaluate(uv).r();
     }
+    /**
+     * @brief Returns the number of texels the texture consists of, or nothing for textures that are not made of texels
+     * (e.g., constant or procedural textures).
+     * Useful to decide how finely the texture needs to be tabulated, e.g., to build sampling distributions.
+     */
+    virtual std::optional<Point2i> resolution() const { return std::nullopt; }
 };
 
 }
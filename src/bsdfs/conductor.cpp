@@ -25,7 +25,7 @@ public:
     BsdfSample sample(const Point2 &uv, const Vector &wo,
                       Sampler &rng) const override {
         Vector next_ray = Vector(-wo.x(), -wo.y(), wo.z());
-        return BsdfSample(next_ray, (m_reflectance -> evaluate(uv)));
+        return BsdfSample(next_ray, (m_reflectance -> evaluate(uv)), Infinity);
     }
 
     std::string toString() const override {
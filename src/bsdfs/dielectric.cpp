@@ -27,6 +27,10 @@ public:
         return Color(1.f);
     }
 
+    float ior(const Point2 &uv) const override {
+        return m_ior -> scalar(uv);
+    }
+
     BsdfSample sample(const Point2 &uv, const Vector &wo,
                       Sampler &rng) const override {
         float eta = m_ior -> scalar(uv);
@@ -39,11 +43,11 @@ public:
         float prob = fresnelDielectric(to_est, eta);
 
         if (prob == -1) {
-            return BsdfSample(Vector(-wo.x(), -wo.y(), wo.z()), m_reflectance -> evaluate(uv));
+            return BsdfSample(Vector(-wo.x(), -wo.y(), wo.z()), m_reflectance -> evaluate(uv), Infinity);
         }
 
         if (rng.next() < prob) {
-            return BsdfSample(Vector(-wo.x(), -wo.y(), wo.z()), m_reflectance -> evaluate(uv));
+            return BsdfSample(Vector(-wo.x(), -wo.y(), wo.z()), m_reflectance -> evaluate(uv), Infinity);
         }
         else {
             Vector ref;
@@ -55,10 +59,10 @@ public:
             }
 
             if (ref == Vector(0.f, 0.f, 0.f)) {
-                return BsdfSample(Vector(-wo.x(), -wo.y(), wo.z()), m_reflectance -> evaluate(uv));
+                return BsdfSample(Vector(-wo.x(), -wo.y(), wo.z()), m_reflectance -> evaluate(uv), Infinity);
             }
             
-            return BsdfSample(ref, (m_transmittance -> evaluate(uv)) / (eta * eta));
+            return BsdfSample(ref, (m_transmittance -> evaluate(uv)) / (eta * eta), Infinity);
         }
     }
 
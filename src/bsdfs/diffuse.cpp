@@ -13,20 +13,22 @@ public:
     BsdfEval evaluate(const Point2 &uv, const Vector &wo,
                       const Vector &wi) const override {
         if (Frame::cosTheta(wi) > 0) {
-            return BsdfEval((m_albedo -> evaluate(uv) * Frame::cosTheta(wi)) * InvPi);
+            return BsdfEval((m_albedo -> evaluate(uv) * Frame::cosTheta(wi)) * InvPi, cosineHemispherePdf(wi));
         }
 
-        return BsdfEval(Color(0.f));
+        return BsdfEval::invalid();
     }
 
     Color albedo(const Point2 &uv) {
         return m_albedo -> evaluate(uv);
     }
 
+    bool isDiffuse() const override { return true; }
+
     BsdfSample sample(const Point2 &uv, const Vector &wo,
                       Sampler &rng) const override {
         Vector next_ray = squareToCosineHemisphere(rng.next2D());
-        return BsdfSample(next_ray, (m_albedo -> evaluate(uv)));
+        return BsdfSample(next_ray, (m_albedo -> evaluate(uv)), cosineHemispherePdf(next_ray));
     }
 
     std::string toString() const override {
@@ -10,10 +10,10 @@ struct DiffuseLobe {
 
     BsdfEval evaluate(const Vector &wo, const Vector &wi) const {
         if (Frame::cosTheta(wi) > 0) {
-            return BsdfEval((color * Frame::cosTheta(wi)) * InvPi);
+            return BsdfEval((color * Frame::cosTheta(wi)) * InvPi, cosineHemispherePdf(wi));
         }
 
-        return BsdfEval(Color(0.f));
+        return BsdfEval::invalid();
 
         // hints:
         // * copy your diffuse bsdf evaluate here
@@ -22,7 +22,7 @@ struct DiffuseLobe {
 
     BsdfSample sample(const Vector &wo, Sampler &rng) const {
         Vector next_ray = squareToCosineHemisphere(rng.next2D());
-        return BsdfSample(next_ray, color);
+        return BsdfSample(next_ray, color, cosineHemispherePdf(next_ray));
 
         // hints:
         // * copy your diffuse bsdf evaluate here
@@ -35,8 +35,12 @@ struct MetallicLobe {
     Color color;
 
     BsdfEval evaluate(const Vector &wo, const Vector &wi) const {
+        // grazing views do not see any microfacets (and would divide by zero below)
+        if (Frame::cosTheta(wo) == 0) return BsdfEval::invalid();
+
         Vector sampledNormal = (wi + wo).normalized();
-        return BsdfEval(color * lightwave::microfacet::smithG1(alpha, sampledNormal, wo) * lightwave::microfacet::smithG1(alpha, sampledNormal, wi) * lightwave::microfacet::evaluateGGX(alpha, sampledNormal) / (4 * Frame::absCosTheta(wo)));
+        return BsdfEval(color * lightwave::microfacet::smithG1(alpha, sampledNormal, wo) * lightwave::microfacet::smithG1(alpha, sampledNormal, wi) * lightwave::microfacet::evaluateGGX(alpha, sampledNormal) / (4 * Frame::absCosTheta(wo)),
+                        lightwave::microfacet::pdfGGXVNDF(alpha, sampledNormal, wo) * lightwave::microfacet::detReflection(sampledNormal, wo));
 
         // hints:
         // * copy your roughconductor bsdf evaluate here
@@ -46,10 +50,13 @@ struct MetallicLobe {
     }
 
     BsdfSample sample(const Vector &wo, Sampler &rng) const {
+        if (Frame::cosTheta(wo) == 0) return BsdfSample::invalid();
+
         Vector norm = lightwave::microfacet::sampleGGXVNDF(alpha, wo.normalized(), rng.next2D()).normalized();
         Vector wi = reflect(wo.normalized(), norm.normalized()).normalized();
 
-        return BsdfSample(wi, color * lightwave::microfacet::smithG1(alpha, norm, wi));
+        return BsdfSample(wi, color * lightwave::microfacet::smithG1(alpha, norm, wi),
+                          lightwave::microfacet::pdfGGXVNDF(alpha, norm, wo) * lightwave::microfacet::detReflection(norm, wo));
 
         // hints:
         // * copy your roughconductor bsdf sample here
@@ -69,6 +76,11 @@ class Principled : public Bsdf {
         float diffuseSelectionProb;
         DiffuseLobe diffuse;
         MetallicLobe metallic;
+
+        /// @brief The density of sampling a direction given the densities of both lobes (which are picked at random).
+        float pdf(float diffusePdf, float metallicPdf) const {
+            return diffuseSelectionProb * diffusePdf + (1 - diffuseSelectionProb) * metallicPdf;
+        }
     };
 
     Combination combine(const Point2 &uv, const Vector &wo) const {
@@ -109,7 +121,9 @@ public:
     BsdfEval evaluate(const Point2 &uv, const Vector &wo,
                       const Vector &wi) const override {
         const auto combination = combine(uv, wo);
-        return BsdfEval(combination.diffuse.evaluate(wo, wi).value + combination.metallic.evaluate(wo, wi).value);
+        const BsdfEval diffuse = combination.diffuse.evaluate(wo, wi);
+        const BsdfEval metallic = combination.metallic.evaluate(wo, wi);
+        return BsdfEval(diffuse.value + metallic.value, combination.pdf(diffuse.pdf, metallic.pdf));
 
         // hint: evaluate `combination.diffuse` and `combination.metallic` and
         // combine their results
@@ -124,10 +138,12 @@ public:
         const auto combination = combine(uv, wo);
         if (rng.next() < combination.diffuseSelectionProb) {
             BsdfSample r = combination.diffuse.sample(wo, rng);
-            return BsdfSample(r.wi, r.weight / combination.diffuseSelectionProb);
+            return BsdfSample(r.wi, r.weight / combination.diffuseSelectionProb,
+                              combination.pdf(r.pdf, combination.metallic.evaluate(wo, r.wi).pdf));
         }
         BsdfSample r = combination.metallic.sample(wo, rng);
-        return BsdfSample(r.wi, r.weight / (1 - combination.diffuseSelectionProb));;
+        return BsdfSample(r.wi, r.weight / (1 - combination.diffuseSelectionProb),
+                          combination.pdf(combination.diffuse.evaluate(wo, r.wi).pdf, r.pdf));
 
         // hint: sample either `combination.diffuse` (probability
         // `combination.diffuseSelectionProb`) or `combination.metallic`
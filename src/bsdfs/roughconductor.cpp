@@ -20,9 +20,12 @@ public:
         // transition from specular to rough. For numerical stability, we avoid
         // extremely specular distributions (alpha values below 10^-3)
         const auto alpha = std::max(float(1e-3), sqr(m_roughness->scalar(uv)));
+        // grazing views do not see any microfacets (and would divide by zero below)
+        if (Frame::cosTheta(wo) == 0) return BsdfEval::invalid();
 
         Vector sampledNormal = (wi + wo).normalized();
-        return BsdfEval((m_reflectance -> evaluate(uv) * lightwave::microfacet::smithG1(alpha, sampledNormal, wo) * lightwave::microfacet::smithG1(alpha, sampledNormal, wi) * lightwave::microfacet::evaluateGGX(alpha, sampledNormal) / (4 * Frame::absCosTheta(wo))));
+        return BsdfEval((m_reflectance -> evaluate(uv) * lightwave::microfacet::smithG1(alpha, sampledNormal, wo) * lightwave::microfacet::smithG1(alpha, sampledNormal, wi) * lightwave::microfacet::evaluateGGX(alpha, sampledNormal) / (4 * Frame::absCosTheta(wo))),
+                        lightwave::microfacet::pdfGGXVNDF(alpha, sampledNormal, wo) * lightwave::microfacet::detReflection(sampledNormal, wo));
 
         // hints:
         // * the microfacet normal can be computed from `wi' and `wo'
@@ -36,11 +39,13 @@ public:
     BsdfSample sample(const Point2 &uv, const Vector &wo,
                       Sampler &rng) const override {
         const auto alpha = std::max(float(1e-3), sqr(m_roughness->scalar(uv)));
+        if (Frame::cosTheta(wo) == 0) return BsdfSample::invalid();
 
         Vector norm = lightwave::microfacet::sampleGGXVNDF(alpha, wo.normalized(), rng.next2D()).normalized();
         Vector wi = reflect(wo.normalized(), norm.normalized()).normalized();
 
-        return BsdfSample(wi, (m_reflectance -> evaluate(uv) * lightwave::microfacet::smithG1(alpha, norm, wi)));
+        return BsdfSample(wi, (m_reflectance -> evaluate(uv) * lightwave::microfacet::smithG1(alpha, norm, wi)),
+                          lightwave::microfacet::pdfGGXVNDF(alpha, norm, wo) * lightwave::microfacet::detReflection(norm, wo));
         
         
         // hints:
@@ -50,6 +50,38 @@ namespace lightwave
                 .weight = Color(1.0f)};
         }
 
+        ImportanceSample sampleImportance(const Point &origin, Sampler &rng) const override
+        {
+            const Vector local = Vector(m_transform->inverse(origin));
+            if (local.z() <= 0) return ImportanceSample::invalid();
+
+            const Point2 normalized(local.x() / (local.z() * x_scaled), local.y() / (local.z() * y_scaled));
+            if (std::abs(normalized.x()) > 1 || std::abs(normalized.y()) > 1) return ImportanceSample::invalid();
+
+            const Vector toCamera = m_transform->apply(Point(0.f)) - origin;
+            const float distance = toCamera.length();
+            // the importance 1 / (A cos^4(theta)) for an image plane of area A at distance one, times the cosine at the
+            // camera, divided by the density of reaching the pinhole (distance^2 / cos(theta))
+            const float cosTheta = local.z() / local.length();
+            return {
+                .normalized = normalized,
+                .wi = toCamera / distance,
+                .distance = distance,
+                .weight = Color(1 / (4 * x_scaled * y_scaled * cosTheta * sqr(cosTheta) * sqr(distance))),
+            };
+        }
+
+        float pdfDirection(const Ray &ray) const override
+        {
+            const Vector local = m_transform->inverse(ray.direction).normalized();
+            if (local.z() <= 0) return 0;
+            if (std::abs(local.x()) > local.z() * x_scaled || std::abs(local.y()) > local.z() * y_scaled) return 0;
+
+            // uniform positions on the image plane at distance one, converted to solid angle
+            const float cosTheta = local.z();
+            return 1 / (4 * x_scaled * y_scaled * cosTheta * sqr(cosTheta));
+        }
+
         std::string toString() const override
         {
             return tfm::format(
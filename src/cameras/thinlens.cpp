@@ -48,6 +48,47 @@ namespace lightwave
                 .weight = Color(1.0f)};
         }
 
+        ImportanceSample sampleImportance(const Point &origin, Sampler &rng) const override
+        {
+            const Point2 lens = (Point2)(radius * (Vector2)squareToUniformDiskConcentric(rng.next2D()));
+            const Vector local = Vector(m_transform->inverse(origin)) - Vector(lens.x(), lens.y(), 0.f);
+            if (local.z() <= 0) return ImportanceSample::invalid();
+
+            // the image position is where the ray through the lens point hits the plane in focus
+            const Point2 normalized((lens.x() + local.x() * focal_length / local.z()) / x_scaled,
+                                    (lens.y() + local.y() * focal_length / local.z()) / y_scaled);
+            if (std::abs(normalized.x()) > 1 || std::abs(normalized.y()) > 1) return ImportanceSample::invalid();
+
+            const Vector toCamera = m_transform->apply(Point(lens.x(), lens.y(), 0.f)) - origin;
+            const float distance = toCamera.length();
+            // the lens area cancels between the importance and the density of sampling the lens point, which leaves
+            // the density of positions on the plane in focus converted to solid angle (see pdfDirection)
+            const float cosTheta = local.z() / local.length();
+            return {
+                .normalized = normalized,
+                .wi = toCamera / distance,
+                .distance = distance,
+                .weight = Color(sqr(focal_length) /
+                                (4 * x_scaled * y_scaled * cosTheta * sqr(cosTheta) * sqr(distance))),
+            };
+        }
+
+        float pdfDirection(const Ray &ray) const override
+        {
+            const Point origin = m_transform->inverse(ray.origin);
+            const Vector local = m_transform->inverse(ray.direction).normalized();
+            if (local.z() <= 0) return 0;
+
+            const float t = focal_length / local.z();
+            if (std::abs(origin.x() + local.x() * t) > x_scaled || std::abs(origin.y() + local.y() * t) > y_scaled)
+                return 0;
+
+            // uniform positions on the plane in focus (at distance focal_length from the lens), converted to solid
+            // angle
+            const float cosTheta = local.z();
+            return sqr(focal_length) / (4 * x_scaled * y_scaled * cosTheta * sqr(cosTheta));
+        }
+
         std::string toString() const override
         {
             return tfm::format(
@@ -0,0 +1,84 @@
+#include "assetcache.hpp"
+#include "plyparser.hpp"
+
+#include <lightwave/logger.hpp>
+
+namespace lightwave {
+
+AssetCache &AssetCache::global() {
+    static AssetCache cache;
+    return cache;
+}
+
+template <typename T>
+std::shared_ptr<T> AssetCache::acquire(const std::filesystem::path &path, const std::string &options,
+                                       const std::function<std::shared_ptr<T>(size_t &bytes)> &load) {
+    std::error_code error;
+    auto canonical = std::filesystem::canonical(path, error);
+    if (error) {
+        lightwave_throw("could not find asset %s: %s", path, error.message());
+    }
+    const auto mtime = std::filesystem::last_write_time(canonical, error);
+    const std::string key = tfm::format("%s|%s|%d", canonical.generic_string(), options,
+        error ? 0 : mtime.time_since_epoch().count());
+
+    std::shared_ptr<Entry> entry;
+    {
+        std::unique_lock lock{ m_mutex };
+        auto &slot = m_entries[key];
+        if (slot) {
+            slot->hits++;
+        } else {
+            slot = std::make_shared<Entry>();
+            m_misses++;
+        }
+        entry = slot;
+    }
+
+    // load outside of the lock, so that different assets can be loaded in parallel
+    entry->loaded.ensure([&]() {
+        size_t bytes = 0;
+        entry->asset = load(bytes);
+        entry->bytes = bytes;
+    });
+    return std::static_pointer_cast<T>(entry->asset);
+}
+
+ref<Image> AssetCache::image(const std::filesystem::path &path, bool isLinearSpace) {
+    return acquire<Image>(path, isLinearSpace ? "linear" : "srgb", [&](size_t &bytes) {
+        auto image = std::make_shared<Image>(path, isLinearSpace);
+        image->setBasePath(path.parent_path());
+        bytes = size_t(image->resolution().x()) * image->resolution().y() * image->getBytesPerPixel();
+        return image;
+    });
+}
+
+cref<MeshData> AssetCache::mesh(const std::filesystem::path &path) {
+    return acquire<MeshData>(path, "ply", [&](size_t &bytes) {
+        auto mesh = std::make_shared<MeshData>();
+        readPLY(path, mesh->triangles, mesh->vertices);
+        logger(EInfo, "loaded ply with %d triangles, %d vertices",
+            mesh->triangles.size(),
+            mesh->vertices.size()
+        );
+        bytes = mesh->bytes();
+        return mesh;
+    });
+}
+
+void AssetCache::printStatistics() {
+    std::unique_lock lock{ m_mutex };
+    if (m_entries.empty()) return;
+
+    int hits = 0;
+    size_t bytesSaved = 0;
+    for (const auto &[key, entry] : m_entries) {
+        hits += entry->hits;
+        bytesSaved += entry->hits * entry->bytes;
+    }
+
+    logger(EInfo, "asset cache: %d hits, %d misses, %.1f MiB saved",
+        hits, m_misses, bytesSaved / (1024.0 * 1024.0));
+}
+
+} // namespace lightwave
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <lightwave/core.hpp>
+#include <lightwave/image.hpp>
+#include <lightwave/math.hpp>
+#include <lightwave/parallel.hpp>
+
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lightwave {
+
+/// @brief The triangle data read from a PLY file, shared by all meshes that reference the same file.
+struct MeshData {
+    /// @brief The index buffer of the triangles (see @c TriangleMesh ).
+    std::vector<Vector3i> triangles;
+    /// @brief The vertex buffer of the triangles (see @c TriangleMesh ).
+    std::vector<Vertex> vertices;
+
+    /// @brief Returns the number of bytes occupied by the buffers.
+    size_t bytes() const {
+        return triangles.size() * sizeof(Vector3i) + vertices.size() * sizeof(Vertex);
+    }
+};
+
+/**
+ * @brief A process-wide cache for assets loaded from disk, so that files referenced by multiple objects (e.g., the same
+ * texture used by many materials) are only decoded and held in memory once.
+ * Assets are keyed by their canonical path, the options they were loaded with, and the modification time of the file.
+ * The cache hands out shared references; the assets it returns must not be modified.
+ * Concurrent requests for the same asset (e.g., from lazily loaded objects) block until the first one has loaded it,
+ * while requests for different assets load in parallel.
+ */
+class AssetCache {
+    struct Entry {
+        /// @brief Guards the loading of the asset.
+        InitOnce loaded;
+        /// @brief The asset, once loaded.
+        std::shared_ptr<void> asset;
+        /// @brief The memory occupied by the asset, once loaded.
+        size_t bytes = 0;
+        /// @brief How often the asset has been requested after its entry was created.
+        int hits = 0;
+    };
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, std::shared_ptr<Entry>> m_entries;
+    int m_misses = 0;
+
+    template <typename T>
+    std::shared_ptr<T> acquire(const std::filesystem::path &path, const std::string &options,
+                               const std::function<std::shared_ptr<T>(size_t &bytes)> &load);
+
+public:
+    /// @brief Returns the cache shared by all objects of this process.
+    static AssetCache &global();
+
+    /// @brief Returns the image stored at @c path , optionally performing an inverse sRGB transform (see @ref Image ).
+    ref<Image> image(const std::filesystem::path &path, bool isLinearSpace);
+    /// @brief Returns the triangle data stored in the PLY file at @c path .
+    cref<MeshData> mesh(const std::filesystem::path &path);
+
+    /// @brief Logs how many requests were served from the cache and how much memory this saved.
+    void printStatistics();
+};
+
+} // namespace lightwave
@@ -0,0 +1,55 @@
+#include <lightwave/film.hpp>
+#include <lightwave/image.hpp>
+#include <lightwave/memory.hpp>
+#include <lightwave/parallel.hpp>
+
+namespace lightwave {
+
+SplatFilm::SplatFilm(const Point2i &resolution)
+: m_resolution(resolution), m_pool(&ThreadPool::global()) {
+    m_numTiles = Point2i((resolution.x() + TileSize - 1) / TileSize, (resolution.y() + TileSize - 1) / TileSize);
+    m_threads.resize(m_pool->numThreads());
+    for (auto &thread : m_threads)
+        thread.tiles.resize(m_numTiles.x() * m_numTiles.y());
+}
+
+void SplatFilm::splat(const Point2i &pixel, const Color &value) {
+    if (pixel.x() < 0 || pixel.y() < 0 || pixel.x() >= m_resolution.x() || pixel.y() >= m_resolution.y()) return;
+
+    const int thread = m_pool->threadIndex();
+    if (thread == 0) {
+        // all threads outside the pool share this buffer
+        std::lock_guard lock { m_sharedMutex };
+        splat(m_threads[0], pixel, value);
+    } else {
+        splat(m_threads[thread], pixel, value);
+    }
+}
+
+void SplatFilm::splat(ThreadBuffer &buffer, const Point2i &pixel, const Color &value) {
+    auto &tile = buffer.tiles[(pixel.y() / TileSize) * m_numTiles.x() + pixel.x() / TileSize];
+    if (!tile) {
+        // every thread allocates each tile at most once per render
+        AllowAllocations allocation;
+        tile = std::make_unique<Color[]>(TileSize * TileSize);
+    }
+    tile[(pixel.y() % TileSize) * TileSize + pixel.x() % TileSize] += value;
+}
+
+void SplatFilm::addTo(Image &image, float scale) const {
+    parallel_for(Range(0, m_numTiles.x() * m_numTiles.y()), [&](int index) {
+        const Point2i origin { (index % m_numTiles.x()) * TileSize, (index / m_numTiles.x()) * TileSize };
+        for (const auto &thread : m_threads) {
+            const Color *tile = thread.tiles[index].get();
+            if (!tile) continue;
+
+            for (int y = 0; y < TileSize && origin.y() + y < m_resolution.y(); y++) {
+                for (int x = 0; x < TileSize && origin.x() + x < m_resolution.x(); x++) {
+                    image.get(Point2i(origin.x() + x, origin.y() + y)) += scale * tile[y * TileSize + x];
+                }
+            }
+        }
+    });
+}
+
+}
@@ -5,8 +5,15 @@
 #include <stb_image.h>
 #include <tinyexr.h>
 
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
 namespace lightwave {
 
+/// @brief Guards the global gamma setting of stb, as images may be loaded concurrently (e.g., lazy textures).
+static std::mutex s_stbMutex;
+
 void Image::loadImage(const std::filesystem::path &path, bool isLinearSpace) {
     const auto extension = path.extension();
     logger(EInfo, "loading image %s", path);
@@ -29,13 +36,15 @@ void Image::loadImage(const std::filesystem::path &path, bool isLinearSpace) {
         free(data);
     } else {
         // anything that is not an EXR file is handled by stb
-        if (isLinearSpace)
-            stbi_ldr_to_hdr_gamma(1);
+        float *data;
+        {
+            std::unique_lock lock{ s_stbMutex };
+            stbi_ldr_to_hdr_gamma(isLinearSpace ? 1.0f : 2.2f);
 
-        int numChannels;
-        float *data =
-            stbi_loadf(path.generic_string().c_str(), &m_resolution.x(),
-                       &m_resolution.y(), &numChannels, 3);
+            int numChannels;
+            data = stbi_loadf(path.generic_string().c_str(), &m_resolution.x(),
+                              &m_resolution.y(), &numChannels, 3);
+        }
         if (data == nullptr) {
             lightwave_throw("could not load image %s: %s", path,
                             stbi_failure_reason());
@@ -66,6 +75,66 @@ void Image::saveAt(const std::filesystem::path &path) const {
         logger(EError, "  error saving image %s: %s", path, error);
     }
 }
+
+void Image::saveLayers(const std::filesystem::path &path,
+                       const std::vector<std::pair<std::string, const Image *>> &layers) {
+    if (layers.empty() || layers.front().second->resolution().isZero()) {
+        logger(EWarn, "cannot save empty image %s!", path);
+        return;
+    }
+
+    const Point2i resolution = layers.front().second->resolution();
+    const size_t numPixels = size_t(resolution.x()) * resolution.y();
+
+    // the channels of the layer "name" are called "name.R", "name.G" and "name.B", those of the main image "R", "G", "B"
+    std::vector<std::pair<std::string, std::vector<float>>> channels;
+    for (const auto &[name, image] : layers) {
+        if (image->resolution() != resolution) {
+            logger(EError, "  layer \"%s\" of image %s has a different resolution, skipping it", name, path);
+            continue;
+        }
+        for (int component = 0; component < Color::NumComponents; component++) {
+            std::vector<float> values(numPixels);
+            for (size_t i = 0; i < numPixels; i++)
+                values[i] = image->data()[i][component];
+            channels.emplace_back((name.empty() ? "" : name + ".") + "RGB"[component], std::move(values));
+        }
+    }
+    // EXR viewers expect the channels to be sorted by name
+    std::sort(channels.begin(), channels.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    std::vector<EXRChannelInfo> infos(channels.size());
+    std::vector<int> pixelTypes(channels.size(), TINYEXR_PIXELTYPE_FLOAT);
+    std::vector<unsigned char *> pointers(channels.size());
+    for (size_t i = 0; i < channels.size(); i++) {
+        std::strncpy(infos[i].name, channels[i].first.c_str(), sizeof(infos[i].name) - 1);
+        pointers[i] = reinterpret_cast<unsigned char *>(channels[i].second.data());
+    }
+
+    EXRHeader header;
+    InitEXRHeader(&header);
+    header.compression_type = TINYEXR_COMPRESSIONTYPE_ZIP;
+    header.num_channels = int(channels.size());
+    header.channels = infos.data();
+    // unlike the main image, layers (e.g., depth or positions) are stored at full precision
+    header.pixel_types = pixelTypes.data();
+    header.requested_pixel_types = pixelTypes.data();
+
+    EXRImage image;
+    InitEXRImage(&image);
+    image.num_channels = int(channels.size());
+    image.images = pointers.data();
+    image.width = resolution.x();
+    image.height = resolution.y();
+
+    const char *error;
+    logger(EInfo, "saving image %s with %d layers", path, int(layers.size()));
+    if (SaveEXRImageToFile(&image, &header, path.generic_string().c_str(), &error) != TINYEXR_SUCCESS) {
+        logger(EError, "  error saving image %s: %s", path, error);
+        FreeEXRErrorMessage(error);
+    }
+}
+
 } // namespace lightwave
 
 REGISTER_CLASS(Image, "image", "default")
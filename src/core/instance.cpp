@@ -23,10 +23,14 @@ void Instance::transformFrame(SurfaceEvent &surf) const {
 }
 
 bool Instance::intersect(const Ray &worldRay, Intersection &its, Sampler &rng) const {
+    // instances that only place a medium cannot be hit
+    if (!m_shape) return false;
+
     if (!m_transform) {
         // fast path, if no transform is needed
         Ray localRay = worldRay;
         if (m_shape->intersect(localRay, its, rng)) {
+            if (m_sampled) its.pdf = m_shape->areaPdf(its);
             its.instance = this;
             return true;
         } else {
@@ -44,9 +48,13 @@ bool Instance::intersect(const Ray &worldRay, Intersection &its, Sampler &rng) c
 
     const bool wasIntersected = m_shape->intersect(localRay, its, rng);
     if (wasIntersected) {
+        const float pdf = m_sampled ? m_shape->areaPdf(its) : 0;
         its.t /= norm_factor;
         its.instance = this;
+        its.position = m_transform->apply(its.position);
         transformFrame(its);
+        // the density is reported in world space, as for samples
+        if (m_sampled) its.pdf = pdf / areaScale(its.frame.normal);
         return true;
     } else {
         its.t = previousT;
@@ -54,13 +62,19 @@ bool Instance::intersect(const Ray &worldRay, Intersection &its, Sampler &rng) c
     }
 }
 
+void Instance::markAsSampled() {
+    m_sampled = true;
+    if (m_shape) m_shape->markAsSampled();
+}
+
 Bounds Instance::getBoundingBox() const {
+    // the bounds of instances that only place a medium are those of the medium
+    const Bounds untransformedAABB = m_shape ? m_shape->getBoundingBox() : Bounds(Point(-1), Point(1));
     if (!m_transform) {
         // fast path
-        return m_shape->getBoundingBox();
+        return untransformedAABB;
     }
 
-    const Bounds untransformedAABB = m_shape->getBoundingBox();
     if (untransformedAABB.isUnbounded()) {
         return Bounds::full();
     }
@@ -80,20 +94,89 @@ Bounds Instance::getBoundingBox() const {
 }
 
 Point Instance::getCentroid() const {
+    const Point centroid = m_shape ? m_shape->getCentroid() : Point(0);
     if (!m_transform) {
         // fast path
-        return m_shape->getCentroid();
+        return centroid;
     }
 
-    return m_transform->apply(m_shape->getCentroid());
+    return m_transform->apply(centroid);
+}
+
+float Instance::areaScale(const Vector &normal) const {
+    if (!m_transform) return 1;
+    // a unit square on the surface in world space corresponds to this area in object space
+    const Frame frame { normal };
+    return 1 / m_transform->inverse(frame.tangent).cross(m_transform->inverse(frame.bitangent)).length();
+}
+
+void Instance::transformSample(AreaSample &sample) const {
+    sample.instance = this;
+    if (!m_transform) return;
+    sample.position = m_transform->apply(sample.position);
+    transformFrame(sample);
+    sample.pdf /= areaScale(sample.frame.normal);
 }
 
 AreaSample Instance::sampleArea(Sampler &rng) const {
     AreaSample sample = m_shape->sampleArea(rng);
-    transformFrame(sample);
+    transformSample(sample);
     return sample;
 }
 
+AreaSample Instance::sampleArea(const Point &origin, Sampler &rng) const {
+    AreaSample sample = m_shape->sampleArea(m_transform ? m_transform->inverse(origin) : origin, rng);
+    transformSample(sample);
+    return sample;
+}
+
+SurfaceEvent Instance::toLocal(const SurfaceEvent &surface, float scale) const {
+    // the tangent plane in object space is spanned by the transformed tangents, as in areaScale
+    const Frame frame { surface.frame.normal };
+    SurfaceEvent local = surface;
+    local.position = m_transform->inverse(surface.position);
+    local.frame = Frame(m_transform->inverse(frame.tangent).cross(m_transform->inverse(frame.bitangent)).normalized());
+    local.pdf = surface.pdf * scale;
+    return local;
+}
+
+float Instance::areaPdf(const SurfaceEvent &surface) const {
+    if (!m_transform) return m_shape->areaPdf(surface);
+    const float scale = areaScale(surface.frame.normal);
+    return m_shape->areaPdf(toLocal(surface, scale)) / scale;
+}
+
+float Instance::areaPdf(const Point &origin, const SurfaceEvent &surface) const {
+    if (!m_transform) return m_shape->areaPdf(origin, surface);
+    const float scale = areaScale(surface.frame.normal);
+    return m_shape->areaPdf(m_transform->inverse(origin), toLocal(surface, scale)) / scale;
+}
+
+AreaSample Instance::sampleTexture(const Point2 &uv) const {
+    AreaSample sample = m_shape->sampleTexture(uv);
+    if (sample.pdf > 0) transformSample(sample);
+    return sample;
+}
+
+float Instance::area() const {
+    if (!m_transform) return m_shape->area();
+    return m_shape->area() * std::pow(std::abs(m_transform->determinant()), 2.f / 3);
+}
+
+MediumSample Instance::sampleMedium(const Ray &ray, float tMax, Sampler &rng) const {
+    if (!m_medium) return MediumSample::passed();
+    // the direction is not normalized, so that distances along the ray remain those in world space
+    if (!m_transform) return m_medium->sampleFreeFlight(ray.origin, ray.direction, tMax, rng);
+    return m_medium->sampleFreeFlight(m_transform->inverse(ray.origin), m_transform->inverse(ray.direction), tMax,
+                                      rng);
+}
+
+float Instance::transmittance(const Ray &ray, float tMax, Sampler &rng) const {
+    if (!m_medium) return 1;
+    if (!m_transform) return m_medium->transmittance(ray.origin, ray.direction, tMax, rng);
+    return m_medium->transmittance(m_transform->inverse(ray.origin), m_transform->inverse(ray.direction), tMax, rng);
+}
+
 }
 
 REGISTER_CLASS(Instance, "instance", "default")
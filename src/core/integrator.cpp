@@ -1,44 +1,325 @@
 #include <lightwave/integrator.hpp>
 #include <lightwave/camera.hpp>
+#include <lightwave/memory.hpp>
 #include <lightwave/parallel.hpp>
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <csignal>
+#include <numeric>
 
 #include <lightwave/streaming.hpp>
 #include <lightwave/iterators.hpp>
 
 namespace lightwave {
 
-void SamplingIntegrator::execute() {
-    if (!m_image) {
-        lightwave_throw("<integrator /> needs an <image /> child to render into!");
+namespace {
+
+/**
+ * @brief A tile of the image that is being rendered.
+ * The rows of a tile are claimed one at a time, which allows threads that have run out of tiles to help out with
+ * the rows of tiles that are still in progress (instead of waiting for a single thread to finish an expensive tile).
+ */
+struct Tile {
+    Bounds2i block;
+    /// @brief The next row (relative to the tile) that has not been claimed by any thread yet.
+    std::atomic<int> nextRow { 0 };
+    /// @brief The number of rows that have been completely rendered.
+    std::atomic<int> finishedRows { 0 };
+
+    int rows() const { return block.diagonal().y(); }
+    int unclaimedRows() const { return rows() - nextRow.load(std::memory_order_relaxed); }
+};
+
+/// @brief The tiles that are preferably rendered by the threads of one NUMA node.
+struct NodeQueue {
+    std::vector<Tile *> tiles;
+    /// @brief The next tile that has not been started yet.
+    std::atomic<int> next { 0 };
+};
+
+/// @brief Every n-th pixel in each dimension is rendered with one sample to estimate the cost of a tile.
+constexpr int CostEstimateStride = 8;
+
+} // namespace
+
+/// @brief Set when the user requests to stop a progressive render (Ctrl+C).
+static std::atomic<bool> s_interrupted { false };
+
+static void handleInterrupt(int) {
+    s_interrupted = true;
+}
+
+SamplingIntegrator::SamplingIntegrator(const Properties &properties, const SamplingOptions &supported)
+: Integrator(properties) {
+    m_sampler = properties.getChild<Sampler>();
+    m_image = properties.getOptionalChild<Image>();
+    m_scene = properties.getChild<Scene>();
+    m_tileOrder = properties.getEnum<TileOrder>("tileOrder", TileOrder::Cost, {
+        { "spiral", TileOrder::Spiral },
+        { "cost", TileOrder::Cost },
+    });
+    m_progressive = properties.get<bool>("progressive", false);
+    m_timeBudget = properties.get<float>("timeBudget", 0);
+    m_adaptive = properties.get<bool>("adaptive", false);
+    m_adaptiveThreshold = properties.get<float>("adaptiveThreshold", 0.02f);
+    // at least two samples are needed to estimate the variance
+    m_adaptiveBatch = std::max(properties.get<int>("adaptiveBatch", 16), 2);
+    m_adaptiveMaps = properties.get<bool>("adaptiveMaps", false);
+
+    // options that have no effect are not silently ignored, as this would suggest that they have been applied
+    if (properties.has("progressive") && !supported.progressive) {
+        logger(EWarn, "the progressive option has no effect on this integrator");
+    }
+    if (properties.has("timeBudget") && !supported.timeBudget) {
+        logger(EWarn, "the timeBudget option has no effect on this integrator");
+    } else if (m_timeBudget > 0 && supported.progressive && !m_progressive) {
+        logger(EWarn, "the timeBudget option only applies to progressive rendering");
     }
+    if (m_adaptive && !supported.adaptive) {
+        logger(EWarn, "the adaptive option has no effect on this integrator");
+    } else if (m_adaptive && supported.progressive && m_progressive) {
+        logger(EWarn, "the adaptive option does not apply to progressive rendering");
+    }
+    if (properties.has("tileOrder") && !supported.tileOrder) {
+        logger(EWarn, "the tileOrder option has no effect on this integrator");
+    } else if (properties.has("tileOrder") && supported.progressive && m_progressive) {
+        logger(EWarn, "the tileOrder option does not apply to progressive rendering");
+    }
+    // nor must the rendering loops that integrators share with this class apply them
+    if (!supported.progressive) m_progressive = false;
+    if (!supported.timeBudget) m_timeBudget = 0;
+    if (!supported.adaptive) m_adaptive = false;
+}
 
+void SamplingIntegrator::executeProgressive() {
     const Vector2i resolution = m_scene->camera()->resolution();
-    m_image->initialize(resolution);
+    // the first pass assigns (rather than accumulates) every pixel, which also places the memory on the rendering node
+    m_image->resize(resolution);
+
+    std::vector<Bounds2i> blocks;
+    for (auto block : BlockSpiral(resolution, Vector2i(64)))
+        blocks.push_back(block);
 
-    const float norm = 1.0f / m_sampler->samplesPerPixel();
-    
+    // one sampler for each invocation of the per-thread loop, created once for the entire render
+    const int numThreads = ThreadPool::global().numThreads();
+    std::vector<ref<Sampler>> samplers;
+    for (int i = 0; i < numThreads; i++)
+        samplers.push_back(m_sampler->clone());
+
+    s_interrupted = false;
+    const auto previousHandler = std::signal(SIGINT, handleInterrupt);
+
+    Timer timer;
     Streaming stream { *m_image };
-    ProgressReporter progress { resolution.product() };
-    for_each_parallel(BlockSpiral(resolution, Vector2i(64)), [&](auto block) {
+    ProgressReporter progress { m_sampler->samplesPerPixel() };
+
+    int pass = 0;
+    while (pass < m_sampler->samplesPerPixel()) {
+        std::atomic<int> nextBlock { 0 };
+        parallel_for(Range(0, numThreads), [&](int thread) {
+            auto &sampler = *samplers[thread];
+            auto &arena = MemoryArena::forThread();
+            for (int index; (index = nextBlock.fetch_add(1)) < int(blocks.size());) {
+                for (auto pixel : blocks[index]) {
+                    AssertNoAllocations guard { "rendering a pixel" };
+                    sampler.seed(pixel, pass);
+                    auto cameraSample = m_scene->camera()->sample(pixel, sampler);
+                    const Color value = cameraSample.weight * Li(cameraSample.ray, sampler);
+                    arena.reset();
+
+                    if (pass == 0) {
+                        m_image->get(pixel) = value;
+                    } else {
+                        m_image->get(pixel) += value;
+                    }
+                }
+            }
+        });
+
+        pass++;
+        stream.normalize(1.0f / pass);
+        if (pass == 1) {
+            // only now all pixels have been written
+            stream.startRegularUpdates();
+        }
+        progress += 1;
+
+        if (s_interrupted) {
+            logger(EWarn, "rendering interrupted by user");
+            break;
+        }
+        if (m_timeBudget > 0 && timer.getElapsedTime() >= m_timeBudget) {
+            logger(EInfo, "time budget of %.1f seconds exhausted", m_timeBudget);
+            break;
+        }
+    }
+    progress.finish();
+    std::signal(SIGINT, previousHandler);
+
+    logger(EInfo, "rendered %d samples per pixel in %.1f seconds", pass, timer.getElapsedTime());
+
+    // turn the accumulated sums into the average
+    stream.stopRegularUpdates();
+    *m_image *= 1.0f / pass;
+    stream.normalize(1);
+    stream.update();
+
+    m_image->save();
+}
+
+void SamplingIntegrator::renderTiles(TileOrder tileOrder,
+                                     const std::function<void(const Point2i &pixel, Sampler &sampler)> &renderPixel,
+                                     const std::function<void(const Bounds2i &tile)> &tileDone) {
+    const Vector2i resolution = m_scene->camera()->resolution();
+    std::vector<Bounds2i> blocks;
+    for (auto block : BlockSpiral(resolution, Vector2i(64)))
+        blocks.push_back(block);
+
+    std::vector<int> order(blocks.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    if (tileOrder == TileOrder::Cost) {
+        // time a sparse, single sample prepass to find out which tiles are expensive, so that they can be started first
+        Timer timer;
+        std::vector<double> cost(blocks.size());
+        std::atomic<int> nextBlock { 0 };
+        parallel_for(Range(0, ThreadPool::global().numThreads()), [&](int) {
+            using namespace std::chrono;
+            auto sampler = m_sampler->clone();
+            auto &arena = MemoryArena::forThread();
+            for (int index; (index = nextBlock.fetch_add(1)) < int(blocks.size());) {
+                const auto start = steady_clock::now();
+                const Bounds2i &block = blocks[index];
+                for (int y = block.min().y(); y < block.max().y(); y += CostEstimateStride) {
+                    for (int x = block.min().x(); x < block.max().x(); x += CostEstimateStride) {
+                        sampler->seed(Point2i(x, y), 0);
+                        auto cameraSample = m_scene->camera()->sample(Point2i(x, y), *sampler);
+                        Li(cameraSample.ray, *sampler);
+                        arena.reset();
+                    }
+                }
+                cost[index] = duration<double>(steady_clock::now() - start).count();
+            }
+        });
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return cost[a] > cost[b]; });
+        logger(EDebug, "estimated tile costs in %.3f seconds", timer.getElapsedTime());
+    }
+
+    std::vector<Tile> tiles(blocks.size());
+    for (size_t i = 0; i < tiles.size(); i++)
+        tiles[i].block = blocks[order[i]];
+
+    // split the image into horizontal bands, one for each NUMA node, so that threads mostly touch node-local memory
+    const int numNodes = ThreadPool::numNodes();
+    std::vector<NodeQueue> queues(numNodes);
+    for (auto &tile : tiles) {
+        const int node = std::min(tile.block.center().y() * numNodes / resolution.y(), numNodes - 1);
+        queues[node].tiles.push_back(&tile);
+    }
+
+    const auto claimTile = [&]() -> Tile * {
+        // start tiles of our own node first, then help out with those of other nodes
+        const int home = ThreadPool::currentNode();
+        for (int i = 0; i < numNodes; i++) {
+            auto &queue = queues[(home + i) % numNodes];
+            if (queue.next.load(std::memory_order_relaxed) >= int(queue.tiles.size())) continue;
+            const int index = queue.next.fetch_add(1, std::memory_order_relaxed);
+            if (index < int(queue.tiles.size()))
+                return queue.tiles[index];
+        }
+
+        // all tiles have been started, help out with the one that has the most work left
+        Tile *straggler = nullptr;
+        for (auto &tile : tiles) {
+            if (tile.unclaimedRows() > (straggler ? straggler->unclaimedRows() : 0))
+                straggler = &tile;
+        }
+        return straggler;
+    };
+
+    parallel_for(Range(0, ThreadPool::global().numThreads()), [&](int) {
+        // everything a thread needs is set up once per render, so that the per-sample path does not allocate
         auto sampler = m_sampler->clone();
-        for (auto pixel : block) {
-            Color sum;
-            for (int sample = 0; sample < m_sampler->samplesPerPixel(); sample++) {
-                sampler->seed(pixel, sample);
-                auto cameraSample = m_scene->camera()->sample(pixel, *sampler);
-                sum += cameraSample.weight * Li(cameraSample.ray, *sampler);
+        auto &arena = MemoryArena::forThread();
+        Tile *tile = claimTile();
+        while (tile) {
+            const int row = tile->nextRow.fetch_add(1);
+            if (row >= tile->rows()) {
+                tile = claimTile();
+                continue;
+            }
+
+            const int y = tile->block.min().y() + row;
+            for (int x = tile->block.min().x(); x < tile->block.max().x(); x++) {
+                AssertNoAllocations guard { "rendering a pixel" };
+                renderPixel(Point2i(x, y), *sampler);
+                arena.reset();
+            }
+
+            if (tile->finishedRows.fetch_add(1) + 1 == tile->rows() && tileDone) {
+                tileDone(tile->block);
             }
-            m_image->get(pixel) = norm * sum;
         }
+    });
+}
 
-        progress += block.diagonal().product();
-        stream.updateBlock(block);
+void SamplingIntegrator::renderPixels(
+    Streaming &stream, const std::function<PixelEstimate(const Point2i &pixel, Sampler &sampler)> &renderPixel) {
+    const Vector2i resolution = m_scene->camera()->resolution();
+    ref<Image> sampleCountMap, errorMap;
+    if (m_adaptive && m_adaptiveMaps) {
+        sampleCountMap = std::make_shared<Image>(resolution);
+        errorMap = std::make_shared<Image>(resolution);
+    }
+    std::atomic<int64_t> totalSamples { 0 };
+
+    ProgressReporter progress { resolution.product() };
+    renderTiles(m_tileOrder, [&](const Point2i &pixel, Sampler &sampler) {
+        const PixelEstimate estimate = renderPixel(pixel, sampler);
+        m_image->get(pixel) = estimate.mean;
+        if (m_adaptive) totalSamples.fetch_add(estimate.samples, std::memory_order_relaxed);
+
+        if (sampleCountMap) {
+            sampleCountMap->get(pixel) = Color(float(estimate.samples));
+            errorMap->get(pixel) = Color(estimate.error);
+        }
+    }, [&](const Bounds2i &tile) {
+        progress += tile.diagonal().product();
+        stream.updateBlock(tile);
     });
     progress.finish();
 
+    if (m_adaptive) {
+        logger(EInfo, "adaptive sampling took %.1f samples per pixel on average (at most %d)",
+               totalSamples / double(resolution.product()), m_sampler->samplesPerPixel());
+    }
+    if (sampleCountMap) {
+        sampleCountMap->saveAt(m_image->basePath() / (m_image->id() + "_spp.exr"));
+        errorMap->saveAt(m_image->basePath() / (m_image->id() + "_error.exr"));
+    }
+}
+
+void SamplingIntegrator::execute() {
+    if (!m_image) {
+        lightwave_throw("<integrator /> needs an <image /> child to render into!");
+    }
+
+    if (m_progressive) {
+        executeProgressive();
+        return;
+    }
+
+    // every pixel will be written by the thread rendering it, which places the memory on the NUMA node of that thread
+    m_image->resize(m_scene->camera()->resolution());
+    Streaming stream { *m_image };
+    renderPixels(stream, [&](const Point2i &pixel, Sampler &sampler) {
+        return samplePixel(pixel, sampler, [&](Sampler &rng, int) {
+            auto cameraSample = m_scene->camera()->sample(pixel, rng);
+            return cameraSample.weight * Li(cameraSample.ray, rng);
+        });
+    });
     m_image->save();
 }
 
@@ -0,0 +1,236 @@
+#include "lightbvh.hpp"
+
+#include <lightwave/logger.hpp>
+#include <lightwave/sampler.hpp>
+
+#include <algorithm>
+
+namespace lightwave {
+
+namespace {
+
+/// @brief cos(max(0, a - b)) given the sines and cosines of the angles a and b.
+float cosSubClamped(float sinA, float cosA, float sinB, float cosB) {
+    if (cosA > cosB) return 1;
+    return cosA * cosB + sinA * sinB;
+}
+
+/// @brief sin(max(0, a - b)) given the sines and cosines of the angles a and b.
+float sinSubClamped(float sinA, float cosA, float sinB, float cosB) {
+    if (cosA > cosB) return 0;
+    return sinA * cosB - cosA * sinB;
+}
+
+/// @brief Rotates a vector around a (normalized) axis by the given angle (Rodrigues' formula).
+Vector rotate(const Vector &v, const Vector &axis, float angle) {
+    const float cos = std::cos(angle);
+    const float sin = std::sin(angle);
+    return v * cos + axis.cross(v) * sin + axis * (axis.dot(v) * (1 - cos));
+}
+
+/// @brief Computes the smallest cone (given by axis and cosine of its spread) that contains both given cones.
+void unionCones(Vector &axis, float &cosTheta, const Vector &otherAxis, float otherCosTheta) {
+    const float thetaA = safe_acos(cosTheta);
+    const float thetaB = safe_acos(otherCosTheta);
+    const float thetaD = safe_acos(axis.dot(otherAxis));
+    if (std::min(thetaD + thetaB, Pi) <= thetaA) return;
+    if (std::min(thetaD + thetaA, Pi) <= thetaB) {
+        axis     = otherAxis;
+        cosTheta = otherCosTheta;
+        return;
+    }
+
+    const float thetaO = (thetaA + thetaD + thetaB) / 2;
+    const Vector rotationAxis = axis.cross(otherAxis);
+    if (thetaO >= Pi || rotationAxis.lengthSquared() == 0) {
+        // the cone covers the entire sphere
+        cosTheta = -1;
+        return;
+    }
+    axis     = rotate(axis, rotationAxis.normalized(), thetaO - thetaA).normalized();
+    cosTheta = std::cos(thetaO);
+}
+
+LightBounds unionBounds(LightBounds a, const LightBounds &b) {
+    a.bounds.extend(b.bounds);
+    if (a.power == 0) {
+        a.axis      = b.axis;
+        a.cosThetaO = b.cosThetaO;
+    } else if (b.power > 0) {
+        unionCones(a.axis, a.cosThetaO, b.axis, b.cosThetaO);
+    }
+    a.power += b.power;
+    a.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+    a.twoSided  = a.twoSided || b.twoSided;
+    return a;
+}
+
+/// @brief Estimates how much light the lights within the given bounds can at most contribute to the given point.
+float importance(const LightBounds &lb, const Point &point) {
+    if (lb.power <= 0) return 0;
+
+    // clamp the distance for points close to (or within) the bounds, which would otherwise receive unbounded importance
+    // (bounds of single point lights have no extent, so the distance is also kept above a small positive floor)
+    const Point center = lb.bounds.center();
+    const float radius = lb.bounds.diagonal().length() / 2;
+    const float distanceSquared = std::max({ (point - center).lengthSquared(), sqr(radius), sqr(Epsilon) });
+
+    // the angle between the axis of the normal cone and the direction towards the point
+    const Vector toPoint = point - center;
+    float cosThetaW = toPoint.lengthSquared() > 0 ? lb.axis.dot(toPoint.normalized()) : 1;
+    if (lb.twoSided) cosThetaW = std::abs(cosThetaW);
+    const float sinThetaW = safe_sqrt(1 - sqr(cosThetaW));
+
+    // the angle subtended by the bounds as seen from the point
+    float cosThetaB = -1;
+    if (!lb.bounds.includes(point)) {
+        const float sin2ThetaB = sqr(radius) / (point - center).lengthSquared();
+        if (sin2ThetaB < 1) cosThetaB = safe_sqrt(1 - sin2ThetaB);
+    }
+    const float sinThetaB = safe_sqrt(1 - sqr(cosThetaB));
+
+    // the smallest angle between any normal within the bounds and any direction towards the point
+    const float sinThetaO = safe_sqrt(1 - sqr(lb.cosThetaO));
+    const float cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, lb.cosThetaO);
+    const float sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, lb.cosThetaO);
+    const float cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+    if (cosThetaP <= lb.cosThetaE) return 0;
+
+    return lb.power * cosThetaP / distanceSquared;
+}
+
+} // namespace
+
+LightBvh::LightBvh(const std::vector<ref<Light>> &lights) {
+    std::vector<std::pair<LightBounds, int>> bounded;
+    for (const auto &light : lights) {
+        if (auto bounds = light->bounds()) {
+            if (bounds->power <= 0) continue;
+            bounded.emplace_back(*bounds, int(m_lights.size()));
+            m_lights.push_back(light.get());
+        } else {
+            m_infiniteLights.push_back(light.get());
+        }
+    }
+
+    if (!bounded.empty()) {
+        m_nodes.reserve(2 * bounded.size() - 1);
+        build(bounded, 0, int(bounded.size()), 0, 0);
+    }
+
+    logger(EInfo, "built light hierarchy with %d lights (%d infinite lights)", m_lights.size(),
+           m_infiniteLights.size());
+}
+
+int LightBvh::build(std::vector<std::pair<LightBounds, int>> &lights, int begin, int end, uint64_t bitTrail,
+                    int depth) {
+    const int nodeIndex = int(m_nodes.size());
+    if (end - begin == 1) {
+        m_nodes.push_back({ lights[begin].first, lights[begin].second, true });
+        m_bitTrails[m_lights[lights[begin].second]] = bitTrail;
+        return nodeIndex;
+    }
+
+    LightBounds bounds = lights[begin].first;
+    Bounds centroids;
+    for (int i = begin; i < end; i++) {
+        if (i > begin) bounds = unionBounds(bounds, lights[i].first);
+        centroids.extend(lights[i].first.bounds.center());
+    }
+
+    // split at the median of the centroids along the axis in which they are spread the most
+    const Vector extent = centroids.diagonal();
+    int axis = 0;
+    for (int dim = 1; dim < 3; dim++) {
+        if (extent[dim] > extent[axis]) axis = dim;
+    }
+    const int mid = (begin + end) / 2;
+    std::nth_element(lights.begin() + begin, lights.begin() + mid, lights.begin() + end, [&](auto &a, auto &b) {
+        return a.first.bounds.center()[axis] < b.first.bounds.center()[axis];
+    });
+
+    // bit trails limit the depth, which median splits only reach with astronomical numbers of lights
+    assert(depth < 64);
+    m_nodes.push_back({ bounds, 0, false });
+    build(lights, begin, mid, bitTrail, depth + 1);
+    const int second = build(lights, mid, end, bitTrail | (uint64_t(1) << depth), depth + 1);
+    m_nodes[nodeIndex].index = second;
+    return nodeIndex;
+}
+
+float LightBvh::infiniteProbability() const {
+    if (m_infiniteLights.empty()) return 0;
+    const float numInfinite = float(m_infiniteLights.size());
+    return numInfinite / (numInfinite + (m_nodes.empty() ? 0 : 1));
+}
+
+LightSample LightBvh::sample(const Point &origin, Sampler &rng) const {
+    const float pInfinite = infiniteProbability();
+    float u = rng.next();
+    if (u < pInfinite) {
+        const int index = std::min(int(u / pInfinite * m_infiniteLights.size()), int(m_infiniteLights.size()) - 1);
+        return { m_infiniteLights[index], pInfinite / m_infiniteLights.size() };
+    }
+    if (m_nodes.empty()) return { nullptr, 0 };
+
+    // reuse the random number for the decisions along the way down
+    u = std::min((u - pInfinite) / (1 - pInfinite), OneMinusEpsilon);
+    float probability = 1 - pInfinite;
+    int nodeIndex = 0;
+    while (true) {
+        const Node &node = m_nodes[nodeIndex];
+        if (node.isLeaf) {
+            // only relevant if the root is a leaf, otherwise the importance has already been checked by the parent
+            if (nodeIndex == 0 && importance(node.bounds, origin) == 0) return { nullptr, 0 };
+            return { m_lights[node.index], probability };
+        }
+
+        const float first  = importance(m_nodes[nodeIndex + 1].bounds, origin);
+        const float second = importance(m_nodes[node.index].bounds, origin);
+        if (first == 0 && second == 0) return { nullptr, 0 };
+
+        const float pFirst = first / (first + second);
+        if (u < pFirst) {
+            u = std::min(u / pFirst, OneMinusEpsilon);
+            probability *= pFirst;
+            nodeIndex++;
+        } else {
+            u = std::min((u - pFirst) / (1 - pFirst), OneMinusEpsilon);
+            probability *= 1 - pFirst;
+            nodeIndex = node.index;
+        }
+    }
+}
+
+float LightBvh::pdf(const Light *light, const Point &origin) const {
+    const float pInfinite = infiniteProbability();
+    const auto it = m_bitTrails.find(light);
+    if (it == m_bitTrails.end()) {
+        const bool isInfinite = std::find(m_infiniteLights.begin(), m_infiniteLights.end(), light) !=
+                                m_infiniteLights.end();
+        return isInfinite ? pInfinite / m_infiniteLights.size() : 0;
+    }
+
+    uint64_t bitTrail = it->second;
+    float probability = 1 - pInfinite;
+    int nodeIndex = 0;
+    while (!m_nodes[nodeIndex].isLeaf) {
+        const Node &node = m_nodes[nodeIndex];
+        const float first  = importance(m_nodes[nodeIndex + 1].bounds, origin);
+        const float second = importance(m_nodes[node.index].bounds, origin);
+        if (first == 0 && second == 0) return 0;
+
+        if (bitTrail & 1) {
+            probability *= second / (first + second);
+            nodeIndex = node.index;
+        } else {
+            probability *= first / (first + second);
+            nodeIndex++;
+        }
+        bitTrail >>= 1;
+    }
+    if (nodeIndex == 0 && importance(m_nodes[0].bounds, origin) == 0) return 0;
+    return probability;
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <lightwave/core.hpp>
+#include <lightwave/light.hpp>
+#include <lightwave/math.hpp>
+#include <lightwave/scene.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+namespace lightwave {
+
+/**
+ * @brief A bounding volume hierarchy over the lights of a scene, which is traversed stochastically to pick lights in
+ * proportion to an estimate of how much they contribute to a given point.
+ * At every inner node, one of the two children is picked based on the power, distance and orientation of the lights
+ * it contains, so that lights that are far away or face away from the point are rarely (or never) sampled. This keeps
+ * the noise proportional to the number of lights that are relevant for a point, rather than to the number of lights
+ * in the scene.
+ * Lights that are infinitely far away (e.g., environment maps or directional lights) cannot be placed in the hierarchy,
+ * and are instead picked uniformly with the same probability that the hierarchy as a whole is picked with.
+ * @see "Importance Sampling of Many Lights with Adaptive Tree Splitting" (Conty Estevez and Kulla, 2018)
+ */
+class LightBvh {
+    struct Node {
+        LightBounds bounds;
+        /// @brief For inner nodes, the index of the second child (the first child directly follows its parent).
+        /// For leaves, the index of the light in @c m_lights .
+        int index;
+        bool isLeaf;
+    };
+
+    std::vector<Node> m_nodes;
+    /// @brief The lights in the hierarchy, referenced by the leaves.
+    std::vector<const Light *> m_lights;
+    /// @brief The lights that are infinitely far away and hence not part of the hierarchy.
+    std::vector<const Light *> m_infiniteLights;
+    /// @brief For each light in the hierarchy, the path from the root to its leaf (bit n is set if the second child
+    /// was taken at depth n), which allows computing selection probabilities without a search.
+    std::unordered_map<const Light *, uint64_t> m_bitTrails;
+
+    int build(std::vector<std::pair<LightBounds, int>> &lights, int begin, int end, uint64_t bitTrail, int depth);
+    /// @brief The probability of picking any of the infinite lights (instead of the hierarchy).
+    float infiniteProbability() const;
+
+public:
+    LightBvh(const std::vector<ref<Light>> &lights);
+
+    /// @brief Picks a light to illuminate the given point, which fails if no light can contribute to it.
+    LightSample sample(const Point &origin, Sampler &rng) const;
+    /// @brief Returns the probability of @ref sample picking the given light for the given point.
+    float pdf(const Light *light, const Point &origin) const;
+};
+
+}
@@ -1,7 +1,9 @@
 #include <lightwave/core.hpp>
 #include <lightwave/registry.hpp>
 #include <lightwave/logger.hpp>
+#include <lightwave/parallel.hpp>
 
+#include "assetcache.hpp"
 #include "parser.hpp"
 
 #include <fstream>
@@ -35,12 +37,25 @@ int main(int argc, const char *argv[]) {
 #endif
 
     try {
-        if (argc <= 1) {
-            logger(EError, "please specify path to scene");
+        std::filesystem::path scenePath;
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (arg == "-t" || arg == "--threads") {
+                if (++i >= argc) {
+                    logger(EError, "%s expects the number of threads to use", arg);
+                    return -1;
+                }
+                // takes precedence over the thread count specified in the scene
+                ThreadPool::fixThreadCount(std::stoi(argv[i]));
+            } else {
+                scenePath = arg;
+            }
+        }
+
+        if (scenePath.empty()) {
+            logger(EError, "please specify path to scene (usage: %s [--threads N] <scene.xml>)", argv[0]);
             return -1;
         }
-        
-        std::filesystem::path scenePath = argv[1];
 
         SceneParser parser { scenePath };
         for (auto &object : parser.objects()) {
@@ -48,6 +63,8 @@ int main(int argc, const char *argv[]) {
                 executable->execute();
             }
         }
+
+        AssetCache::global().printStatistics();
     } catch(const std::exception &e) {
         print_exception(e);
         return 1;
@@ -173,4 +173,32 @@ BsdfEval Intersection::evaluateBsdf(const Vector &wi) const {
     return instance->bsdf()->evaluate(uv, frame.toLocal(wo), frame.toLocal(wi));
 }
 
+Color Intersection::evaluateAdjointBsdf(const Vector &wi) const {
+    if (!instance->bsdf()) return Color(0);
+    const Vector woLocal = frame.toLocal(wo);
+    const Vector wiLocal = frame.toLocal(wi);
+    const float cosWo = std::abs(Frame::cosTheta(woLocal));
+    if (cosWo == 0) return Color(0);
+    // swap the roles of the directions, including the cosine that the Bsdf is weighted with
+    return instance->bsdf()->evaluate(uv, wiLocal, woLocal).value * (std::abs(Frame::cosTheta(wiLocal)) / cosWo);
+}
+
+BsdfSample Intersection::sampleAdjointBsdf(Sampler &rng) const {
+    BsdfSample bsdfSample = sampleBsdf(rng);
+    if (bsdfSample.isInvalid()) return bsdfSample;
+    if (bsdfSample.isDelta()) {
+        // undo the scaling of radiance by refraction, which does not apply to importance
+        const float cosWo = Frame::cosTheta(frame.toLocal(wo));
+        if (cosWo * Frame::cosTheta(frame.toLocal(bsdfSample.wi)) < 0) {
+            const float eta = instance->bsdf()->ior(uv);
+            bsdfSample.weight *= cosWo > 0 ? sqr(eta) : 1 / sqr(eta);
+        }
+        return bsdfSample;
+    }
+    // directions on the horizon can have zero density, for which the weight cannot be recomputed
+    if (!(bsdfSample.pdf > 0)) return BsdfSample::invalid();
+    bsdfSample.weight = evaluateAdjointBsdf(bsdfSample.wi) / bsdfSample.pdf;
+    return bsdfSample;
+}
+
 }
@@ -0,0 +1,74 @@
+#include <lightwave/memory.hpp>
+
+#include <cstdlib>
+#include <new>
+
+namespace lightwave {
+
+MemoryArena &MemoryArena::forThread() {
+    static thread_local MemoryArena arena;
+    return arena;
+}
+
+#ifdef LW_COUNT_ALLOCATIONS
+
+/// @brief The number of allocations performed by this thread.
+static thread_local uint64_t t_allocations = 0;
+/// @brief The number of @ref AllowAllocations scopes this thread is currently in.
+static thread_local int t_allowed = 0;
+
+uint64_t threadAllocationCount() { return t_allocations; }
+
+AllowAllocations::AllowAllocations() { t_allowed++; }
+AllowAllocations::~AllowAllocations() { t_allowed--; }
+
+AssertNoAllocations::AssertNoAllocations(const char *what)
+: m_what(what), m_start(t_allocations) {}
+
+AssertNoAllocations::~AssertNoAllocations() {
+    if (t_allocations != m_start) {
+        const uint64_t count = t_allocations - m_start;
+        AllowAllocations logging;
+        logger(EError, "%s performed %d heap allocations", m_what, count);
+        abort();
+    }
+}
+
+static void *countedAllocate(size_t size, size_t alignment) {
+    if (t_allowed == 0) t_allocations++;
+
+    void *ptr;
+    if (alignment <= alignof(std::max_align_t)) {
+        ptr = std::malloc(size ? size : 1);
+    } else {
+        // aligned_alloc requires the size to be a multiple of the alignment
+        ptr = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    }
+
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+#endif
+
+} // namespace lightwave
+
+#ifdef LW_COUNT_ALLOCATIONS
+
+using lightwave::countedAllocate;
+
+void *operator new(size_t size) { return countedAllocate(size, 0); }
+void *operator new[](size_t size) { return countedAllocate(size, 0); }
+void *operator new(size_t size, std::align_val_t alignment) { return countedAllocate(size, size_t(alignment)); }
+void *operator new[](size_t size, std::align_val_t alignment) { return countedAllocate(size, size_t(alignment)); }
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+
+#endif
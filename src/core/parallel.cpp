@@ -0,0 +1,196 @@
+#include <lightwave/parallel.hpp>
+
+#include "topology.hpp"
+
+namespace lightwave {
+
+/// @brief The pool whose worker is running on this thread (if any).
+static thread_local const ThreadPool *t_pool = nullptr;
+/// @brief The index of the worker that is running on this thread (if any).
+static thread_local int t_workerIndex = -1;
+/// @brief The NUMA node this thread is bound to.
+static thread_local int t_node = 0;
+
+/**
+ * @brief Binds the calling thread to the CPUs of a NUMA node.
+ * We only bind to nodes (and not to individual CPUs), which keeps memory accesses local while leaving the operating
+ * system free to balance threads within a node.
+ */
+static void bindToNode(int node) {
+    const auto &topology = CpuTopology::get();
+    if (topology.nodes.size() <= 1) return;
+
+    if (!pinCurrentThread(topology.nodes[node])) {
+        logger(EWarn, "could not bind thread to NUMA node %d", node);
+    }
+    t_node = node;
+}
+
+/// @brief Distributes threads across NUMA nodes in proportion to the number of CPUs each node has.
+static int nodeForThread(int threadIndex) {
+    const auto &topology = CpuTopology::get();
+    int slot = threadIndex % topology.numCpus();
+    for (int node = 0; node < int(topology.nodes.size()); node++) {
+        if (slot < int(topology.nodes[node].size())) return node;
+        slot -= int(topology.nodes[node].size());
+    }
+    return 0;
+}
+
+ThreadPool::ThreadPool(int numThreads) {
+    // the thread waiting for results helps out, so it counts as one of the threads
+    const int numWorkers = std::max(numThreads, 1) - 1;
+    for (int i = 0; i < numWorkers; i++)
+        m_queues.emplace_back(std::make_unique<Queue>());
+
+    m_threads.reserve(numWorkers);
+    for (int i = 0; i < numWorkers; i++)
+        m_threads.emplace_back([this, i]() { workerLoop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::unique_lock lock { m_sleepMutex };
+        m_stop = true;
+    }
+    m_wakeUp.notify_all();
+
+    for (auto &thread : m_threads)
+        thread.join();
+}
+
+int ThreadPool::currentWorker() const {
+    return t_pool == this ? t_workerIndex : -1;
+}
+
+void ThreadPool::enqueue(Task &&task) {
+    if (m_threads.empty()) {
+        task();
+        return;
+    }
+
+    int index = currentWorker();
+    if (index < 0)
+        index = int(m_nextQueue.fetch_add(1, std::memory_order_relaxed) % m_queues.size());
+
+    {
+        std::unique_lock lock { m_queues[index]->mutex };
+        m_queues[index]->tasks.push_back(std::move(task));
+    }
+    m_pending.fetch_add(1);
+
+    {
+        // acquire the lock so that the notification cannot be lost while a worker is about to fall asleep
+        std::unique_lock lock { m_sleepMutex };
+    }
+    m_wakeUp.notify_one();
+}
+
+bool ThreadPool::runPendingTask() {
+    if (m_pending.load() == 0) return false;
+
+    Task task;
+    const int self = currentWorker();
+    if (self >= 0) {
+        // prefer our own work, most recently pushed first
+        auto &queue = *m_queues[self];
+        std::unique_lock lock { queue.mutex };
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+    }
+
+    const int numQueues = int(m_queues.size());
+    for (int i = 1; !task && i <= numQueues; i++) {
+        // steal the oldest (and typically largest) piece of work of another worker
+        auto &queue = *m_queues[(std::max(self, 0) + i) % numQueues];
+        std::unique_lock lock { queue.mutex };
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+
+    if (!task) return false;
+    m_pending.fetch_sub(1);
+    task();
+    return true;
+}
+
+void ThreadPool::workerLoop(int index) {
+    t_pool        = this;
+    t_workerIndex = index;
+    // the thread waiting for results takes the first slot
+    bindToNode(nodeForThread(index + 1));
+
+    while (true) {
+        if (runPendingTask()) continue;
+
+        std::unique_lock lock { m_sleepMutex };
+        m_wakeUp.wait(lock, [&]() { return m_stop || m_pending.load() > 0; });
+        if (m_stop && m_pending.load() == 0) break;
+    }
+}
+
+/// @brief Guards creating and resetting the global pool (but not looking it up).
+static std::mutex s_globalMutex;
+static std::unique_ptr<ThreadPool> s_globalPool;
+/// @brief The pool owned by @c s_globalPool , published so that lookups only cost a single atomic load.
+static std::atomic<ThreadPool *> s_globalPointer { nullptr };
+static int s_threadCount       = 0;
+static bool s_threadCountFixed = false;
+
+static int resolveThreadCount(int numThreads) {
+    if (numThreads > 0) return numThreads;
+    return availableParallelism();
+}
+
+ThreadPool &ThreadPool::global() {
+    if (ThreadPool *pool = s_globalPointer.load(std::memory_order_acquire)) return *pool;
+
+    std::unique_lock lock { s_globalMutex };
+    if (!s_globalPool) {
+        const int numThreads = resolveThreadCount(s_threadCount);
+        logger(EDebug, "starting thread pool with %d threads", numThreads);
+        s_globalPool = std::make_unique<ThreadPool>(numThreads);
+        s_globalPointer.store(s_globalPool.get(), std::memory_order_release);
+    }
+    return *s_globalPool;
+}
+
+void ThreadPool::setThreadCount(int numThreads) {
+    std::unique_lock lock { s_globalMutex };
+    if (s_threadCountFixed) return;
+
+    s_threadCount = numThreads;
+    if (s_globalPool && s_globalPool->numThreads() != resolveThreadCount(numThreads)) {
+        // will be recreated with the new thread count on next use
+        s_globalPointer.store(nullptr, std::memory_order_release);
+        s_globalPool.reset();
+    }
+}
+
+void ThreadPool::fixThreadCount(int numThreads) {
+    setThreadCount(numThreads);
+    std::unique_lock lock { s_globalMutex };
+    s_threadCountFixed = true;
+}
+
+int ThreadPool::numNodes() {
+    return int(CpuTopology::get().nodes.size());
+}
+
+int ThreadPool::currentNode() {
+    return t_node;
+}
+
+void ThreadPool::runOnNode(int node, const std::function<void()> &f) {
+    std::thread thread([&]() {
+        bindToNode(node);
+        f();
+    });
+    thread.join();
+}
+
+} // namespace lightwave
@@ -175,6 +175,16 @@ static void readPlyContent(
     }
 }
 
+/// @brief Parses six numbers describing the min and max corner of a bounding box.
+static bool parseBounds(std::istream &stream, Bounds &bounds) {
+    Point min, max;
+    for (int dim = 0; dim < min.Dimension; dim++) stream >> min[dim];
+    for (int dim = 0; dim < max.Dimension; dim++) stream >> max[dim];
+    if (stream.fail()) return false;
+    bounds = Bounds(min, max);
+    return true;
+}
+
 static inline bool isAllowedVertIndType(const std::string& str) {
     return str == "uchar"
            || str == "int"
@@ -272,4 +282,27 @@ void readPLY(
     }
 }
 
+bool readPLYBounds(
+    const std::filesystem::path &path,
+    Bounds &bounds
+) {
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    if (!stream)
+        lightwave_throw("error opening file %s", path);
+
+    for (std::string line; std::getline(stream, line);) {
+        std::stringstream sstream(line);
+
+        std::string action, keyword;
+        sstream >> action;
+        if (action == "end_header")
+            break;
+        if (action == "comment" && (sstream >> keyword) && keyword == "bounds")
+            return parseBounds(sstream, bounds);
+    }
+
+    std::ifstream sidecar(path.string() + ".bounds");
+    return sidecar && parseBounds(sidecar, bounds);
+}
+
 }
@@ -12,4 +12,15 @@ void readPLY(
     std::vector<Vertex> &vertices
 );
 
+/**
+ * @brief Reads the object space bounding box of a mesh without loading its geometry.
+ * The bounds are taken from a @code comment bounds minX minY minZ maxX maxY maxZ @endcode line in the PLY header
+ * (as written by our Blender exporter), or from a sidecar file with the same six numbers at @code <path>.bounds @endcode .
+ * @return @c false if neither source provides a bounding box.
+ */
+bool readPLYBounds(
+    const std::filesystem::path &path,
+    Bounds &bounds
+);
+
 }
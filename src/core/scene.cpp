@@ -4,6 +4,10 @@
 #include <lightwave/shape.hpp>
 #include <lightwave/camera.hpp>
 #include <lightwave/light.hpp>
+#include <lightwave/instance.hpp>
+#include <lightwave/medium.hpp>
+
+#include "lightbvh.hpp"
 
 namespace lightwave {
 
@@ -11,15 +15,42 @@ Scene::Scene(const Properties &properties) {
     m_camera = properties.getChild<Camera>();
     m_background = properties.getOptionalChild<BackgroundLight>();
     m_lights = properties.getChildren<Light>();
+    m_lightSampling = properties.getEnum<LightSampling>("lightSampling", LightSampling::Uniform, {
+        { "uniform", LightSampling::Uniform },
+        { "bvh", LightSampling::Bvh },
+        { "power", LightSampling::Power },
+    });
     
     const std::vector<ref<Shape>> entities = properties.getChildren<Shape>();
-    if (entities.size() == 1) {
+    for (const auto &entity : entities) {
+        const auto instance = std::dynamic_pointer_cast<Instance>(entity);
+        if (instance && instance->medium()) m_media.push_back(instance);
+        // media are transformed only by the instance placing them, so they cannot be nested in other shapes
+        const Shape *nested = instance ? instance->shape() : entity.get();
+        if (nested && nested->containsMedia()) {
+            lightwave_throw("participating media must be placed by instances that are direct children of the scene");
+        }
+    }
+    // a single entity is used directly, unless its BVH is wrapped in a group to be replicated across NUMA nodes
+    if (entities.size() == 1 && !properties.get<bool>("replicateBvh", false)) {
         m_shape = entities[0];
     } else {
         m_shape = std::static_pointer_cast<Shape>(Registry::create("shape", "group", properties));
     }
 
     m_shape->markAsVisible();
+
+    if (m_lightSampling == LightSampling::Bvh) {
+        m_lightBvh = std::make_shared<LightBvh>(m_lights);
+    } else if (m_lightSampling == LightSampling::Power) {
+        const Bounds sceneBounds = m_shape->getBoundingBox();
+        std::vector<float> powers;
+        for (const auto &light : m_lights) {
+            m_lightIndices[light.get()] = int(powers.size());
+            powers.push_back(light->totalPower(sceneBounds));
+        }
+        m_lightPower = AliasTable(powers);
+    }
 }
 
 std::string Scene::toString() const {
@@ -47,11 +78,39 @@ bool Scene::intersect(const Ray &ray, float tMax, Sampler &rng) const {
 BackgroundLightEval Scene::evaluateBackground(const Vector &direction) const {
     if (!m_background) return {
         .value = Color(0),
+        .pdf = 0,
     };
     return m_background->evaluate(direction);
 }
 
-LightSample Scene::sampleLight(Sampler &rng) const {
+MediumSample Scene::sampleMedium(const Ray &ray, float tMax, Sampler &rng) const {
+    // media are independent, so that the ray scatters in the medium it first scatters in on its own
+    MediumSample result = MediumSample::passed();
+    for (const auto &medium : m_media) {
+        const MediumSample sample = medium->sampleMedium(ray, std::min(tMax, result.t), rng);
+        if (sample.scattered()) result = sample;
+    }
+    return result;
+}
+
+float Scene::transmittance(const Ray &ray, float tMax, Sampler &rng) const {
+    float result = 1;
+    for (const auto &medium : m_media) {
+        result *= medium->transmittance(ray, tMax, rng);
+        if (result <= 0) break;
+    }
+    return result;
+}
+
+LightSample Scene::pickLight(Sampler &rng) const {
+    if (!m_lightPower.empty()) {
+        const int lightIndex = m_lightPower.sample(rng.next());
+        return {
+            .light = m_lights[lightIndex].get(),
+            .probability = m_lightPower.pmf(lightIndex),
+        };
+    }
+
     int lightIndex = int(rng.next() * m_lights.size());
     lightIndex = std::min(lightIndex, int(m_lights.size()) - 1);
     return {
@@ -60,16 +119,25 @@ LightSample Scene::sampleLight(Sampler &rng) const {
     };
 }
 
+LightSample Scene::sampleLight(const Point &origin, Sampler &rng) const {
+    if (m_lightBvh) return m_lightBvh->sample(origin, rng);
+    return pickLight(rng);
+}
+
 LightSample Scene::sampleAreaLight(Sampler &rng) const {
-    int lightIndex = int(rng.next() * m_lights.size());
-    lightIndex = std::min(lightIndex, int(m_lights.size()) - 1);
-    return {
-        .light = m_lights[lightIndex].get(),
-        .probability = float(1) / m_lights.size(),
-    };
+    return pickLight(rng);
 }
 
-float Scene::lightSelectionProbability(const Light *light) const {
+float Scene::lightSelectionProbability(const Light *light, const Point &origin) const {
+    if (m_lightBvh) return m_lightBvh->pdf(light, origin);
+    return areaLightSelectionProbability(light);
+}
+
+float Scene::areaLightSelectionProbability(const Light *light) const {
+    if (!m_lightPower.empty()) {
+        const auto it = m_lightIndices.find(light);
+        return it == m_lightIndices.end() ? 0 : m_lightPower.pmf(it->second);
+    }
     return float(1) / m_lights.size();
 }
 
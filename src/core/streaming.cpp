@@ -605,14 +605,20 @@ Streaming::Streaming(const Image &image) : m_image(image) {
 }
 
 void Streaming::updateBlock(const Bounds2i &block) {
+    if (!s_socket) {
+        // no viewer is connected, so there is no need to gather the data
+        return;
+    }
+
     std::unique_lock lock{ m_mutex };
 
-    std::vector<float> data;
+    auto &data = m_scratch;
+    const float normalization = m_normalization;
     for (int channel = 0; channel < Color::NumComponents; channel++) {
         data.clear();
         data.reserve(block.diagonal().product());
         for (auto pixel : block)
-            data.push_back(m_image(pixel)[channel] * m_normalization);
+            data.push_back(m_image(pixel)[channel] * normalization);
 
         *m_stream
             // update channel
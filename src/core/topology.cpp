@@ -0,0 +1,170 @@
+#include "topology.hpp"
+
+#include <lightwave/logger.hpp>
+
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#ifdef LW_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace lightwave {
+
+#ifdef LW_OS_LINUX
+
+/// @brief Parses a list of CPUs in the format used by the kernel (e.g., "0-3,8-11").
+static std::vector<int> parseCpuList(const std::string &list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty() || !std::isdigit(range[0])) continue;
+        const auto dash = range.find('-');
+        const int first = std::stoi(range.substr(0, dash));
+        const int last  = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; cpu++)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+/// @brief Returns the CPUs in the affinity mask of this process.
+static std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+/// @brief Returns the number of CPUs the cgroup of this process may use, or zero if it is not limited.
+static int cgroupCpuLimit() {
+    const auto readQuota = [](const std::filesystem::path &path, double &quota, double &period) {
+        std::ifstream file(path);
+        std::string value;
+        if (!(file >> value) || value == "max") return false;
+        quota  = std::stod(value);
+        // cgroup v2 stores the period in the same file, cgroup v1 in a separate one
+        if (!(file >> period)) {
+            std::ifstream periodFile(path.parent_path() / "cpu.cfs_period_us");
+            if (!(periodFile >> period)) return false;
+        }
+        return quota > 0 && period > 0;
+    };
+
+    // find the cgroup (v2) this process belongs to
+    std::filesystem::path group = "/";
+    std::ifstream cgroups("/proc/self/cgroup");
+    for (std::string line; std::getline(cgroups, line);) {
+        if (line.rfind("0::", 0) == 0) group = line.substr(3);
+    }
+
+    double quota, period;
+    for (const auto &path : {
+             std::filesystem::path("/sys/fs/cgroup") / group.relative_path() / "cpu.max",
+             std::filesystem::path("/sys/fs/cgroup/cpu.max"),
+             std::filesystem::path("/sys/fs/cgroup/cpu/cpu.cfs_quota_us"),
+             std::filesystem::path("/sys/fs/cgroup/cpu,cpuacct/cpu.cfs_quota_us"),
+         }) {
+        if (readQuota(path, quota, period))
+            return std::max(int(std::ceil(quota / period)), 1);
+    }
+    return 0;
+}
+
+static CpuTopology detectTopology() {
+    const auto allowed = allowedCpus();
+    const std::set<int> allowedSet(allowed.begin(), allowed.end());
+
+    CpuTopology topology;
+    std::error_code error;
+    for (int node = 0;; node++) {
+        const auto path = std::filesystem::path("/sys/devices/system/node") / tfm::format("node%d", node) / "cpulist";
+        if (!std::filesystem::exists(path, error)) break;
+
+        std::ifstream file(path);
+        std::string list;
+        std::getline(file, list);
+
+        std::vector<int> cpus;
+        for (int cpu : parseCpuList(list)) {
+            if (allowedSet.count(cpu)) cpus.push_back(cpu);
+        }
+        if (!cpus.empty()) topology.nodes.push_back(cpus);
+    }
+
+    if (topology.nodes.empty() && !allowed.empty()) {
+        // no NUMA information available
+        topology.nodes.push_back(allowed);
+    }
+    return topology;
+}
+
+bool pinCurrentThread(const std::vector<int> &cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+#else
+
+static int cgroupCpuLimit() { return 0; }
+
+static CpuTopology detectTopology() {
+    CpuTopology topology;
+    std::vector<int> cpus(std::max(int(std::thread::hardware_concurrency()), 1));
+    std::iota(cpus.begin(), cpus.end(), 0);
+    topology.nodes.push_back(cpus);
+    return topology;
+}
+
+bool pinCurrentThread(const std::vector<int> &) { return false; }
+
+#endif
+
+int CpuTopology::numCpus() const {
+    int count = 0;
+    for (const auto &node : nodes)
+        count += int(node.size());
+    return count;
+}
+
+const CpuTopology &CpuTopology::get() {
+    static const CpuTopology topology = []() {
+        auto topology = detectTopology();
+        if (topology.nodes.empty()) {
+            topology.nodes.push_back({ 0 });
+        }
+        return topology;
+    }();
+    return topology;
+}
+
+int availableParallelism() {
+    static const int parallelism = []() {
+        int count       = CpuTopology::get().numCpus();
+        const int limit = cgroupCpuLimit();
+        if (limit > 0 && limit < count) {
+            logger(EDebug, "limiting threads to the cgroup CPU quota of %d", limit);
+            count = limit;
+        }
+        return std::max(count, 1);
+    }();
+    return parallelism;
+}
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <lightwave/core.hpp>
+
+#include <vector>
+
+namespace lightwave {
+
+/**
+ * @brief Describes the CPUs this process may run on, grouped by the NUMA node they belong to.
+ * On machines with several sockets, memory is attached to individual nodes, and accessing memory of another node
+ * has to go over the (slower) interconnect. Knowing the topology allows us to keep threads and the data they
+ * access on the same node.
+ */
+struct CpuTopology {
+    /// @brief The CPUs of each NUMA node that are in the affinity mask of this process (nodes without any are omitted).
+    std::vector<std::vector<int>> nodes;
+
+    /// @brief The total number of CPUs across all nodes.
+    int numCpus() const;
+
+    /// @brief Returns the topology of this machine, which is determined on first use.
+    static const CpuTopology &get();
+};
+
+/**
+ * @brief Returns the number of threads that can actually run in parallel, which accounts for the affinity mask of the
+ * process and for CPU quotas of the cgroup it runs in (e.g., in containers), unlike @c std::thread::hardware_concurrency .
+ */
+int availableParallelism();
+
+/// @brief Restricts the calling thread to the given CPUs, returning false if this is not supported.
+bool pinCurrentThread(const std::vector<int> &cpus);
+
+}
@@ -16,6 +16,10 @@ public:
         return EmissionEval(m_emission -> evaluate(uv));
     }
 
+    std::optional<Point2i> resolution() const override {
+        return m_emission->resolution();
+    }
+
     Color albedo(Point2 uv) {
         return m_emission -> evaluate(uv);
     }
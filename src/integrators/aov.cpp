@@ -0,0 +1,191 @@
+#include "pathtracer.hpp"
+
+#include <array>
+
+namespace lightwave {
+
+/**
+ * @brief Renders the image of the @c pathtracer integrator together with arbitrary output variables ("AOVs") of the
+ * surfaces seen by the camera, all from the same camera paths in a single pass.
+ * The variables are listed with the @c aovs attribute (e.g., <tt>aovs="albedo,normal"</tt>, the inputs of the
+ * @c denoise postprocess, by default):
+ *  - @c albedo : the albedo of the first surface,
+ *  - @c normal : its shading normal in world space (in [-1,+1], not remapped),
+ *  - @c distance : its distance from the camera (i.e., its depth, whose name is taken by the depth of paths),
+ *  - @c position : its position in world space,
+ *  - @c instance : the index of the instance hit by the first sample of the pixel, plus one (zero for the background),
+ *  - @c samples : the number of samples taken for the pixel (which varies with adaptive sampling),
+ *  - @c variance : the variance of the pixel estimate of each color channel.
+ * Apart from the instance, all variables are averaged over the samples of a pixel, and misses count as zero.
+ *
+ * A variable can be rendered into an image of its own by giving it as a named child (e.g.,
+ * <tt>&lt;image name="albedo" id="albedo"/&gt;</tt>), which can then be referenced by postprocesses. The remaining
+ * variables are saved next to the main image (e.g., <tt>noisy_distance.exr</tt>), unless @c multilayer is set, in which
+ * case the main image is saved as a multilayer EXR that contains all variables as layers.
+ * @note Adaptive sampling and tile ordering apply to this integrator as to the @c pathtracer integrator, progressive
+ * rendering does not.
+ */
+class AovIntegrator : public PathTracerIntegrator {
+    enum class Aov {
+        Albedo,
+        Normal,
+        Distance,
+        Position,
+        Instance,
+        Samples,
+        Variance,
+        Count,
+    };
+
+    static constexpr std::array<const char *, int(Aov::Count)> AovNames = {
+        "albedo", "normal", "distance", "position", "instance", "samples", "variance",
+    };
+
+    struct Layer {
+        Aov aov;
+        /// @brief The image the variable is written to.
+        ref<Image> image;
+        /// @brief Whether the image has been given as a child (and is hence saved on its own).
+        bool named;
+    };
+
+    std::vector<Layer> m_layers;
+    /// @brief Whether to save the main image as a multilayer EXR that contains all variables.
+    bool m_multilayer;
+
+    static Aov parseAov(const std::string &name) {
+        for (int i = 0; i < int(Aov::Count); i++) {
+            if (name == AovNames[i]) return Aov(i);
+        }
+        lightwave_throw("unknown AOV \"%s\" (supported are albedo, normal, distance, position, instance, samples and "
+                        "variance)", name);
+    }
+
+    bool hasLayer(Aov aov) const {
+        return std::any_of(m_layers.begin(), m_layers.end(), [&](const Layer &layer) { return layer.aov == aov; });
+    }
+
+    /// @brief Renders the samples of a pixel, and writes the pixel of all layers.
+    PixelEstimate renderPixel(const Point2i &pixel, Sampler &sampler) {
+        std::array<Color, int(Aov::Count)> sums;
+        // running mean and variance (Welford's algorithm) of the samples of each color channel
+        Color mean, m2;
+        const PixelEstimate estimate = samplePixel(pixel, sampler, [&](Sampler &rng, int index) {
+            const auto cameraSample = m_scene->camera()->sample(pixel, rng);
+
+            // the intersection of the camera ray is shared between the variables and the path
+            const Intersection its = m_scene->intersect(cameraSample.ray, rng);
+            const Color value = cameraSample.weight * Li(cameraSample.ray, its, rng);
+            if (its) {
+                sums[int(Aov::Albedo)] += its.evaluateAlbedo();
+                sums[int(Aov::Normal)] += Color(its.frame.normal);
+                sums[int(Aov::Distance)] += Color(its.t);
+                sums[int(Aov::Position)] += Color(Vector(its.position));
+            }
+            if (index == 0) {
+                sums[int(Aov::Instance)] = Color(its ? float(its.instance->index() + 1) : 0.f);
+            }
+
+            const Color delta = value - mean;
+            mean += delta / float(index + 1);
+            m2 += delta * (value - mean);
+            return value;
+        });
+
+        const int count = estimate.samples;
+        for (const auto &layer : m_layers) {
+            Color value;
+            switch (layer.aov) {
+            case Aov::Instance: value = sums[int(Aov::Instance)]; break;
+            case Aov::Samples: value = Color(float(count)); break;
+            case Aov::Variance: value = count > 1 ? m2 / ((count - 1) * float(count)) : Color(0); break;
+            default: value = sums[int(layer.aov)] / float(count); break;
+            }
+            layer.image->get(pixel) = value;
+        }
+        return estimate;
+    }
+
+public:
+    AovIntegrator(const Properties &properties)
+    : PathTracerIntegrator(properties, { .adaptive = true, .tileOrder = true }) {
+        m_multilayer = properties.get<bool>("multilayer", false);
+
+        // variables with an image of their own, followed by the remaining ones of the list
+        for (int i = 0; i < int(Aov::Count); i++) {
+            if (auto image = properties.get<Image>(AovNames[i], ref<Image>())) {
+                m_layers.push_back({ Aov(i), image, true });
+            }
+        }
+
+        const std::string list = properties.get<std::string>("aovs", m_layers.empty() ? "albedo,normal" : "");
+        size_t start = 0;
+        while (start <= list.size()) {
+            size_t end = list.find(',', start);
+            if (end == std::string::npos) end = list.size();
+            std::string name = list.substr(start, end - start);
+            name.erase(0, name.find_first_not_of(" \t"));
+            name.erase(name.find_last_not_of(" \t") + 1);
+            start = end + 1;
+
+            if (name.empty()) continue;
+            const Aov aov = parseAov(name);
+            if (!hasLayer(aov)) m_layers.push_back({ aov, std::make_shared<Image>(), false });
+        }
+    }
+
+    void execute() override {
+        if (!m_image) {
+            lightwave_throw("<integrator /> needs an <image /> child to render into!");
+        }
+
+        const Vector2i resolution = m_scene->camera()->resolution();
+        m_image->resize(resolution);
+        for (auto &layer : m_layers) {
+            layer.image->resize(resolution);
+            if (!layer.named) {
+                layer.image->setId(m_image->id() + "_" + AovNames[int(layer.aov)]);
+                layer.image->setBasePath(m_image->basePath());
+            }
+        }
+
+        Timer timer;
+        Streaming stream { *m_image };
+        renderPixels(stream, [&](const Point2i &pixel, Sampler &sampler) { return renderPixel(pixel, sampler); });
+        logger(EInfo, "rendered %d AOVs in %.1f seconds", int(m_layers.size()), timer.getElapsedTime());
+
+        if (m_multilayer) {
+            std::vector<std::pair<std::string, const Image *>> layers { { "", m_image.get() } };
+            for (const auto &layer : m_layers)
+                layers.emplace_back(AovNames[int(layer.aov)], layer.image.get());
+            Image::saveLayers(m_image->basePath() / (m_image->id() + ".exr"), layers);
+        } else {
+            m_image->save();
+        }
+        for (const auto &layer : m_layers) {
+            if (layer.named || !m_multilayer) layer.image->save();
+        }
+    }
+
+    std::string toString() const override {
+        std::string aovs;
+        for (const auto &layer : m_layers)
+            aovs += (aovs.empty() ? "" : ",") + std::string(AovNames[int(layer.aov)]);
+        return tfm::format(
+            "AovIntegrator[\n"
+            "  aovs = \"%s\",\n"
+            "  multilayer = %s,\n"
+            "  sampler = %s,\n"
+            "  image = %s,\n"
+            "]",
+            aovs,
+            m_multilayer,
+            indent(m_sampler),
+            indent(m_image)
+        );
+    }
+};
+
+}
+
+REGISTER_INTEGRATOR(AovIntegrator, "aov")
@@ -0,0 +1,515 @@
+#include <lightwave.hpp>
+
+namespace lightwave {
+
+/**
+ * @brief A bidirectional path tracer, which traces one subpath from the camera and one from a light source for each
+ * sample, and connects every vertex of the one to every vertex of the other. Each full path can thus be generated by
+ * several strategies (including plain path tracing, next event estimation and light tracing), whose contributions are
+ * combined with multiple importance sampling using the power heuristic.
+ * Strategies that end in the camera (light tracing) can contribute to any pixel, and are splatted into a
+ * @ref SplatFilm that is added to the image once rendering is done.
+ *
+ * Light sources are picked independently of the path (see @ref Scene::sampleAreaLight ), and emissive surfaces
+ * without a light can only be found by camera subpaths. Paths that arrive at the camera cannot be traced from the
+ * light sources either, as the lens is not part of the scene.
+ * @see "Robust Monte Carlo Methods for Light Transport Simulation" (Veach, 1997), chapter 10
+ * @note Progressive and adaptive rendering do not apply to this integrator, as splats from light subpaths cannot be
+ * attributed to the sample counts of individual pixels.
+ */
+class BidirectionalPathTracer : public SamplingIntegrator {
+    /// @brief A vertex of a camera or light subpath.
+    struct Vertex {
+        enum class Type { Camera, Light, Surface };
+
+        Type type;
+        /// @brief The position in world space (for lights that are infinitely far away, a point on the emitting disk).
+        Point position;
+        /// @brief The surface normal, or zero for vertices that do not lie on a surface (e.g., point lights).
+        Vector normal;
+        /// @brief For lights that are infinitely far away: the direction in which light travels into the scene.
+        Vector direction;
+        /**
+         * @brief For surface vertices: the intersection, whose @c wo points towards the previous vertex. For light
+         * vertices: the point on the light, whose pdf is the density of starting light paths there (in area).
+         */
+        Intersection its;
+        /// @brief For light vertices: the light source.
+        const Light *light;
+        /// @brief The product of all sampling weights of the subpath up to (and including) the emitter or camera.
+        Color beta;
+        /// @brief Whether the vertex lies on a surface that scatters with a Dirac delta distribution.
+        bool delta;
+        /// @brief Whether the vertex lies on a light that is infinitely far away.
+        bool infinite;
+        /// @brief The density of sampling the vertex from the previous vertex of its subpath (in area).
+        float pdfFwd;
+        /// @brief The density of sampling the vertex from the next vertex of its subpath, i.e., from the other side.
+        float pdfRev;
+
+        bool isOnSurface() const { return normal != Vector(0); }
+        /// @brief Whether the vertex can be connected to vertices of the other subpath.
+        bool isConnectible() const { return type != Type::Surface || (!delta && its.instance->bsdf()); }
+        /// @brief Whether the vertex lies on a light that can only be reached by light sampling.
+        bool isDeltaLight() const { return type == Type::Light && !light->canBeIntersected(); }
+
+        /// @brief The light source that emits from this vertex (if any).
+        const Light *emitter() const {
+            if (type == Type::Light) return light;
+            if (type == Type::Surface) return its.instance->light();
+            return nullptr;
+        }
+    };
+
+    /// @brief The maximum number of path segments, as for the @c pathtracer integrator.
+    int m_depth;
+    /// @brief The bounds of the scene geometry, which lights that are infinitely far away emit towards.
+    Bounds m_sceneBounds;
+
+    /// @brief Returns the direction from one vertex to another.
+    static Vector directionTo(const Vertex &from, const Vertex &to) {
+        if (to.infinite) return -to.direction;
+        if (from.infinite) return from.direction;
+        return (to.position - from.position).normalized();
+    }
+
+    /// @brief Converts a density in solid angle at one vertex into a density in area at another vertex.
+    static float convertDensity(float pdf, const Vertex &from, const Vertex &to) {
+        // lights that are infinitely far away are sampled by direction
+        if (to.infinite) return pdf;
+        const Vector w = to.position - from.position;
+        const float distanceSquared = w.lengthSquared();
+        if (distanceSquared == 0) return 0;
+        if (to.isOnSurface()) pdf *= std::abs(to.normal.dot(w)) / std::sqrt(distanceSquared);
+        return pdf / distanceSquared;
+    }
+
+    /// @brief Maps zero densities (of Dirac delta distributions) to one, so that they cancel out in MIS weights.
+    static float remap0(float pdf) { return pdf != 0 ? pdf : 1; }
+
+    /// @brief The density of light that leaves a light vertex arriving at another vertex (in area).
+    float pdfLight(const Vertex &light, const Vertex &to) const {
+        const Vector w = directionTo(light, to);
+        const EmissionPdf pdf = light.emitter()->emissionPdf(Ray(light.position, w), light.its, m_sceneBounds);
+        if (light.infinite) {
+            // positions are sampled on a disk that faces the direction of the light
+            return to.isOnSurface() ? pdf.position * std::abs(to.normal.dot(w)) : pdf.position;
+        }
+        return convertDensity(pdf.direction, light, to);
+    }
+
+    /// @brief The density of a light subpath starting at the given vertex, emitting towards another vertex.
+    float pdfLightOrigin(const Vertex &light, const Vertex &to) const {
+        const Light *emitter = light.emitter();
+        if (!emitter) return 0;
+        const EmissionPdf pdf = emitter->emissionPdf(Ray(light.position, directionTo(light, to)), light.its, m_sceneBounds);
+        // lights that are infinitely far away are sampled by direction first
+        return m_scene->areaLightSelectionProbability(emitter) * (light.infinite ? pdf.direction : pdf.position);
+    }
+
+    /// @brief The density of sampling @c next from @c current (in area at @c next ), which was reached from @c prev .
+    float pdf(const Vertex *prev, const Vertex &current, const Vertex &next) const {
+        if (current.type == Vertex::Type::Light) return pdfLight(current, next);
+
+        const Vector wn = directionTo(current, next);
+        float pdf;
+        if (current.type == Vertex::Type::Camera) {
+            pdf = m_scene->camera()->pdfDirection(Ray(current.position, wn));
+        } else {
+            const Bsdf *bsdf = current.its.instance->bsdf();
+            if (!bsdf) return 0;
+            const Vector wp = directionTo(current, *prev);
+            const Frame &frame = current.its.frame;
+            pdf = bsdf->evaluate(current.its.uv, frame.toLocal(wp), frame.toLocal(wn)).pdf;
+        }
+        return convertDensity(pdf, current, next);
+    }
+
+    /**
+     * @brief Stores the point that a light vertex lies on, along with the density of starting light paths there and its
+     * texture coordinates (which the density of textured emission depends on).
+     */
+    static void setLightSurface(Vertex &vertex, float pdfPosition, const Point2 &uv) {
+        vertex.its.position = vertex.position;
+        vertex.its.uv = uv;
+        if (vertex.isOnSurface()) vertex.its.frame = Frame(vertex.normal);
+        vertex.its.pdf = pdfPosition;
+    }
+
+    /// @brief Creates a surface vertex for an intersection that has been found along a ray.
+    static Vertex surfaceVertex(const Ray &ray, const Intersection &its, const Color &beta, float pdfFwd,
+                                const Vertex &prev) {
+        Vertex vertex;
+        vertex.type = Vertex::Type::Surface;
+        vertex.position = ray(its.t);
+        vertex.normal = its.frame.normal;
+        vertex.its = its;
+        vertex.light = nullptr;
+        vertex.beta = beta;
+        vertex.delta = false;
+        vertex.infinite = false;
+        vertex.pdfFwd = convertDensity(pdfFwd, prev, vertex);
+        vertex.pdfRev = 0;
+        return vertex;
+    }
+
+    /**
+     * @brief Continues a subpath by sampling Bsdfs, and returns the number of vertices that have been added.
+     * @param path The subpath, whose first @c start vertices have already been created.
+     * @param pdfFwd The density (in solid angle) of the direction of @c ray .
+     * @param maxVertices The maximum number of vertices of the subpath.
+     * @param camera Whether this is a camera subpath, which ends in a vertex on the background if it escapes the scene.
+     */
+    int randomWalk(Ray ray, Color beta, float pdfFwd, Vertex *path, int start, int maxVertices, bool camera,
+                   Sampler &rng) const {
+        int count = start;
+        while (count < maxVertices) {
+            Vertex &prev = path[count - 1];
+            const Intersection its = m_scene->intersect(ray, rng);
+            if (!its) {
+                if (camera && m_scene->hasBackground()) {
+                    Vertex &vertex = path[count++];
+                    vertex.type = Vertex::Type::Light;
+                    vertex.position = ray.origin;
+                    vertex.normal = Vector(0);
+                    vertex.direction = -ray.direction;
+                    vertex.light = m_scene->background();
+                    vertex.beta = beta;
+                    vertex.delta = false;
+                    vertex.infinite = true;
+                    vertex.pdfFwd = pdfFwd;
+                    vertex.pdfRev = 0;
+                }
+                break;
+            }
+
+            Vertex &vertex = path[count++];
+            vertex = surfaceVertex(ray, its, beta, pdfFwd, prev);
+            if (count == maxVertices) break;
+
+            // light subpaths carry importance, which uses the adjoint Bsdf (see Intersection::sampleAdjointBsdf)
+            const BsdfSample sample = camera ? its.sampleBsdf(rng) : its.sampleAdjointBsdf(rng);
+            if (sample.isInvalid()) break;
+
+            float pdfRev;
+            if (sample.isDelta()) {
+                // scattering with a Dirac delta distribution cannot be reproduced by connections
+                vertex.delta = true;
+                pdfFwd = pdfRev = 0;
+                beta *= sample.weight;
+            } else {
+                const Vector woLocal = its.frame.toLocal(its.wo);
+                const Vector wiLocal = its.frame.toLocal(sample.wi);
+                const BsdfEval reverse = its.instance->bsdf()->evaluate(its.uv, wiLocal, woLocal);
+                pdfFwd = sample.pdf;
+                pdfRev = reverse.pdf;
+                beta *= sample.weight;
+                if (beta == Color(0)) break;
+            }
+            prev.pdfRev = convertDensity(pdfRev, vertex, prev);
+            ray = Ray(vertex.position, sample.wi).normalized();
+        }
+        return count - start;
+    }
+
+    /// @brief Traces a camera subpath starting with the given ray, and returns its number of vertices.
+    int generateCameraSubpath(const Ray &ray, const Color &weight, Vertex *path, Sampler &rng) const {
+        Vertex &camera = path[0];
+        camera.type = Vertex::Type::Camera;
+        camera.position = ray.origin;
+        camera.normal = Vector(0);
+        camera.light = nullptr;
+        camera.beta = weight;
+        camera.delta = false;
+        camera.infinite = false;
+        camera.pdfFwd = 1;
+        camera.pdfRev = 0;
+
+        const float pdfDirection = m_scene->camera()->pdfDirection(ray);
+        return 1 + randomWalk(ray, weight, pdfDirection, path, 1, m_depth + 1, true, rng);
+    }
+
+    /// @brief Traces a light subpath from a randomly picked light, and returns its number of vertices.
+    int generateLightSubpath(Vertex *path, Sampler &rng) const {
+        if (!m_scene->hasLights()) return 0;
+        const LightSample lightSample = m_scene->sampleAreaLight(rng);
+        const EmissionSample emission = lightSample.light->sampleEmission(m_sceneBounds, rng);
+        if (emission.isInvalid()) return 0;
+
+        Vertex &light = path[0];
+        light.type = Vertex::Type::Light;
+        light.position = emission.ray.origin;
+        light.normal = emission.normal;
+        light.direction = emission.ray.direction;
+        light.light = lightSample.light;
+        light.beta = Color(1);
+        light.delta = false;
+        light.infinite = !lightSample.light->bounds().has_value();
+        light.pdfFwd = lightSample.probability * emission.pdfPosition;
+        light.pdfRev = 0;
+        setLightSurface(light, emission.pdfPosition, emission.uv);
+
+        const Color beta = emission.weight / lightSample.probability;
+        const int count = 1 + randomWalk(emission.ray, beta, emission.pdfDirection, path, 1, m_depth, false, rng);
+        if (light.infinite) {
+            // the densities of lights that are infinitely far away are given for directions and positions on the
+            // disk facing them, rather than for positions and directions
+            if (count > 1) {
+                path[1].pdfFwd = emission.pdfPosition;
+                if (path[1].isOnSurface()) path[1].pdfFwd *= std::abs(path[1].normal.dot(light.direction));
+            }
+            light.pdfFwd = lightSample.probability * emission.pdfDirection;
+        }
+        return count;
+    }
+
+    /**
+     * @brief Computes the MIS weight of connecting the first @c s vertices of the light subpath with the first @c t
+     * vertices of the camera subpath, relative to all other strategies that could have generated the same path.
+     * @param sampled The vertex that has been sampled for the connection, which replaces the last vertex of the light
+     * subpath ( @c s == 1 ) or of the camera subpath ( @c t == 1 ).
+     * @param lightTracing Whether strategies that connect to the camera ( @c t == 1 ) are used.
+     */
+    float misWeight(Vertex *lightPath, Vertex *cameraPath, const Vertex &sampled, int s, int t,
+                    bool lightTracing) const {
+        if (s + t == 2) return 1;
+
+        // temporarily replace the endpoints with the connection, and restore the subpaths afterwards
+        Vertex *qs      = s > 0 ? &lightPath[s - 1] : nullptr;
+        Vertex *pt      = &cameraPath[t - 1];
+        Vertex *qsMinus = s > 1 ? &lightPath[s - 2] : nullptr;
+        Vertex *ptMinus = t > 1 ? &cameraPath[t - 2] : nullptr;
+
+        const Vertex savedEndpoint = s == 1 ? *qs : *pt;
+        if (s == 1) *qs = sampled;
+        if (t == 1) *pt = sampled;
+
+        struct Saved {
+            bool ptDelta, qsDelta;
+            float ptRev, ptMinusRev, qsRev, qsMinusRev;
+        } saved {
+            pt->delta, qs ? qs->delta : false,
+            pt->pdfRev, ptMinus ? ptMinus->pdfRev : 0, qs ? qs->pdfRev : 0, qsMinus ? qsMinus->pdfRev : 0,
+        };
+
+        // the vertices of the connection scatter with their full (non-delta) Bsdf
+        pt->delta = false;
+        if (qs) qs->delta = false;
+
+        if (s > 0) {
+            pt->pdfRev = pdf(qsMinus, *qs, *pt);
+            qs->pdfRev = pdf(ptMinus, *pt, *qs);
+            if (qsMinus) qsMinus->pdfRev = pdf(pt, *qs, *qsMinus);
+            if (ptMinus) ptMinus->pdfRev = pdf(qs, *pt, *ptMinus);
+        } else {
+            pt->pdfRev = pdfLightOrigin(*pt, *ptMinus);
+            if (pt->pdfRev > 0) ptMinus->pdfRev = pdfLight(*pt, *ptMinus);
+        }
+
+        float sumRi = 0;
+        if (s == 0 && pt->pdfRev == 0) {
+            // the emitter cannot start light subpaths, so that no other strategy can find this path
+        } else {
+            // strategies that use fewer camera vertices
+            float ri = 1;
+            for (int i = t - 1; i > 0; i--) {
+                ri *= sqr(remap0(cameraPath[i].pdfRev) / remap0(cameraPath[i].pdfFwd));
+                if (!cameraPath[i].delta && !cameraPath[i - 1].delta && (i > 1 || lightTracing)) sumRi += ri;
+            }
+
+            // strategies that use fewer light vertices
+            ri = 1;
+            for (int i = s - 1; i >= 0; i--) {
+                ri *= sqr(remap0(lightPath[i].pdfRev) / remap0(lightPath[i].pdfFwd));
+                const bool deltaLight = i > 0 ? lightPath[i - 1].delta : lightPath[0].isDeltaLight();
+                if (!lightPath[i].delta && !deltaLight) sumRi += ri;
+            }
+        }
+
+        pt->delta = saved.ptDelta;
+        pt->pdfRev = saved.ptRev;
+        if (ptMinus) ptMinus->pdfRev = saved.ptMinusRev;
+        if (qs) {
+            qs->delta = saved.qsDelta;
+            qs->pdfRev = saved.qsRev;
+        }
+        if (qsMinus) qsMinus->pdfRev = saved.qsMinusRev;
+        if (s == 1) *qs = savedEndpoint;
+        if (t == 1) *pt = savedEndpoint;
+
+        return 1 / (1 + sumRi);
+    }
+
+    /**
+     * @brief Computes the contribution of connecting the first @c s vertices of the light subpath with the first
+     * @c t vertices of the camera subpath (weighted by MIS).
+     * @param film Receives contributions of strategies that connect to the camera, or null if they are not used.
+     */
+    Color connect(Vertex *lightPath, Vertex *cameraPath, int s, int t, SplatFilm *film, Sampler &rng) const {
+        const Vertex &pt = cameraPath[t - 1];
+        // camera subpaths that have escaped the scene can only be used as a whole
+        if (t > 1 && s != 0 && pt.type == Vertex::Type::Light) return Color(0);
+
+        Color L(0);
+        Vertex sampled;
+        Point2i pixel;
+        if (s == 0) {
+            // the camera subpath has found an emitter by itself
+            if (pt.type == Vertex::Type::Light) {
+                L = pt.beta * m_scene->evaluateBackground(-pt.direction).value;
+            } else if (pt.type == Vertex::Type::Surface) {
+                L = pt.beta * pt.its.evaluateEmission();
+            }
+        } else if (t == 1) {
+            // light tracing: connect the light subpath to the camera
+            const Vertex &qs = lightPath[s - 1];
+            if (qs.type != Vertex::Type::Surface || !qs.isConnectible()) return Color(0);
+            const ImportanceSample importance = m_scene->camera()->sampleImportance(qs.position, rng);
+            if (importance.isInvalid()) return Color(0);
+
+            sampled.type = Vertex::Type::Camera;
+            sampled.position = qs.position + importance.wi * importance.distance;
+            sampled.normal = Vector(0);
+            sampled.light = nullptr;
+            sampled.beta = importance.weight;
+            sampled.delta = false;
+            sampled.infinite = false;
+            sampled.pdfFwd = sampled.pdfRev = 0;
+
+            L = qs.beta * qs.its.evaluateAdjointBsdf(importance.wi) * sampled.beta;
+            if (L == Color(0) || m_scene->intersect(Ray(qs.position, importance.wi), importance.distance, rng))
+                return Color(0);
+
+            const Vector2i &resolution = m_scene->camera()->resolution();
+            const Point2 raster = Point2((importance.normalized.x() + 1) / 2 * resolution.x(),
+                                         (importance.normalized.y() + 1) / 2 * resolution.y());
+            pixel = Point2i(std::min(int(raster.x()), resolution.x() - 1), std::min(int(raster.y()), resolution.y() - 1));
+        } else if (s == 1) {
+            // next event estimation: connect the camera subpath to a newly sampled point on a light
+            if (!pt.isConnectible()) return Color(0);
+            const LightSample lightSample = m_scene->sampleAreaLight(rng);
+            const DirectLightSample direct = lightSample.light->sampleDirect(pt.position, rng);
+            if (direct.isInvalid()) return Color(0);
+
+            sampled.type = Vertex::Type::Light;
+            sampled.infinite = std::isinf(direct.distance);
+            sampled.position = sampled.infinite ? pt.position : pt.position + direct.wi * direct.distance;
+            sampled.normal = direct.normal;
+            sampled.direction = -direct.wi;
+            sampled.light = lightSample.light;
+            sampled.beta = direct.weight / lightSample.probability;
+            sampled.delta = false;
+            setLightSurface(sampled, direct.pdfPosition, direct.uv);
+            sampled.pdfFwd = pdfLightOrigin(sampled, pt);
+            sampled.pdfRev = 0;
+
+            L = pt.beta * pt.its.evaluateBsdf(direct.wi).value * sampled.beta;
+            if (L == Color(0) || m_scene->intersect(Ray(pt.position, direct.wi), direct.distance, rng))
+                return Color(0);
+        } else {
+            // connect a vertex of each subpath
+            const Vertex &qs = lightPath[s - 1];
+            if (!qs.isConnectible() || !pt.isConnectible()) return Color(0);
+
+            const Vector d = pt.position - qs.position;
+            const float distance = d.length();
+            if (distance == 0) return Color(0);
+            const Vector w = d / distance;
+            L = qs.beta * qs.its.evaluateAdjointBsdf(w) * pt.its.evaluateBsdf(-w).value * pt.beta / sqr(distance);
+            if (L == Color(0) || m_scene->intersect(Ray(qs.position, w), distance, rng)) return Color(0);
+        }
+
+        if (L == Color(0)) return L;
+        L *= misWeight(lightPath, cameraPath, sampled, s, t, film != nullptr);
+
+        if (t == 1) {
+            film->splat(pixel, L);
+            return Color(0);
+        }
+        return L;
+    }
+
+    /**
+     * @brief Estimates the radiance arriving along a camera ray by connecting a camera subpath with a light subpath.
+     * @param film Receives contributions to other pixels, or null if strategies that connect to the camera should not
+     * be used.
+     */
+    Color radiance(const Ray &ray, const Color &weight, SplatFilm *film, Sampler &rng) const {
+        auto &arena = MemoryArena::forThread();
+        Vertex *cameraPath = arena.allocate<Vertex>(m_depth + 1);
+        Vertex *lightPath = arena.allocate<Vertex>(m_depth);
+
+        const int numCamera = generateCameraSubpath(ray, weight, cameraPath, rng);
+        const int numLight = generateLightSubpath(lightPath, rng);
+
+        Color result(0);
+        for (int t = 1; t <= numCamera; t++) {
+            for (int s = 0; s <= numLight; s++) {
+                // paths consist of s + t - 1 segments, and need at least one vertex besides the camera
+                if (s + t - 1 > m_depth || s + t < 2) continue;
+                if (t == 1 && !film) continue;
+                result += connect(lightPath, cameraPath, s, t, film, rng);
+            }
+        }
+        return result;
+    }
+
+public:
+    BidirectionalPathTracer(const Properties &properties)
+    : SamplingIntegrator(properties, { .tileOrder = true }) {
+        m_depth = std::max(properties.get<int>("depth", 2), 1);
+        m_sceneBounds = m_scene->getBoundingBox();
+    }
+
+    void execute() override {
+        if (!m_image) {
+            lightwave_throw("<integrator /> needs an <image /> child to render into!");
+        }
+        if (m_scene->hasMedia()) {
+            lightwave_throw("the bdpt integrator does not support participating media (use the pathtracer integrator)");
+        }
+
+        const Vector2i resolution = m_scene->camera()->resolution();
+        const int samplesPerPixel = m_sampler->samplesPerPixel();
+        m_image->resize(resolution);
+        SplatFilm film { resolution };
+
+        Timer timer;
+        Streaming stream { *m_image };
+        renderPixels(stream, [&](const Point2i &pixel, Sampler &sampler) {
+            return samplePixel(pixel, sampler, [&](Sampler &rng, int) {
+                const auto cameraSample = m_scene->camera()->sample(pixel, rng);
+                return radiance(cameraSample.ray, cameraSample.weight, &film, rng);
+            });
+        });
+
+        // every sample has traced one light subpath, whose contributions are spread over the entire image
+        film.addTo(*m_image, 1.0f / samplesPerPixel);
+        logger(EInfo, "rendered %d samples per pixel in %.1f seconds", samplesPerPixel, timer.getElapsedTime());
+
+        stream.update();
+        m_image->save();
+    }
+
+    /// @brief Estimates the radiance along a single ray without light tracing (which contributes to other pixels).
+    Color Li(const Ray &ray, Sampler &rng) override {
+        return radiance(ray, Color(1), nullptr, rng);
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "BidirectionalPathTracer[\n"
+            "  depth = %d,\n"
+            "  sampler = %s,\n"
+            "  image = %s,\n"
+            "]",
+            m_depth,
+            indent(m_sampler),
+            indent(m_image)
+        );
+    }
+};
+
+}
+
+REGISTER_INTEGRATOR(BidirectionalPathTracer, "bdpt")
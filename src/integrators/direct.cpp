@@ -10,6 +10,13 @@ public:
     : SamplingIntegrator(properties) {
     }
 
+    void execute() override {
+        if (m_scene->hasMedia()) {
+            lightwave_throw("the direct integrator does not support participating media (use the pathtracer integrator)");
+        }
+        SamplingIntegrator::execute();
+    }
+
     Color Li(const Ray &ray, Sampler &rng) override {
         // Intersect the ray with the scene geometry.
         Intersection its = m_scene -> intersect(ray, rng);
@@ -18,13 +25,15 @@ public:
             Color emission = its.evaluateEmission();
             
             if (m_scene->hasLights()) {
-                LightSample lightSample = m_scene -> sampleLight(rng);
-                DirectLightSample l = lightSample.light -> sampleDirect(ray(its.t), rng);
+                LightSample lightSample = m_scene -> sampleLight(ray(its.t), rng);
+                DirectLightSample l = lightSample.isInvalid() ? DirectLightSample::invalid()
+                                                              : lightSample.light -> sampleDirect(ray(its.t), rng);
                 
                 Ray r = Ray(ray(its.t), l.wi);
-                bool inter_light = m_scene -> intersect(r, l.distance, rng);
+                bool inter_light = !l.isInvalid() && m_scene -> intersect(r, l.distance, rng);
 
-                if((!inter_light) && (!(lightSample.light -> canBeIntersected()))) {
+                // the background is left to the Bsdf sample, while all other lights are only found by light sampling
+                if((!l.isInvalid()) && (!inter_light) && (lightSample.light != m_scene -> background())) {
                     BsdfEval light_bsdf = its.evaluateBsdf(l.wi);
                     emission += ((light_bsdf.value * l.weight) / lightSample.probability);
                 }
@@ -37,6 +46,9 @@ public:
             if (!its_next) {
                 return emission + (smp.weight * (m_scene -> evaluateBackground(n1.direction)).value);
             }
+            if (its_next.instance -> light() && !smp.isDelta()) {
+                return emission;
+            }
             return emission + (smp.weight * its_next.evaluateEmission());
         }
         
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <lightwave/core.hpp>
+#include <lightwave/math.hpp>
+#include <lightwave/parallel.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+namespace lightwave {
+
+/**
+ * @brief A uniform grid over space whose cells are stored in a hash table, which finds the items (e.g., photons) close
+ * to a query point without having to bound the extent of the scene.
+ * The grid is built with a parallel counting sort of the items by the bucket of their cell, after which the items of
+ * each bucket lie next to each other in memory. Different cells can share a bucket, which only costs time, as queries
+ * have to test the distance of the items they visit anyway.
+ */
+template <typename Item>
+class HashGrid {
+    /// @brief The items, sorted by bucket.
+    std::vector<Item> m_items;
+    /// @brief The index of the first item of each bucket, followed by the number of items.
+    std::vector<int> m_bucketStart;
+    float m_cellSize = 1;
+
+    /// @brief The bucket of each item (in the order of the input), kept to avoid reallocations between builds.
+    std::vector<uint32_t> m_buckets;
+
+    int numBuckets() const { return int(m_bucketStart.size()) - 1; }
+
+    int cellCoordinate(float x) const { return int(std::floor(x / m_cellSize)); }
+
+    uint32_t bucket(int x, int y, int z) const {
+        // hashing with large primes, see "Optimized Spatial Hashing for Collision Detection of Deformable Objects"
+        // (Teschner et al., 2003)
+        const uint32_t hash = (uint32_t(x) * 73856093u) ^ (uint32_t(y) * 19349663u) ^ (uint32_t(z) * 83492791u);
+        return hash % uint32_t(numBuckets());
+    }
+
+    uint32_t bucket(const Point &p) const {
+        return bucket(cellCoordinate(p.x()), cellCoordinate(p.y()), cellCoordinate(p.z()));
+    }
+
+public:
+    /**
+     * @brief Replaces the contents of the grid with the given items.
+     * @param cellSize The width of the cells, which needs to be at least twice the radius of all queries.
+     * @param position A function that returns the position of an item.
+     */
+    template <typename Position>
+    void build(const std::vector<Item> &items, float cellSize, Position &&position) {
+        const int count = int(items.size());
+        m_cellSize = cellSize;
+        m_bucketStart.assign(std::max(count, 1) + 1, 0);
+        m_buckets.resize(count);
+        m_items.resize(count);
+
+        constexpr int GrainSize = 1024;
+        const auto counters = std::make_unique<std::atomic<int>[]>(numBuckets());
+        parallel_for(Range(0, count), [&](int index) {
+            m_buckets[index] = bucket(position(items[index]));
+            counters[m_buckets[index]].fetch_add(1, std::memory_order_relaxed);
+        }, GrainSize);
+
+        for (int b = 0; b < numBuckets(); b++) {
+            m_bucketStart[b + 1] = m_bucketStart[b] + counters[b].load(std::memory_order_relaxed);
+            // the counters now hand out the slots of their bucket
+            counters[b].store(m_bucketStart[b], std::memory_order_relaxed);
+        }
+
+        parallel_for(Range(0, count), [&](int index) {
+            m_items[counters[m_buckets[index]].fetch_add(1, std::memory_order_relaxed)] = items[index];
+        }, GrainSize);
+    }
+
+    /**
+     * @brief Invokes @c f for all items of the cells that overlap the sphere with the given center and radius (which
+     * includes items outside of the sphere, which the caller needs to skip).
+     * The radius must not exceed half the cell size that the grid has been built with.
+     */
+    template <typename Function>
+    void query(const Point &center, float radius, Function &&f) const {
+        if (m_items.empty()) return;
+
+        // as the cells are at least twice as wide as the radius, the sphere overlaps at most eight of them (larger radii
+        // would overflow the list of visited buckets and report the items of shared buckets more than once)
+        assert(2 * radius <= m_cellSize && "the query radius exceeds half the cell size");
+        std::array<uint32_t, 8> visited;
+        int numVisited = 0;
+        // (rounding can make a sphere that touches two cell boundaries appear to reach into a third cell)
+        const int x0 = cellCoordinate(center.x() - radius), x1 = std::min(cellCoordinate(center.x() + radius), x0 + 1);
+        const int y0 = cellCoordinate(center.y() - radius), y1 = std::min(cellCoordinate(center.y() + radius), y0 + 1);
+        const int z0 = cellCoordinate(center.z() - radius), z1 = std::min(cellCoordinate(center.z() + radius), z0 + 1);
+        for (int z = z0; z <= z1; z++) {
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    // cells that share a bucket must only be visited once
+                    const uint32_t b = bucket(x, y, z);
+                    if (std::find(visited.begin(), visited.begin() + numVisited, b) != visited.begin() + numVisited)
+                        continue;
+                    visited[numVisited++] = b;
+
+                    for (int index = m_bucketStart[b]; index < m_bucketStart[b + 1]; index++)
+                        f(m_items[index]);
+                }
+            }
+        }
+    }
+};
+
+}
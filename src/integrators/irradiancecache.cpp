@@ -0,0 +1,260 @@
+#include <lightwave.hpp>
+
+#include "irradiancecache.hpp"
+
+#include <memory>
+
+namespace lightwave {
+
+/**
+ * @brief A path tracer that reuses the indirect illumination of diffuse surfaces found by secondary rays from an
+ * @ref IrradianceCache , instead of tracing further paths from every one of them.
+ * Whenever the first bounce of a camera path arrives at a diffuse surface and the cache cannot interpolate there, a
+ * new record is computed by gathering the incident radiance over a stratified hemisphere. The irradiance that is
+ * cached includes the background, emissive surfaces without a light and all indirect light, while all other lights
+ * are sampled at every vertex, as for the @c pathtracer integrator without MIS.
+ *
+ * Caches can be written to disk and read back (e.g., by all frames of a camera flythrough through a static scene),
+ * in which case frames only need to compute records where earlier frames have not seen the scene yet (e.g., the second
+ * frame of tests/practical_4/irradiancecache_flythrough.xml computes 808 instead of 3204 records, and renders in 0.4
+ * instead of 1.2 seconds). The file is read when rendering starts and written once rendering is done, so that
+ * integrators that refer to the same file render with the records of all integrators that have rendered before them.
+ * Files store the depth, accuracy and scene bounds they have been computed with, and files of a different depth or
+ * scene bounds are rejected. With @c resetCache , the records of an existing file are ignored and the file is
+ * overwritten with records computed from scratch.
+ * @note The cache only applies for a depth of at least three, as it holds light that arrives after two bounces. The
+ * default depth of four also lets records include the light of lights other than the background, which is sampled at
+ * the surfaces that records see.
+ * @note Records are created in the order in which threads request them, so that images are not deterministic.
+ */
+class IrradianceCacheIntegrator : public SamplingIntegrator {
+    /// @brief The maximum number of path segments, as for the @c pathtracer integrator.
+    int m_depth;
+    /// @brief The number of strata of the polar angle used when computing records.
+    int m_thetaStrata;
+    /// @brief The number of strata of the azimuth used when computing records.
+    int m_phiStrata;
+    /// @brief The bounds of the radius of records, relative to the diagonal of the scene.
+    float m_minRadius, m_maxRadius;
+    float m_sceneScale;
+
+    /// @brief The file the cache is read from and written to (empty if it is not stored).
+    std::filesystem::path m_cacheFile;
+    /// @brief Whether records stored in the file are ignored, i.e., the file is recomputed from scratch.
+    bool m_resetCache;
+    std::unique_ptr<IrradianceCache> m_cache;
+
+    /// @brief Estimates the direct illumination from all lights except the background (which is left to Bsdf sampling).
+    Color sampleLights(const Point &origin, const Intersection &its, Sampler &rng) const {
+        const LightSample lightSample = m_scene->sampleLight(origin, rng);
+        if (lightSample.isInvalid() || lightSample.light == m_scene->background()) return Color(0);
+
+        const DirectLightSample direct = lightSample.light->sampleDirect(origin, rng);
+        if (direct.isInvalid() || m_scene->intersect(Ray(origin, direct.wi), direct.distance, rng)) return Color(0);
+        return its.evaluateBsdf(direct.wi).value * direct.weight / lightSample.probability;
+    }
+
+    /**
+     * @brief Traces a path starting with the given ray at the given bounce, and returns the radiance it gathers.
+     * @param distance If given, receives the distance to the first surface the ray hits (infinity if it escapes).
+     */
+    Color tracePath(Ray ray, int bounce, Sampler &rng, float *distance = nullptr) const {
+        Color result(0);
+        Color weight(1);
+        // lights hit by rays that continue from non-specular surfaces have already been accounted for by light sampling
+        bool lightSampled = bounce > 0;
+        for (; bounce < m_depth; bounce++) {
+            const Intersection its = m_scene->intersect(ray, rng);
+            if (distance) {
+                *distance = its ? its.t : Infinity;
+                distance  = nullptr;
+            }
+            if (!its) {
+                result += m_scene->evaluateBackground(ray.direction).value * weight;
+                break;
+            }
+
+            if (!(lightSampled && its.instance->light())) result += its.evaluateEmission() * weight;
+            if (bounce == m_depth - 1) break;
+
+            const Point origin = ray(its.t);
+            if (m_scene->hasLights()) result += sampleLights(origin, its, rng) * weight;
+
+            if (bounce == 1 && its.instance->bsdf() && its.instance->bsdf()->isDiffuse()) {
+                // the light reflected by diffuse surfaces is given by their albedo and the irradiance
+                result += its.evaluateAlbedo() * InvPi * irradiance(origin, its, bounce, rng) * weight;
+                break;
+            }
+
+            const BsdfSample bsdfSample = its.sampleBsdf(rng);
+            weight *= bsdfSample.weight;
+            if (weight == Color(0)) break;
+            lightSampled = !bsdfSample.isDelta();
+            ray = Ray(origin, bsdfSample.wi).normalized();
+        }
+        return result;
+    }
+
+    /// @brief Returns the irradiance at a diffuse surface, which is interpolated from the cache whenever possible.
+    Color irradiance(const Point &origin, const Intersection &its, int bounce, Sampler &rng) const {
+        Color result;
+        if (m_cache->lookup(origin, its.frame.normal, result)) return result;
+
+        const IrradianceCache::Record record = computeRecord(origin, its, bounce, rng);
+        {
+            AllowAllocations insertion;
+            m_cache->add(record);
+        }
+        return record.irradiance;
+    }
+
+    /**
+     * @brief Computes the irradiance and its gradients at a surface by gathering the incident radiance over a
+     * hemisphere that is stratified in polar angle (cosine-weighted) and azimuth.
+     * @see "Irradiance Gradients" (Ward and Heckbert, 1992)
+     */
+    IrradianceCache::Record computeRecord(const Point &origin, const Intersection &its, int bounce,
+                                          Sampler &rng) const {
+        const int M = m_thetaStrata, N = m_phiStrata;
+        auto &arena = MemoryArena::forThread();
+        Color *radiance = arena.allocate<Color>(M * N);
+        float *distances = arena.allocate<float>(M * N);
+        const Frame &frame = its.frame;
+
+        IrradianceCache::Record record;
+        record.position = origin;
+        record.normal = frame.normal;
+        record.irradiance = Color(0);
+        record.rotationalGradient.fill(Vector(0));
+        record.translationalGradient.fill(Vector(0));
+
+        // every stratum covers the same projected solid angle of pi / (M N)
+        const float stratumWeight = Pi / float(M * N);
+        float inverseDistanceSum = 0;
+        for (int j = 0; j < M; j++) {
+            for (int k = 0; k < N; k++) {
+                const Point2 sample = rng.next2D();
+                const float sinTheta = std::sqrt((j + sample.x()) / M);
+                const float cosTheta = safe_sqrt(1 - sqr(sinTheta));
+                const float phi = 2 * Pi * (k + sample.y()) / N;
+                const Vector local { sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta };
+
+                const int index = j * N + k;
+                radiance[index] = tracePath(Ray(origin, frame.toWorld(local)), bounce + 1, rng, &distances[index]);
+                inverseDistanceSum += 1 / distances[index];
+
+                record.irradiance += stratumWeight * radiance[index];
+                // rotating the normal towards the sample changes its cosine
+                const Vector tangent = frame.toWorld(Vector(-std::sin(phi), std::cos(phi), 0));
+                const float tanTheta = cosTheta > 0 ? sinTheta / cosTheta : 0;
+                for (int c = 0; c < Color::NumComponents; c++)
+                    record.rotationalGradient[c] += stratumWeight * tanTheta * radiance[index][c] * tangent;
+            }
+        }
+
+        // moving the surface shifts the boundaries between strata, by an angle inversely proportional to the distance
+        // of the surfaces seen along them
+        for (int k = 0; k < N; k++) {
+            const float phiCenter = 2 * Pi * (k + 0.5f) / N;
+            const float phiBoundary = 2 * Pi * k / N;
+            const Vector u = frame.toWorld(Vector(std::cos(phiCenter), std::sin(phiCenter), 0));
+            const Vector v = frame.toWorld(Vector(-std::sin(phiBoundary), std::cos(phiBoundary), 0));
+            const int previous = (k + N - 1) % N;
+
+            for (int j = 0; j < M; j++) {
+                const int index = j * N + k;
+                if (j > 0) {
+                    const int below = (j - 1) * N + k;
+                    const float sinTheta = std::sqrt(float(j) / M);
+                    const float cos2Theta = 1 - float(j) / M;
+                    const float factor = 2 * Pi / N * sinTheta * cos2Theta /
+                                         std::min(distances[index], distances[below]);
+                    for (int c = 0; c < Color::NumComponents; c++)
+                        record.translationalGradient[c] += factor * (radiance[index][c] - radiance[below][c]) * u;
+                }
+
+                const int left = j * N + previous;
+                const float factor = (std::sqrt(float(j + 1) / M) - std::sqrt(float(j) / M)) /
+                                     std::min(distances[index], distances[left]);
+                for (int c = 0; c < Color::NumComponents; c++)
+                    record.translationalGradient[c] += factor * (radiance[index][c] - radiance[left][c]) * v;
+            }
+        }
+
+        // the harmonic mean distance, limited so that the translational gradient cannot extrapolate below zero
+        float radius = inverseDistanceSum > 0 ? float(M * N) / inverseDistanceSum : Infinity;
+        const Color gradientLength { record.translationalGradient[0].length(),
+                                     record.translationalGradient[1].length(),
+                                     record.translationalGradient[2].length() };
+        if (gradientLength.luminance() > 0)
+            radius = std::min(radius, record.irradiance.luminance() / gradientLength.luminance());
+        record.radius = std::clamp(radius, m_minRadius * m_sceneScale, m_maxRadius * m_sceneScale);
+        return record;
+    }
+
+public:
+    IrradianceCacheIntegrator(const Properties &properties)
+    : SamplingIntegrator(properties) {
+        m_depth = properties.get<int>("depth", 4);
+        const int gatherSamples = std::max(properties.get<int>("gatherSamples", 256), 4);
+        // the strata are roughly square if there are pi times more of them in azimuth than in polar angle
+        m_thetaStrata = std::max(int(std::round(std::sqrt(gatherSamples / Pi))), 2);
+        m_phiStrata = std::max(gatherSamples / m_thetaStrata, 2);
+        m_minRadius = properties.get<float>("minRadius", 0.01f);
+        m_maxRadius = properties.get<float>("maxRadius", 0.5f);
+        const float accuracy = properties.get<float>("accuracy", 0.25f);
+
+        Bounds bounds = m_scene->getBoundingBox();
+        if (bounds.isUnbounded() || bounds.diagonal().x() < 0) bounds = Bounds(Point(-1), Point(1));
+        m_sceneScale = bounds.diagonal().length();
+
+        if (properties.has("cache")) m_cacheFile = properties.get<std::filesystem::path>("cache");
+        m_resetCache = properties.get<bool>("resetCache", false);
+        m_cache = std::make_unique<IrradianceCache>(bounds, accuracy, m_depth);
+    }
+
+    void execute() override {
+        if (m_scene->hasMedia()) {
+            lightwave_throw("the irradiancecache integrator does not support participating media (use the pathtracer integrator)");
+        }
+        // start from an empty cache, in case the integrator has been used before
+        m_cache = std::make_unique<IrradianceCache>(m_cache->bounds(), m_cache->accuracy(), m_depth);
+        if (!m_cacheFile.empty() && !m_resetCache && std::filesystem::exists(m_cacheFile)) {
+            m_cache->load(m_cacheFile);
+            logger(EInfo, "loaded %d irradiance records from %s", m_cache->size(), m_cacheFile);
+        }
+
+        const int previousRecords = m_cache->size();
+        SamplingIntegrator::execute();
+        logger(EInfo, "irradiance cache holds %d records (%d new)", m_cache->size(), m_cache->size() - previousRecords);
+
+        if (!m_cacheFile.empty()) m_cache->save(m_cacheFile);
+    }
+
+    Color Li(const Ray &ray, Sampler &rng) override {
+        return tracePath(ray, 0, rng);
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "IrradianceCacheIntegrator[\n"
+            "  depth = %d,\n"
+            "  strata = %dx%d,\n"
+            "  cache = %s,\n"
+            "  resetCache = %s,\n"
+            "  sampler = %s,\n"
+            "  image = %s,\n"
+            "]",
+            m_depth,
+            m_thetaStrata, m_phiStrata,
+            m_cacheFile,
+            m_resetCache ? "true" : "false",
+            indent(m_sampler),
+            indent(m_image)
+        );
+    }
+};
+
+}
+
+REGISTER_INTEGRATOR(IrradianceCacheIntegrator, "irradiancecache")
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <lightwave/core.hpp>
+#include <lightwave/color.hpp>
+#include <lightwave/logger.hpp>
+#include <lightwave/math.hpp>
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <shared_mutex>
+#include <type_traits>
+#include <vector>
+
+namespace lightwave {
+
+/**
+ * @brief Stores irradiance that has been computed at points in the scene, and interpolates it at nearby points with
+ * similar normals ("irradiance caching").
+ * Each record is valid within a radius proportional to the harmonic mean distance of the surfaces around it, and is
+ * extrapolated using its gradients with respect to rotation and translation. Records are kept in an octree, in every
+ * node of the depth that matches their size that they overlap, so that lookups only need to visit the nodes along the
+ * path to the query point. Lookups and insertions can happen concurrently.
+ * @see "A Ray Tracing Solution for Diffuse Interreflection" (Ward et al., 1988)
+ * @see "Irradiance Gradients" (Ward and Heckbert, 1992)
+ */
+class IrradianceCache {
+public:
+    struct Record {
+        Point position;
+        Vector normal;
+        Color irradiance;
+        /// @brief The change of irradiance (per color channel) when rotating the normal about a given axis.
+        std::array<Vector, Color::NumComponents> rotationalGradient;
+        /// @brief The change of irradiance (per color channel) when moving along a given direction.
+        std::array<Vector, Color::NumComponents> translationalGradient;
+        /// @brief The harmonic mean distance of the surrounding surfaces (clamped), which determines the validity.
+        float radius;
+    };
+    static_assert(std::is_trivially_copyable_v<Record>);
+
+private:
+    struct Node {
+        /// @brief The index of each child node, or zero for children that do not exist yet.
+        std::array<int, 8> children {};
+        std::vector<int> records;
+    };
+
+    static constexpr int MaxDepth = 16;
+    static constexpr char Magic[4] = { 'L', 'W', 'I', 'C' };
+    static constexpr uint32_t Version = 2;
+
+    /// @brief The settings the records of a file have been computed with, which are stored in front of them.
+    struct Header {
+        int32_t depth;
+        float accuracy;
+        std::array<float, 3> boundsMin, boundsMax;
+    };
+
+    Bounds m_bounds;
+    /// @brief The maximum error that is tolerated when interpolating (smaller values require more records).
+    float m_accuracy;
+    /// @brief The path depth the records are computed for (records of other depths hold a different amount of light).
+    int m_depth;
+    std::vector<Node> m_nodes;
+    std::vector<Record> m_records;
+    mutable std::shared_mutex m_mutex;
+
+    static Bounds childBounds(const Bounds &bounds, int child) {
+        const Point center = bounds.center();
+        Bounds result = bounds;
+        for (int dim = 0; dim < 3; dim++) {
+            if (child & (1 << dim)) result.min()[dim] = center[dim];
+            else result.max()[dim] = center[dim];
+        }
+        return result;
+    }
+
+    static bool overlaps(const Bounds &a, const Bounds &b) {
+        for (int dim = 0; dim < 3; dim++) {
+            if (a.max()[dim] < b.min()[dim] || b.max()[dim] < a.min()[dim]) return false;
+        }
+        return true;
+    }
+
+    /// @brief Adds a record to all nodes below the given one that it overlaps, at the depth that matches its size.
+    void insert(int node, const Bounds &nodeBounds, int depth, int record, const Bounds &recordBounds) {
+        if (depth == MaxDepth || nodeBounds.diagonal().lengthSquared() < recordBounds.diagonal().lengthSquared()) {
+            m_nodes[node].records.push_back(record);
+            return;
+        }
+
+        for (int child = 0; child < 8; child++) {
+            const Bounds bounds = childBounds(nodeBounds, child);
+            if (!overlaps(bounds, recordBounds)) continue;
+            if (!m_nodes[node].children[child]) {
+                m_nodes[node].children[child] = int(m_nodes.size());
+                m_nodes.emplace_back();
+            }
+            insert(m_nodes[node].children[child], bounds, depth + 1, record, recordBounds);
+        }
+    }
+
+    void insert(int record) {
+        const Record &r = m_records[record];
+        const Vector extent { m_accuracy * r.radius };
+        const Bounds recordBounds { r.position - extent, r.position + extent };
+        // records outside of the octree (e.g., loaded for a different scene) are only found through the root
+        if (!overlaps(m_bounds, recordBounds)) m_nodes[0].records.push_back(record);
+        else insert(0, m_bounds, 0, record, recordBounds);
+    }
+
+public:
+    IrradianceCache(const Bounds &bounds, float accuracy, int depth)
+    : m_bounds(bounds), m_accuracy(accuracy), m_depth(depth), m_nodes(1) {}
+
+    /// @brief The region of space that is subdivided to find records.
+    const Bounds &bounds() const { return m_bounds; }
+    /// @brief The largest error that records are allowed to have where they are interpolated.
+    float accuracy() const { return m_accuracy; }
+    /// @brief The path depth the records are computed for.
+    int depth() const { return m_depth; }
+
+    /// @brief The number of records in the cache.
+    int size() const {
+        std::shared_lock lock { m_mutex };
+        return int(m_records.size());
+    }
+
+    /// @brief Adds a record to the cache (safe to call concurrently with lookups).
+    void add(const Record &record) {
+        std::unique_lock lock { m_mutex };
+        m_records.push_back(record);
+        insert(int(m_records.size()) - 1);
+    }
+
+    /**
+     * @brief Interpolates the irradiance at a point with the given normal from the records that are valid there.
+     * @returns Whether any record was valid, otherwise a new record needs to be computed.
+     */
+    bool lookup(const Point &position, const Vector &normal, Color &irradiance) const {
+        std::shared_lock lock { m_mutex };
+        Color sum(0);
+        float weightSum = 0;
+
+        Bounds bounds = m_bounds;
+        int node = 0;
+        while (true) {
+            for (int index : m_nodes[node].records) {
+                const Record &record = m_records[index];
+                const float cosTheta = normal.dot(record.normal);
+                if (cosTheta <= 0) continue;
+
+                const Vector offset = position - record.position;
+                // records in front of the query point do not see the same surroundings
+                if (offset.dot(normal + record.normal) < -0.1f * record.radius) continue;
+
+                const float error = offset.length() / record.radius + safe_sqrt(1 - std::min(cosTheta, 1.f));
+                if (error >= m_accuracy) continue;
+
+                const float weight = 1 / std::max(error, 1e-4f);
+                const Vector rotation = record.normal.cross(normal);
+                Color value;
+                for (int channel = 0; channel < Color::NumComponents; channel++) {
+                    value[channel] = std::max(record.irradiance[channel] +
+                                                  rotation.dot(record.rotationalGradient[channel]) +
+                                                  offset.dot(record.translationalGradient[channel]),
+                                              0.f);
+                }
+                sum += weight * value;
+                weightSum += weight;
+            }
+
+            // descend into the child that contains the query point
+            const Point center = bounds.center();
+            int child = 0;
+            for (int dim = 0; dim < 3; dim++) {
+                if (position[dim] >= center[dim]) child |= 1 << dim;
+            }
+            if (!m_nodes[node].children[child]) break;
+            bounds = childBounds(bounds, child);
+            node = m_nodes[node].children[child];
+        }
+
+        if (weightSum <= 0) return false;
+        irradiance = sum / weightSum;
+        return true;
+    }
+
+    /// @brief Writes all records to a file.
+    void save(const std::filesystem::path &path) const {
+        std::shared_lock lock { m_mutex };
+        std::ofstream file { path, std::ios::binary };
+        if (!file) lightwave_throw("could not write irradiance cache to %s", path);
+
+        const uint32_t count = uint32_t(m_records.size());
+        Header header { m_depth, m_accuracy, {}, {} };
+        for (int dim = 0; dim < 3; dim++) {
+            header.boundsMin[dim] = m_bounds.min()[dim];
+            header.boundsMax[dim] = m_bounds.max()[dim];
+        }
+        file.write(Magic, sizeof(Magic));
+        file.write(reinterpret_cast<const char *>(&Version), sizeof(Version));
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(&count), sizeof(count));
+        file.write(reinterpret_cast<const char *>(m_records.data()), std::streamsize(count * sizeof(Record)));
+    }
+
+    /**
+     * @brief Adds all records stored in a file by @ref save to the cache.
+     * Files that have been computed for a different depth or scene (as far as can be told from its bounds) are
+     * rejected, while records of a different accuracy are still valid and are interpolated with the accuracy of this
+     * cache.
+     */
+    void load(const std::filesystem::path &path) {
+        std::ifstream file { path, std::ios::binary };
+        if (!file) lightwave_throw("could not read irradiance cache from %s", path);
+
+        char magic[sizeof(Magic)];
+        uint32_t version, count;
+        Header header;
+        file.read(magic, sizeof(magic));
+        file.read(reinterpret_cast<char *>(&version), sizeof(version));
+        file.read(reinterpret_cast<char *>(&header), sizeof(header));
+        file.read(reinterpret_cast<char *>(&count), sizeof(count));
+        if (!file || !std::equal(magic, magic + sizeof(magic), Magic) || version != Version) {
+            lightwave_throw("%s is not an irradiance cache of this version", path);
+        }
+        if (header.depth != m_depth) {
+            lightwave_throw("irradiance cache %s has been computed for depth %d instead of %d, delete it to recompute it",
+                            path, header.depth, m_depth);
+        }
+        for (int dim = 0; dim < 3; dim++) {
+            if (header.boundsMin[dim] != m_bounds.min()[dim] || header.boundsMax[dim] != m_bounds.max()[dim]) {
+                lightwave_throw("irradiance cache %s has been computed for a scene with different bounds, delete it "
+                                "to recompute it", path);
+            }
+        }
+        if (header.accuracy != m_accuracy) {
+            logger(EWarn, "irradiance cache %s has been computed with accuracy %g, interpolating it with accuracy %g",
+                   path, header.accuracy, m_accuracy);
+        }
+
+        std::vector<Record> records(count);
+        file.read(reinterpret_cast<char *>(records.data()), std::streamsize(count * sizeof(Record)));
+        if (!file) lightwave_throw("irradiance cache %s is truncated", path);
+
+        std::unique_lock lock { m_mutex };
+        for (const Record &record : records) {
+            m_records.push_back(record);
+            insert(int(m_records.size()) - 1);
+        }
+    }
+};
+
+}
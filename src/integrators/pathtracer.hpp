@@ -0,0 +1,237 @@
+#pragma once
+
+#include <lightwave.hpp>
+
+namespace lightwave {
+
+class PathTracerIntegrator : public SamplingIntegrator {
+private:
+    int depth;
+    /**
+     * @brief Whether to combine light sampling and Bsdf sampling with multiple importance sampling.
+     * Without MIS, the background is only found by Bsdf sampling, and all other lights only by light sampling (except
+     * where they are seen directly or through specular Bsdfs, which light sampling cannot account for).
+     */
+    bool m_mis;
+    /// @brief The number of bounces after which paths are terminated randomly based on their throughput (negative disables).
+    int m_rrDepth;
+    /// @brief The highest probability with which paths survive Russian roulette (bounds the work spent on bright paths).
+    float m_rrMaxSurvival;
+    /// @brief The number of light samples taken at each path vertex.
+    int m_lightSamples;
+    /**
+     * @brief The number of continuations a path is split into at its first vertex (one disables splitting), which
+     * amortizes the camera ray and the light samples of that vertex over several estimates of indirect light.
+     * @note This only pays off when the first vertex is expensive compared to the rest of the path; for simple scenes
+     * such as @c pathtracing_split it is about break-even at equal time, which is why splitting is disabled by default.
+     */
+    int m_maxSplit;
+
+    /**
+     * @brief The weight of a light source that has been found by Bsdf sampling with density @c bsdfPdf , which accounts
+     * for the fact that it could also have been found by light sampling.
+     */
+    float bsdfHitWeight(const Light *light, const Point &origin, float bsdfPdf, float lightPdf) const {
+        if (!light || std::isinf(bsdfPdf)) return 1;
+        if (!m_mis) return light == m_scene->background() ? 1 : 0;
+        return powerHeuristic(bsdfPdf, m_lightSamples * m_scene->lightSelectionProbability(light, origin) * lightPdf);
+    }
+
+    /**
+     * @brief Estimates the direct illumination at a path vertex by averaging over @c m_lightSamples light samples.
+     * @param scatter Evaluates the scattering at the vertex (the Bsdf or the phase function) for a direction.
+     */
+    template <typename Scatter>
+    Color sampleLights(const Point &origin, Scatter scatter, Sampler &rng) const {
+        Color ret = Color(0.f);
+        for (int s = 0; s < m_lightSamples; s++) {
+            LightSample lightSample = m_scene -> sampleLight(origin, rng);
+            if (lightSample.isInvalid()) continue;
+            DirectLightSample l = lightSample.light -> sampleDirect(origin, rng);
+            
+            Ray r = Ray(origin, l.wi);
+            bool inter_light = m_scene -> intersect(r, l.distance, rng);
+
+            if (m_mis) {
+                // with MIS, lights that can also be hit by Bsdf samples share their contribution with them
+                if (!inter_light && !l.isInvalid()) {
+                    BsdfEval light_bsdf = scatter(l.wi);
+                    const float misWeight =
+                        powerHeuristic(m_lightSamples * lightSample.probability * l.pdf, light_bsdf.pdf);
+                    ret += ((light_bsdf.value * l.weight) / lightSample.probability) * misWeight *
+                           m_scene -> transmittance(r, l.distance, rng);
+                }
+            } else if (!inter_light && !l.isInvalid() && lightSample.light != m_scene -> background()) {
+                BsdfEval light_bsdf = scatter(l.wi);
+                ret += ((light_bsdf.value * l.weight) / lightSample.probability) *
+                       m_scene -> transmittance(r, l.distance, rng);
+            }
+        }
+        return ret / float(m_lightSamples);
+    }
+
+    /**
+     * @brief Traces a path starting with the given ray at the given bounce, and returns the radiance it gathers.
+     * @param weight The throughput of the path so far.
+     * @param bsdfPdf The density of the Bsdf sample that led to the ray (infinity if it cannot be found by light sampling).
+     * @param first The intersection of the ray, if it has already been found (null otherwise).
+     */
+    Color tracePath(Ray cur_ray, Color weight, int bounce, float bsdfPdf, Sampler &rng,
+                    const Intersection *first = nullptr) const {
+        Color ret = Color(0.f);
+
+        for (int i = bounce ; i < depth ; i++) {
+            Intersection its = (i == bounce && first) ? *first : m_scene -> intersect(cur_ray, rng);
+            if (m_scene -> hasMedia()) {
+                // the ray might scatter within a medium before it reaches the surface (or leaves the scene)
+                const MediumSample medium = m_scene -> sampleMedium(cur_ray, its ? its.t : Infinity, rng);
+                weight *= medium.weight;
+                if (medium.scattered()) {
+                    if (i == (depth - 1)) {
+                        break;
+                    }
+
+                    const Point origin = cur_ray(medium.t);
+                    const Vector wo = -cur_ray.direction;
+                    if (m_scene->hasLights()) {
+                        ret += sampleLights(origin, [&](const Vector &wi) {
+                            const float phase = medium.medium->evaluatePhase(wo, wi);
+                            return BsdfEval { .value = Color(phase), .pdf = phase };
+                        }, rng) * weight;
+                    }
+
+                    const PhaseSample phase = medium.medium->samplePhase(wo, rng);
+                    bsdfPdf = phase.pdf;
+                    cur_ray = Ray(origin, phase.wi);
+
+                    if (!survivesRoulette(weight, i + 1, rng)) {
+                        break;
+                    }
+                    continue;
+                }
+            }
+
+            if (!its) {
+                const BackgroundLightEval background = m_scene -> evaluateBackground(cur_ray.direction);
+                const float misWeight = bsdfHitWeight(m_scene -> background(), cur_ray.origin, bsdfPdf, background.pdf);
+                return ret + ((background.value * weight) * misWeight);
+            }
+
+            const Light *emitter = its.instance->light();
+            const float emissionWeight =
+                emitter ? bsdfHitWeight(emitter, cur_ray.origin, bsdfPdf, emitter->directPdf(cur_ray.origin, its)) : 1;
+            ret += (its.evaluateEmission() * weight) * emissionWeight;
+
+            if (i == (depth - 1)) {
+                break;
+            }    
+
+            if (m_scene->hasLights()) {
+                ret += sampleLights(cur_ray(its.t), [&](const Vector &wi) { return its.evaluateBsdf(wi); }, rng) * weight;
+            }
+
+            // paths are split at their first vertex into continuations that are averaged, in proportion to the
+            // throughput they are expected to carry (dark surfaces reflect too little indirect light to be worth it).
+            // Each continuation keeps the undivided throughput until its result has been averaged, so that Russian
+            // roulette does not terminate split paths more often than the path they have been split from.
+            int splits = 1;
+            if (m_maxSplit > 1 && i == 0) {
+                const float expected = (weight * its.evaluateAlbedo()).maxComponent();
+                splits = std::clamp(int(std::round(m_maxSplit * expected)), 1, m_maxSplit);
+            }
+            if (splits > 1) {
+                for (int split = 0; split < splits; split++) {
+                    ret += continuePath(cur_ray, its, weight, i, rng) / float(splits);
+                }
+                break;
+            }
+
+            BsdfSample smp = its.sampleBsdf(rng);
+            if (smp.isInvalid()) {
+                // the direction of failed samples is meaningless (and would, e.g., confuse the traversal of media)
+                break;
+            }
+            weight *= smp.weight;
+            bsdfPdf = smp.pdf;
+            cur_ray = Ray(cur_ray(its.t), smp.wi).normalized();
+
+            if (!survivesRoulette(weight, i + 1, rng)) {
+                break;
+            }
+        }
+
+        return ret;
+    }
+
+    /// @brief Samples the Bsdf at the given path vertex and traces the remainder of the path.
+    Color continuePath(const Ray &cur_ray, const Intersection &its, Color weight, int bounce, Sampler &rng) const {
+        BsdfSample smp = its.sampleBsdf(rng);
+        if (smp.isInvalid()) {
+            return Color(0.f);
+        }
+        weight *= smp.weight;
+        if (!survivesRoulette(weight, bounce + 1, rng)) {
+            return Color(0.f);
+        }
+        return tracePath(Ray(cur_ray(its.t), smp.wi).normalized(), weight, bounce + 1, smp.pdf, rng);
+    }
+
+    /**
+     * @brief Randomly terminates paths with low throughput once they have reached @c m_rrDepth bounces, and scales
+     * the throughput of the surviving paths accordingly.
+     */
+    bool survivesRoulette(Color &weight, int bounce, Sampler &rng) const {
+        if (m_rrDepth < 0 || bounce < m_rrDepth) return true;
+        const float survival = std::min(weight.maxComponent(), m_rrMaxSurvival);
+        if (survival <= 0 || rng.next() >= survival) return false;
+        weight /= survival;
+        return true;
+    }
+
+public:
+    PathTracerIntegrator(const Properties &properties, const SamplingOptions &supported = SamplingOptions::all())
+    : SamplingIntegrator(properties, supported) {
+        depth = properties.get<int>("depth", 2);
+        m_mis = properties.get<bool>("mis", false);
+        m_rrDepth = properties.get<int>("rrDepth", -1);
+        m_rrMaxSurvival = properties.get<float>("rrMaxSurvival", 0.95f);
+        m_lightSamples = std::max(properties.get<int>("lightSamples", 1), 1);
+        m_maxSplit = std::max(properties.get<int>("maxSplit", 1), 1);
+    }
+
+    Color Li(const Ray &ray, Sampler &rng) override {
+        // camera rays cannot be found by light sampling
+        return tracePath(ray, Color(1.f), 0, Infinity, rng);
+    }
+
+    /// @brief Returns the incident radiance for a camera ray whose intersection @c its has already been found.
+    Color Li(const Ray &ray, const Intersection &its, Sampler &rng) const {
+        return tracePath(ray, Color(1.f), 0, Infinity, rng, &its);
+    }
+
+    /// @brief An optional textual representation of this class, which can be useful for debugging. 
+    std::string toString() const override {
+        return tfm::format(
+            "PathTracerIntegrator[\n"
+            "  depth = %d,\n"
+            "  mis = %s,\n"
+            "  rrDepth = %d,\n"
+            "  rrMaxSurvival = %f,\n"
+            "  lightSamples = %d,\n"
+            "  maxSplit = %d,\n"
+            "  sampler = %s,\n"
+            "  image = %s,\n"
+            "]",
+            depth,
+            m_mis,
+            m_rrDepth,
+            m_rrMaxSurvival,
+            m_lightSamples,
+            m_maxSplit,
+            indent(m_sampler),
+            indent(m_image)
+        );
+    }
+};
+
+}
@@ -0,0 +1,338 @@
+#include <lightwave.hpp>
+
+#include "hashgrid.hpp"
+
+#include <atomic>
+
+namespace lightwave {
+
+/**
+ * @brief A progressive photon mapper ("stochastic progressive photon mapping"), which renders light paths that are
+ * hard to find from the camera, such as caustics seen through or reflected by specular surfaces.
+ * Rendering proceeds in iterations (one per sample of the sampler). Each iteration traces one camera path per pixel
+ * through specular surfaces up to the first non-specular one (the visible point), where direct illumination is
+ * estimated like in the @c pathtracer integrator with MIS. Photons are then shot from all light sources in parallel, stored in a
+ * @ref HashGrid , and gathered at the visible points within a radius that shrinks from iteration to iteration. This
+ * keeps the memory fixed while the (biased, but consistent) estimate converges.
+ * @see "Stochastic Progressive Photon Mapping" (Hachisuka and Jensen, 2009)
+ * @note Emissive surfaces without a light do not emit photons, so only their direct illumination is rendered.
+ * @note Bsdfs are assumed to be either entirely specular or entirely non-specular.
+ * @note The options of progressive and adaptive rendering and tile ordering do not apply to this integrator, whose
+ * iterations already refine the entire image.
+ */
+class PhotonMapper : public SamplingIntegrator {
+    /// @brief A photon that has arrived at a non-specular surface.
+    struct Photon {
+        Point position;
+        /// @brief The direction the photon has arrived from, pointing away from the surface.
+        Vector wi;
+        /// @brief The flux carried by the photon (before dividing by the number of photons).
+        Color power;
+        /// @brief The number of path segments between the light source and the photon.
+        int segments;
+    };
+
+    /// @brief The state of a pixel, which is refined with every iteration.
+    struct PixelState {
+        /// @brief The sum of the emitted and directly reflected light of all iterations.
+        Color direct;
+        /// @brief The unnormalized flux that has been gathered within the (shrinking) radius.
+        Color tau;
+        /// @brief The accumulated number of photons that have been gathered (reduced with every iteration).
+        float photons = 0;
+        float radius;
+
+        /// @brief The first non-specular surface seen by the camera path of the current iteration.
+        Intersection its;
+        Point position;
+        /// @brief The throughput of the camera path up to (and including) the visible point.
+        Color beta;
+        /// @brief The number of path segments between the camera and the visible point.
+        int segments;
+        bool valid;
+
+        /// @brief The flux that has been gathered in the current iteration.
+        Color phi;
+        /// @brief The number of photons that have been gathered in the current iteration.
+        int count;
+    };
+
+    /// @brief The maximum number of path segments, as for the @c pathtracer integrator.
+    int m_depth;
+    /// @brief The number of photon paths traced in each iteration.
+    int m_photonsPerIteration;
+    /// @brief The radius photons are gathered within in the first iteration (negative to derive it from the scene).
+    float m_initialRadius;
+    /// @brief The fraction of the newly gathered photons that are kept in each iteration, which controls how fast the
+    /// radius shrinks.
+    float m_alpha;
+
+    /**
+     * @brief Estimates the direct illumination at the given surface by combining a light sample and a Bsdf sample
+     * with multiple importance sampling (emissive surfaces without a light can only be found by the latter).
+     */
+    Color estimateDirect(const Point &origin, const Intersection &its, Sampler &rng) const {
+        Color result(0);
+        if (m_scene->hasLights()) {
+            const LightSample lightSample = m_scene->sampleLight(origin, rng);
+            if (!lightSample.isInvalid()) {
+                const DirectLightSample direct = lightSample.light->sampleDirect(origin, rng);
+                if (!direct.isInvalid() && !m_scene->intersect(Ray(origin, direct.wi), direct.distance, rng)) {
+                    const BsdfEval bsdf = its.evaluateBsdf(direct.wi);
+                    const float misWeight = powerHeuristic(lightSample.probability * direct.pdf, bsdf.pdf);
+                    result += bsdf.value * direct.weight * (misWeight / lightSample.probability);
+                }
+            }
+        }
+
+        const BsdfSample bsdfSample = its.sampleBsdf(rng);
+        if (bsdfSample.isInvalid()) return result;
+        const Ray ray = Ray(origin, bsdfSample.wi).normalized();
+        const Intersection hit = m_scene->intersect(ray, rng);
+        if (hit) {
+            // emissive surfaces with a light could also have been found by the light sample
+            const Light *light = hit.instance->light();
+            const float misWeight =
+                light ? powerHeuristic(bsdfSample.pdf,
+                                       m_scene->lightSelectionProbability(light, origin) * light->directPdf(origin, hit))
+                      : 1;
+            return result + hit.evaluateEmission() * bsdfSample.weight * misWeight;
+        }
+
+        const BackgroundLightEval background = m_scene->evaluateBackground(ray.direction);
+        const float lightPdf =
+            m_scene->background() ? m_scene->lightSelectionProbability(m_scene->background(), origin) * background.pdf
+                                  : 0;
+        return result + background.value * bsdfSample.weight * powerHeuristic(bsdfSample.pdf, lightPdf);
+    }
+
+    /**
+     * @brief Traces a camera path through specular surfaces, and stores the first non-specular surface it finds in the
+     * pixel state.
+     * @returns The light that has been emitted towards the camera along the path, and directly reflected by the
+     * non-specular surface.
+     */
+    Color traceCameraPath(Ray ray, Color beta, PixelState *state, Sampler &rng) const {
+        Color result(0);
+        for (int bounce = 0; bounce < m_depth; bounce++) {
+            const Intersection its = m_scene->intersect(ray, rng);
+            if (!its) {
+                result += m_scene->evaluateBackground(ray.direction).value * beta;
+                break;
+            }
+
+            result += its.evaluateEmission() * beta;
+            if (bounce == m_depth - 1) break;
+
+            const Point origin = ray(its.t);
+            const BsdfSample bsdfSample = its.sampleBsdf(rng);
+            if (!bsdfSample.isDelta()) {
+                // light arriving here directly is estimated explicitly, all other light is gathered from photons
+                result += estimateDirect(origin, its, rng) * beta;
+                if (state) {
+                    state->its = its;
+                    state->position = origin;
+                    state->beta = beta;
+                    state->segments = bounce + 1;
+                    state->valid = true;
+                }
+                break;
+            }
+
+            beta *= bsdfSample.weight;
+            if (beta == Color(0)) break;
+            ray = Ray(origin, bsdfSample.wi).normalized();
+        }
+        return result;
+    }
+
+    /**
+     * @brief Traces a photon path from a randomly picked light source, and appends the photons it deposits on
+     * non-specular surfaces.
+     * Photons that arrive directly from the light are not stored, as direct illumination is sampled explicitly.
+     */
+    void tracePhoton(const Bounds &sceneBounds, std::vector<Photon> &photons, Sampler &rng) const {
+        const LightSample lightSample = m_scene->sampleAreaLight(rng);
+        const EmissionSample emission = lightSample.light->sampleEmission(sceneBounds, rng);
+        if (emission.isInvalid()) return;
+
+        Ray ray = emission.ray;
+        Color beta = emission.weight / lightSample.probability;
+        // the camera path needs at least one segment to reach the visible point the photon is gathered at
+        for (int segments = 1; segments < m_depth; segments++) {
+            const Intersection its = m_scene->intersect(ray, rng);
+            if (!its) break;
+
+            const BsdfSample bsdfSample = its.sampleAdjointBsdf(rng);
+            if (segments > 1 && !bsdfSample.isDelta()) {
+                photons.push_back({ ray(its.t), its.wo, beta, segments });
+            }
+
+            beta *= bsdfSample.weight;
+            if (bsdfSample.isInvalid() || beta == Color(0)) break;
+            ray = Ray(ray(its.t), bsdfSample.wi).normalized();
+        }
+    }
+
+public:
+    PhotonMapper(const Properties &properties)
+    : SamplingIntegrator(properties, {}) {
+        m_depth = std::max(properties.get<int>("depth", 2), 1);
+        m_photonsPerIteration = properties.get<int>("photons", -1);
+        m_initialRadius = properties.get<float>("radius", -1);
+        m_alpha = std::clamp(properties.get<float>("alpha", 2.f / 3), 0.f, 1.f);
+    }
+
+    void execute() override {
+        if (!m_image) {
+            lightwave_throw("<integrator /> needs an <image /> child to render into!");
+        }
+        if (m_scene->hasMedia()) {
+            lightwave_throw("the photonmapper integrator does not support participating media (use the pathtracer integrator)");
+        }
+
+        const Vector2i resolution = m_scene->camera()->resolution();
+        const int numPixels = resolution.product();
+        const int iterations = m_sampler->samplesPerPixel();
+        const int photonsPerIteration = m_photonsPerIteration > 0 ? m_photonsPerIteration : numPixels;
+        m_image->resize(resolution);
+
+        Bounds sceneBounds = m_scene->getBoundingBox();
+        if (sceneBounds.isUnbounded() || sceneBounds.diagonal().x() < 0) sceneBounds = Bounds(Point(-1), Point(1));
+        const float initialRadius =
+            m_initialRadius > 0 ? m_initialRadius : 0.01f * sceneBounds.diagonal().length();
+
+        std::vector<PixelState> pixels(numPixels);
+        for (auto &state : pixels)
+            state.radius = initialRadius;
+
+        ThreadPool &pool = ThreadPool::global();
+        const int numThreads = pool.numThreads();
+        std::vector<ref<Sampler>> samplers;
+        for (int i = 0; i < numThreads; i++)
+            samplers.push_back(m_sampler->clone());
+        std::vector<std::vector<Photon>> threadPhotons(numThreads);
+        std::vector<Photon> photons;
+        HashGrid<Photon> grid;
+
+        Timer timer;
+        Streaming stream { *m_image };
+        ProgressReporter progress { iterations };
+        for (int iteration = 0; iteration < iterations; iteration++) {
+            // find the visible points of all pixels
+            parallel_for(Range(0, resolution.y()), [&](int y) {
+                auto &sampler = *samplers[pool.threadIndex()];
+                for (int x = 0; x < resolution.x(); x++) {
+                    AssertNoAllocations guard { "tracing a camera path" };
+                    const Point2i pixel { x, y };
+                    PixelState &state = pixels[y * resolution.x() + x];
+                    state.valid = false;
+                    state.phi = Color(0);
+                    state.count = 0;
+
+                    sampler.seed(pixel, iteration);
+                    const auto cameraSample = m_scene->camera()->sample(pixel, sampler);
+                    state.direct += traceCameraPath(cameraSample.ray, cameraSample.weight, &state, sampler);
+                }
+            });
+
+            // shoot photons, with threads claiming chunks of photon paths
+            if (m_scene->hasLights()) {
+                constexpr int ChunkSize = 1024;
+                std::atomic<int> nextPhoton { 0 };
+                // the buffers are keyed by the loop index, as one thread may run several indices of the loop
+                parallel_for(Range(0, numThreads), [&](int worker) {
+                    auto &sampler = *samplers[worker];
+                    auto &deposited = threadPhotons[worker];
+                    deposited.clear();
+                    for (int first; (first = nextPhoton.fetch_add(ChunkSize)) < photonsPerIteration;) {
+                        for (int index = first; index < std::min(first + ChunkSize, photonsPerIteration); index++) {
+                            // photons use negative pixel coordinates, so that they never share seeds with camera paths
+                            sampler.seed(Point2i(-1, index), iteration);
+                            tracePhoton(sceneBounds, deposited, sampler);
+                        }
+                    }
+                });
+            }
+
+            photons.clear();
+            for (const auto &deposited : threadPhotons)
+                photons.insert(photons.end(), deposited.begin(), deposited.end());
+
+            float maxRadius = 0;
+            for (const auto &state : pixels)
+                maxRadius = std::max(maxRadius, state.radius);
+            grid.build(photons, 2 * maxRadius, [](const Photon &photon) { return photon.position; });
+
+            // gather the photons around the visible points, and shrink the radius for the next iteration
+            parallel_for(Range(0, numPixels), [&](int index) {
+                PixelState &state = pixels[index];
+                if (state.valid) {
+                    const float radius2 = sqr(state.radius);
+                    grid.query(state.position, state.radius, [&](const Photon &photon) {
+                        if (state.segments + photon.segments > m_depth) return;
+                        if ((photon.position - state.position).lengthSquared() > radius2) return;
+
+                        // the Bsdf is evaluated without the cosine, which is accounted for by the photon density
+                        const float cosTheta = std::abs(state.its.frame.normal.dot(photon.wi));
+                        if (cosTheta == 0) return;
+                        state.phi += photon.power * state.its.evaluateBsdf(photon.wi).value / cosTheta;
+                        state.count++;
+                    });
+                }
+
+                if (state.count > 0) {
+                    const float photons = state.photons + m_alpha * state.count;
+                    const float radius = state.radius * std::sqrt(photons / (state.photons + state.count));
+                    state.tau = (state.tau + state.beta * state.phi) * sqr(radius / state.radius);
+                    state.photons = photons;
+                    state.radius = radius;
+                }
+            }, 1024);
+
+            const float totalPhotons = float(iteration + 1) * float(photonsPerIteration);
+            parallel_for(Range(0, resolution.y()), [&](int y) {
+                for (int x = 0; x < resolution.x(); x++) {
+                    const PixelState &state = pixels[y * resolution.x() + x];
+                    m_image->get({ x, y }) = state.direct / float(iteration + 1) +
+                                             state.tau / (totalPhotons * Pi * sqr(state.radius));
+                }
+            });
+            stream.update();
+            progress += 1;
+            logger(EDebug, "iteration %d: %d photons stored", iteration, int(photons.size()));
+        }
+        progress.finish();
+        logger(EInfo, "rendered %d iterations with %d photons each in %.1f seconds", iterations, photonsPerIteration,
+               timer.getElapsedTime());
+
+        stream.update();
+        m_image->save();
+    }
+
+    /// @brief Estimates the radiance along a single ray without photons, i.e., only emitted and direct illumination.
+    Color Li(const Ray &ray, Sampler &rng) override {
+        return traceCameraPath(ray, Color(1), nullptr, rng);
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "PhotonMapper[\n"
+            "  depth = %d,\n"
+            "  photons = %d,\n"
+            "  alpha = %f,\n"
+            "  sampler = %s,\n"
+            "  image = %s,\n"
+            "]",
+            m_depth,
+            m_photonsPerIteration,
+            m_alpha,
+            indent(m_sampler),
+            indent(m_image)
+        );
+    }
+};
+
+}
+
+REGISTER_INTEGRATOR(PhotonMapper, "photonmapper")
@@ -0,0 +1,268 @@
+#include "pathtracer.hpp"
+
+#include "../samplers/pcg32.h"
+
+#include <atomic>
+
+namespace lightwave {
+
+/**
+ * @brief A sampler that provides the coordinates of a point in primary sample space (i.e., the random numbers that
+ * determine a path), and mutates them for Metropolis sampling.
+ * Coordinates are created lazily when they are first requested, and small steps that a coordinate has missed while it
+ * was not used are caught up on when it is requested again. Paths of varying length can thus be mutated without
+ * knowing their dimension in advance. Mutations can be undone, and a sampler that is created with the same seed
+ * replays the same sequence of random numbers.
+ * @see "A Simple and Robust Mutation Strategy for the Metropolis Light Transport Algorithm" (Kelemen et al., 2002)
+ */
+class PrimarySampleSpaceSampler : public Sampler {
+    struct PrimarySample {
+        float value = 0;
+        /// @brief The iteration in which the value has last been changed.
+        int64_t lastModification = 0;
+        /// @brief The state before the current iteration, which is restored if the mutation is rejected.
+        float backupValue = 0;
+        int64_t backupModification = 0;
+    };
+
+    std::vector<PrimarySample> m_samples;
+    pcg32 m_rng;
+    /// @brief The standard deviation of small steps.
+    float m_sigma;
+    float m_largeStepProbability;
+    int64_t m_iteration = 0;
+    int64_t m_lastLargeStep = 0;
+    bool m_largeStep = true;
+    /// @brief The index of the next coordinate that is handed out in this iteration.
+    int m_index = 0;
+
+    void ensureReady(int index) {
+        if (index >= int(m_samples.size())) m_samples.resize(index + 1);
+        PrimarySample &sample = m_samples[index];
+
+        // coordinates that have not been used since the last large step take part in it retroactively
+        if (sample.lastModification < m_lastLargeStep) {
+            sample.value = m_rng.nextFloat();
+            sample.lastModification = m_lastLargeStep;
+        }
+
+        sample.backupValue = sample.value;
+        sample.backupModification = sample.lastModification;
+        if (m_largeStep) {
+            sample.value = m_rng.nextFloat();
+        } else {
+            // the small steps that have been missed add up to a single normally distributed step
+            const int64_t steps = m_iteration - sample.lastModification;
+            const float u1 = std::max(m_rng.nextFloat(), Epsilon), u2 = m_rng.nextFloat();
+            const float normal = std::sqrt(-2 * std::log(u1)) * std::cos(2 * Pi * u2);
+            sample.value += normal * m_sigma * std::sqrt(float(steps));
+            sample.value = std::min(sample.value - std::floor(sample.value), OneMinusEpsilon);
+        }
+        sample.lastModification = m_iteration;
+    }
+
+public:
+    PrimarySampleSpaceSampler(uint64_t seed, float sigma, float largeStepProbability)
+    : m_sigma(sigma), m_largeStepProbability(largeStepProbability) {
+        m_rng.seed(1337, seed);
+    }
+
+    /// @brief Starts a new mutation, which is either a small step or (with some probability) a large step.
+    void startIteration() {
+        m_iteration++;
+        m_largeStep = m_rng.nextFloat() < m_largeStepProbability;
+        m_index = 0;
+    }
+
+    /// @brief Keeps the mutation of the current iteration.
+    void accept() {
+        if (m_largeStep) m_lastLargeStep = m_iteration;
+    }
+
+    /// @brief Undoes the mutation of the current iteration.
+    void reject() {
+        for (auto &sample : m_samples) {
+            if (sample.lastModification == m_iteration) {
+                sample.value = sample.backupValue;
+                sample.lastModification = sample.backupModification;
+            }
+        }
+        m_iteration--;
+    }
+
+    float next() override {
+        const int index = m_index++;
+        ensureReady(index);
+        return m_samples[index].value;
+    }
+
+    // the random numbers are given by the state of the Markov chain instead
+    void seed(int index) override {}
+    void seed(const Point2i &pixel, int sampleIndex) override {}
+
+    ref<Sampler> clone() const override {
+        return std::make_shared<PrimarySampleSpaceSampler>(*this);
+    }
+
+    std::string toString() const override {
+        return tfm::format("PrimarySampleSpaceSampler[\n"
+                           "  sigma = %f,\n"
+                           "  largeStepProbability = %f\n"
+                           "]",
+                           m_sigma, m_largeStepProbability);
+    }
+};
+
+/**
+ * @brief Primary sample space Metropolis light transport ("PSSMLT"), which explores the paths of the @c pathtracer
+ * integrator with Markov chains that mutate the random numbers the paths are generated from.
+ * Once a chain has found a path that carries light, small mutations find similar paths nearby, which helps in scenes
+ * in which only few paths contribute (e.g., light arriving through small openings). Large steps (independent paths)
+ * keep the chains from getting stuck. As paths can land on any pixel, all contributions are splatted into a
+ * @ref SplatFilm .
+ *
+ * Chains are independent and distributed over the threads. They start from paths picked from a uniform bootstrap pass
+ * in proportion to their luminance. The same pass also estimates the average image luminance, which normalizes the
+ * result. The total number of mutations is the number of samples per pixel times the number of pixels, and all
+ * options of the @c pathtracer integrator apply to the paths.
+ * @see "A Simple and Robust Mutation Strategy for the Metropolis Light Transport Algorithm" (Kelemen et al., 2002)
+ * @note Progressive and adaptive rendering and tile ordering do not apply to this integrator, as the samples of a
+ * pixel are not known in advance.
+ */
+class PrimarySampleSpaceMLT : public PathTracerIntegrator {
+    /// @brief The number of paths used to estimate the normalization and to pick the starting points of the chains.
+    int m_bootstrapSamples;
+    /// @brief The number of independent Markov chains.
+    int m_chains;
+    /// @brief The standard deviation of small steps in primary sample space.
+    float m_sigma;
+    float m_largeStepProbability;
+
+    struct PathSample {
+        Point2i pixel;
+        Color value;
+    };
+
+    /// @brief Generates a path (including the pixel it belongs to) from the coordinates of the sampler.
+    PathSample evaluate(Sampler &sampler) {
+        const Vector2i resolution = m_scene->camera()->resolution();
+        const Point2 u = sampler.next2D();
+        const Point2i pixel { std::min(int(u.x() * resolution.x()), resolution.x() - 1),
+                              std::min(int(u.y() * resolution.y()), resolution.y() - 1) };
+        const auto cameraSample = m_scene->camera()->sample(pixel, sampler);
+        return { pixel, cameraSample.weight * Li(cameraSample.ray, sampler) };
+    }
+
+public:
+    PrimarySampleSpaceMLT(const Properties &properties)
+    : PathTracerIntegrator(properties, {}) {
+        m_bootstrapSamples = std::max(properties.get<int>("bootstrapSamples", 100000), 1);
+        m_chains = std::max(properties.get<int>("chains", 1000), 1);
+        m_sigma = properties.get<float>("sigma", 0.01f);
+        m_largeStepProbability = std::clamp(properties.get<float>("largeStepProbability", 0.3f), 0.f, 1.f);
+    }
+
+    void execute() override {
+        if (!m_image) {
+            lightwave_throw("<integrator /> needs an <image /> child to render into!");
+        }
+
+        const Vector2i resolution = m_scene->camera()->resolution();
+        const int samplesPerPixel = m_sampler->samplesPerPixel();
+        const int64_t totalMutations = int64_t(samplesPerPixel) * resolution.product();
+        const int numChains = int(std::min<int64_t>(m_chains, totalMutations));
+        m_image->initialize(resolution);
+        SplatFilm film { resolution };
+
+        Timer timer;
+        Streaming stream { *m_image };
+
+        // the seeds of the bootstrap paths let chains replay them as their starting points
+        std::vector<float> luminances(m_bootstrapSamples);
+        parallel_for(Range(0, m_bootstrapSamples), [&](int index) {
+            PrimarySampleSpaceSampler sampler(index, m_sigma, m_largeStepProbability);
+            luminances[index] = evaluate(sampler).value.luminance();
+        }, 256);
+
+        double sum = 0;
+        for (float luminance : luminances)
+            sum += luminance;
+        const float normalization = float(sum / m_bootstrapSamples);
+        if (normalization <= 0) {
+            logger(EWarn, "no bootstrap path carries light, the image will be black");
+            m_image->save();
+            return;
+        }
+        const AliasTable bootstrap { luminances };
+
+        ProgressReporter progress { numChains };
+        std::atomic<int> nextChain { 0 };
+        std::atomic<int64_t> acceptedMutations { 0 };
+        parallel_for(Range(0, ThreadPool::global().numThreads()), [&](int) {
+            for (int chain; (chain = nextChain.fetch_add(1)) < numChains;) {
+                const int64_t mutations = totalMutations / numChains + (chain < totalMutations % numChains);
+                pcg32 rng;
+                rng.seed(1337, (uint64_t(1) << 32) + chain);
+
+                PrimarySampleSpaceSampler sampler(bootstrap.sample(rng.nextFloat()), m_sigma, m_largeStepProbability);
+                PathSample current = evaluate(sampler);
+                int64_t accepted = 0;
+                for (int64_t mutation = 0; mutation < mutations; mutation++) {
+                    sampler.startIteration();
+                    const PathSample proposed = evaluate(sampler);
+
+                    // both states receive the expected value of their contribution (normalized to unit luminance)
+                    const float currentLuminance = current.value.luminance();
+                    const float proposedLuminance = proposed.value.luminance();
+                    const float acceptance =
+                        currentLuminance > 0 ? std::min(1.f, proposedLuminance / currentLuminance) : 1;
+                    if (proposedLuminance > 0)
+                        film.splat(proposed.pixel, proposed.value * (acceptance / proposedLuminance));
+                    if (currentLuminance > 0)
+                        film.splat(current.pixel, current.value * ((1 - acceptance) / currentLuminance));
+
+                    if (rng.nextFloat() < acceptance) {
+                        current = proposed;
+                        sampler.accept();
+                        accepted++;
+                    } else {
+                        sampler.reject();
+                    }
+                }
+                acceptedMutations += accepted;
+                progress += 1;
+            }
+        });
+        progress.finish();
+
+        // every mutation has splatted a luminance of one, while the image has an average luminance of the normalization
+        film.addTo(*m_image, normalization / samplesPerPixel);
+        logger(EInfo, "rendered %lld mutations in %d chains (%.1f%% accepted) in %.1f seconds",
+               (long long) totalMutations, numChains, 100.0 * acceptedMutations / totalMutations,
+               timer.getElapsedTime());
+
+        stream.update();
+        m_image->save();
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "PrimarySampleSpaceMLT[\n"
+            "  chains = %d,\n"
+            "  bootstrapSamples = %d,\n"
+            "  sigma = %f,\n"
+            "  largeStepProbability = %f,\n"
+            "  paths = %s,\n"
+            "]",
+            m_chains,
+            m_bootstrapSamples,
+            m_sigma,
+            m_largeStepProbability,
+            indent(PathTracerIntegrator::toString())
+        );
+    }
+};
+
+}
+
+REGISTER_INTEGRATOR(PrimarySampleSpaceMLT, "pssmlt")
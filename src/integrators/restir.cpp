@@ -0,0 +1,422 @@
+#include <lightwave.hpp>
+
+#include <array>
+#include <atomic>
+
+namespace lightwave {
+
+/**
+ * @brief Renders direct illumination by resampling light samples with reservoirs ("ReSTIR"), which gives usable
+ * previews of scenes with many lights (and environment maps) at very few samples per pixel.
+ * Every pixel streams a number of candidate light samples through a reservoir (weighted reservoir sampling), which
+ * keeps one of them in proportion to its unshadowed contribution. Reservoirs are then combined with those of the same
+ * pixel in the previous pass (temporal reuse) and with those of random neighbouring pixels (spatial reuse), so that
+ * each pixel effectively chooses from thousands of candidates while only tracing one shadow ray. Neighbours are only
+ * reused if their surfaces have similar normals and depths. Emissive surfaces without a light source are found by an
+ * additional Bsdf sample, as for the @c direct integrator.
+ *
+ * Reservoirs only keep samples that are visible from their pixel, and reused samples are weighted by how likely each
+ * of the combined pixels is to have produced them (pairwise MIS over their target functions), which keeps the result
+ * unbiased at the cost of a shadow ray per reused reservoir. Without these shadow rays (@c unbiased set to
+ * false), shadow boundaries darken slightly. Every sample per pixel is one pass over the image, in which each step
+ * runs in parallel over tiles, and passes are accumulated progressively (until @c timeBudget is exhausted, if given).
+ * @see "Spatiotemporal Reservoir Resampling for Real-Time Ray Tracing with Dynamic Direct Lighting" (Bitterli et
+ * al., 2020)
+ * @see "A Gentle Introduction to ReSTIR: Path Reuse in Real-time" (Wyman et al., 2023), for pairwise MIS
+ * @note Only lights that implement @ref Light::evaluateDirect can be reused.
+ */
+class ReSTIRIntegrator : public SamplingIntegrator {
+    /// @brief The most neighbours that can be reused per spatial iteration.
+    static constexpr int MaxNeighbors = 32;
+
+    /// @brief The number of light samples that are streamed through the reservoir of every pixel.
+    int m_candidates;
+    /// @brief The number of times reservoirs are combined with those of their neighbours per pass.
+    int m_spatialIterations;
+    /// @brief The number of neighbours that are reused per spatial iteration.
+    int m_spatialNeighbors;
+    /// @brief The radius (in pixels) in which neighbours are picked.
+    float m_spatialRadius;
+    bool m_temporal;
+    /**
+     * @brief The most candidates (relative to @c m_candidates ) the previous pass can account for. As passes are
+     * averaged, longer histories make them more alike rather than less noisy.
+     */
+    float m_temporalLimit;
+    /// @brief Whether reused samples are tested for visibility at all pixels they came from.
+    bool m_unbiased;
+
+    /// @brief A point on a light source (or, for lights infinitely far away, a direction) that is shared by pixels.
+    struct LightCandidate {
+        const Light *light = nullptr;
+        Point position;
+        Vector direction;
+        bool infinite = false;
+    };
+
+    struct Reservoir {
+        LightCandidate candidate;
+        float weightSum = 0;
+        /// @brief The number of candidates the reservoir has seen (reduced when the history is limited).
+        float count = 0;
+        /// @brief The unbiased contribution weight of the candidate (i.e., the reciprocal of its effective density).
+        float weight = 0;
+        /**
+         * @brief The target function of the candidate at the pixel of the reservoir. It is kept rather than recomputed,
+         * as finding a point near the silhouette of a light again is ill-conditioned, and values that differ by orders
+         * of magnitude would no longer cancel with the contribution weight.
+         */
+        float target = 0;
+
+        void add(const LightCandidate &c, float targetValue, float w, float u) {
+            if (!(w > 0)) return;
+            weightSum += w;
+            if (u * weightSum < w) {
+                candidate = c;
+                target = targetValue;
+            }
+        }
+    };
+
+    /// @brief The surface seen by the camera through a pixel.
+    struct PrimaryHit {
+        Intersection its;
+        Point origin;
+        /// @brief The weight of the camera sample.
+        Color weight;
+        /// @brief The light that is not found through reservoirs (emission, background and unsampled emitters).
+        Color radiance;
+
+        bool isSimilar(const PrimaryHit &other) const {
+            if (!its || !other.its) return false;
+            return its.frame.normal.dot(other.its.frame.normal) > 0.9f && std::abs(its.t - other.its.t) < 0.1f * its.t;
+        }
+    };
+
+    /// @brief Returns the unshadowed contribution of a light candidate, along with the shadow ray towards it.
+    Color evaluateCandidate(const PrimaryHit &hit, const LightCandidate &candidate, Vector &wi, float &distance,
+                            Sampler &rng) const {
+        if (candidate.infinite) {
+            wi = candidate.direction;
+            distance = Infinity;
+        } else {
+            const Vector offset = candidate.position - hit.origin;
+            distance = offset.length();
+            if (distance == 0) return Color(0);
+            wi = offset / distance;
+        }
+
+        const Color incident = candidate.light->evaluateDirect(hit.origin, wi, distance, rng);
+        if (incident == Color(0)) return Color(0);
+        return hit.its.evaluateBsdf(wi).value * incident;
+    }
+
+    /// @brief The function reservoirs sample in proportion to, which is the luminance of the unshadowed contribution.
+    float target(const PrimaryHit &hit, const LightCandidate &candidate, Sampler &rng) const {
+        Vector wi;
+        float distance;
+        return std::max(evaluateCandidate(hit, candidate, wi, distance, rng).luminance(), 0.f);
+    }
+
+    bool isVisible(const PrimaryHit &hit, const LightCandidate &candidate, Sampler &rng) const {
+        Vector wi;
+        float distance;
+        if (evaluateCandidate(hit, candidate, wi, distance, rng) == Color(0)) return false;
+        return !m_scene->intersect(Ray(hit.origin, wi), distance, rng);
+    }
+
+    PrimaryHit tracePrimary(const Ray &ray, const Color &weight, Sampler &rng) const {
+        PrimaryHit hit;
+        hit.weight = weight;
+        hit.its = m_scene->intersect(ray, rng);
+        if (!hit.its) {
+            hit.radiance = m_scene->evaluateBackground(ray.direction).value;
+            return hit;
+        }
+
+        hit.origin = ray(hit.its.t);
+        hit.radiance = hit.its.evaluateEmission();
+
+        // emission that reservoirs cannot find (the background is a light, and is hence sampled by them), which for
+        // specular Bsdfs is all of it, as light samples never lie in their (delta) lobes
+        const BsdfSample bsdfSample = hit.its.sampleBsdf(rng);
+        if (!bsdfSample.isInvalid()) {
+            const Ray next { hit.origin, bsdfSample.wi };
+            const Intersection nextIts = m_scene->intersect(next.normalized(), rng);
+            if (!nextIts) {
+                if (bsdfSample.isDelta())
+                    hit.radiance += bsdfSample.weight * m_scene->evaluateBackground(next.direction).value;
+            } else if (bsdfSample.isDelta() || !nextIts.instance->light()) {
+                hit.radiance += bsdfSample.weight * nextIts.evaluateEmission();
+            }
+        }
+        return hit;
+    }
+
+    /// @brief Returns the radiance a pixel receives when its reservoir is shaded with a single shadow ray.
+    Color shade(const PrimaryHit &hit, const Reservoir &reservoir, Sampler &rng) const {
+        Color value = hit.radiance;
+        if (reservoir.weight > 0) {
+            Vector wi;
+            float distance;
+            const Color contribution = evaluateCandidate(hit, reservoir.candidate, wi, distance, rng);
+            const float luminance = contribution.luminance();
+            // the magnitude is taken from the target function the reservoir has been weighted with
+            if (luminance > 0 && !m_scene->intersect(Ray(hit.origin, wi), distance, rng))
+                value += contribution * (reservoir.weight * reservoir.target / luminance);
+        }
+        return value;
+    }
+
+    /// @brief Streams the initial candidates of a pixel through a reservoir.
+    Reservoir sampleCandidates(const PrimaryHit &hit, Sampler &rng) const {
+        Reservoir reservoir;
+        if (!hit.its || !m_scene->hasLights()) return reservoir;
+
+        for (int i = 0; i < m_candidates; i++) {
+            const LightSample lightSample = m_scene->sampleLight(hit.origin, rng);
+            if (lightSample.isInvalid()) continue;
+            const DirectLightSample direct = lightSample.light->sampleDirect(hit.origin, rng);
+            if (direct.isInvalid()) continue;
+
+            LightCandidate candidate;
+            candidate.light = lightSample.light;
+            candidate.infinite = std::isinf(direct.distance);
+            candidate.direction = direct.wi;
+            if (!candidate.infinite) candidate.position = hit.origin + direct.distance * direct.wi;
+
+            // the ratio of target and source density equals the luminance of the usual one sample estimate
+            const Color contribution =
+                hit.its.evaluateBsdf(direct.wi).value * direct.weight / lightSample.probability;
+            // the target function is only evaluated for the candidate that is kept
+            reservoir.add(candidate, 0, contribution.luminance(), rng.next());
+        }
+        reservoir.count = float(m_candidates);
+
+        reservoir.target = reservoir.weightSum > 0 ? target(hit, reservoir.candidate, rng) : 0;
+        reservoir.weight = reservoir.target > 0 ? reservoir.weightSum / (reservoir.count * reservoir.target) : 0;
+        return reservoir;
+    }
+
+    /// @brief The weight of the first of two strategies under the balance heuristic (zero if it does not apply).
+    static float balance(float a, float b) { return a > 0 ? a / (a + b) : 0; }
+
+    /**
+     * @brief Combines the reservoirs of several pixels into one for the first of them (the "canonical" reservoir).
+     * Samples are weighted with pairwise MIS: every neighbour forms a pair with the canonical pixel, and within each
+     * pair, the balance heuristic over the target functions (scaled by their number of candidates) splits the weight
+     * of a sample between the two. Unlike normalizing by the number of candidates of all pixels that could have
+     * produced the sample ("1/Z"), this keeps the resampling weights bounded when a sample is much more important to
+     * the pixel than to the neighbour it came from (e.g., a point that the neighbour sees at a grazing angle).
+     * The canonical sample is tested for visibility at every neighbour (unless unbiased results are not required),
+     * as neighbours only produce samples that are visible from them.
+     */
+    Reservoir combine(const PrimaryHit *const *hits, const Reservoir *const *reservoirs, int count,
+                      Sampler &rng) const {
+        const PrimaryHit &hit = *hits[0];
+        const Reservoir &canonical = *reservoirs[0];
+        const float pairs = float(count - 1);
+
+        Reservoir result;
+        if (canonical.weight > 0) {
+            float misWeight = 0;
+            for (int i = 1; i < count; i++) {
+                float neighborTarget = target(*hits[i], canonical.candidate, rng);
+                if (neighborTarget > 0 && m_unbiased && !isVisible(*hits[i], canonical.candidate, rng))
+                    neighborTarget = 0;
+                misWeight += balance(canonical.count * canonical.target, reservoirs[i]->count * neighborTarget);
+            }
+            result.add(canonical.candidate, canonical.target,
+                       misWeight / pairs * canonical.target * canonical.weight, rng.next());
+        }
+        for (int i = 1; i < count; i++) {
+            const Reservoir &r = *reservoirs[i];
+            if (!(r.weight > 0)) continue;
+            // the sample of a neighbour is visible from it, as reservoirs only keep visible samples
+            const float pHat = target(hit, r.candidate, rng);
+            const float misWeight = balance(r.count * r.target, canonical.count * pHat);
+            result.add(r.candidate, pHat, misWeight / pairs * pHat * r.weight, rng.next());
+        }
+        for (int i = 0; i < count; i++)
+            result.count += reservoirs[i]->count;
+        if (!(result.weightSum > 0)) return result;
+
+        // reservoirs only hold samples that are visible from their pixel
+        if (!isVisible(hit, result.candidate, rng)) return result;
+        result.weight = result.weightSum / result.target;
+        return result;
+    }
+
+    /// @brief Runs a function for all pixels, in parallel over tiles, with the sampler seeded for the given step.
+    template<typename F>
+    void forEachPixel(int seed, F f) {
+        renderTiles(TileOrder::Spiral, [&](const Point2i &pixel, Sampler &sampler) {
+            sampler.seed(pixel, seed);
+            f(pixel, sampler);
+        });
+    }
+
+public:
+    ReSTIRIntegrator(const Properties &properties)
+    : SamplingIntegrator(properties, { .timeBudget = true }) {
+        m_candidates = std::max(properties.get<int>("candidates", 32), 1);
+        m_spatialIterations = std::max(properties.get<int>("spatialIterations", 2), 0);
+        m_spatialNeighbors = std::clamp(properties.get<int>("spatialNeighbors", 5), 0, MaxNeighbors);
+        m_spatialRadius = properties.get<float>("spatialRadius", 30);
+        m_temporal = properties.get<bool>("temporal", true);
+        m_temporalLimit = properties.get<float>("temporalLimit", 4);
+        m_unbiased = properties.get<bool>("unbiased", true);
+    }
+
+    void execute() override {
+        if (!m_image) {
+            lightwave_throw("<integrator /> needs an <image /> child to render into!");
+        }
+        if (m_scene->hasMedia()) {
+            lightwave_throw("the restir integrator does not support participating media (use the pathtracer integrator)");
+        }
+
+        const Vector2i resolution = m_scene->camera()->resolution();
+        const auto pixelIndex = [&](const Point2i &pixel) { return size_t(pixel.y()) * resolution.x() + pixel.x(); };
+        // the first pass assigns (rather than accumulates) every pixel
+        m_image->resize(resolution);
+
+        // the hits and final reservoirs of the previous pass are kept for temporal reuse
+        const size_t numPixels = size_t(resolution.product());
+        std::vector<PrimaryHit> hits(numPixels), previousHits(numPixels);
+        std::vector<Reservoir> reservoirs(numPixels), spatial(numPixels), previous(numPixels);
+
+        Timer timer;
+        Streaming stream { *m_image };
+        ProgressReporter progress { m_sampler->samplesPerPixel() };
+        const int stepsPerPass = m_spatialIterations + 2;
+
+        int pass = 0;
+        while (pass < m_sampler->samplesPerPixel()) {
+            const int seed = pass * stepsPerPass;
+
+            forEachPixel(seed, [&](const Point2i &pixel, Sampler &rng) {
+                const size_t index = pixelIndex(pixel);
+                const auto cameraSample = m_scene->camera()->sample(pixel, rng);
+                PrimaryHit &hit = hits[index];
+                hit = tracePrimary(cameraSample.ray, cameraSample.weight, rng);
+
+                Reservoir reservoir = sampleCandidates(hit, rng);
+                // only keep samples that are visible, so that neighbours do not pick up occluded lights
+                if (reservoir.weight > 0 && !isVisible(hit, reservoir.candidate, rng)) reservoir.weight = 0;
+
+                if (m_temporal && pass > 0 && hit.isSimilar(previousHits[index])) {
+                    Reservoir history = previous[index];
+                    history.count = std::min(history.count, m_temporalLimit * m_candidates);
+                    const PrimaryHit *pair[] = { &hit, &previousHits[index] };
+                    const Reservoir *pairReservoirs[] = { &reservoir, &history };
+                    reservoir = combine(pair, pairReservoirs, 2, rng);
+                }
+                reservoirs[index] = reservoir;
+            });
+
+            for (int iteration = 0; iteration < m_spatialIterations; iteration++) {
+                forEachPixel(seed + 1 + iteration, [&](const Point2i &pixel, Sampler &rng) {
+                    const size_t index = pixelIndex(pixel);
+                    std::array<const PrimaryHit *, MaxNeighbors + 1> neighborHits;
+                    std::array<const Reservoir *, MaxNeighbors + 1> neighborReservoirs;
+                    neighborHits[0] = &hits[index];
+                    neighborReservoirs[0] = &reservoirs[index];
+                    int count = 1;
+
+                    if (hits[index].its) {
+                        for (int i = 0; i < m_spatialNeighbors; i++) {
+                            const Point2 disk = squareToUniformDiskConcentric(rng.next2D());
+                            const Point2i neighbor { pixel.x() + int(std::round(disk.x() * m_spatialRadius)),
+                                                     pixel.y() + int(std::round(disk.y() * m_spatialRadius)) };
+                            if (neighbor == pixel || neighbor.x() < 0 || neighbor.y() < 0 ||
+                                neighbor.x() >= resolution.x() || neighbor.y() >= resolution.y())
+                                continue;
+
+                            const size_t neighborIndex = pixelIndex(neighbor);
+                            if (!hits[index].isSimilar(hits[neighborIndex])) continue;
+                            neighborHits[count] = &hits[neighborIndex];
+                            neighborReservoirs[count] = &reservoirs[neighborIndex];
+                            count++;
+                        }
+                    }
+
+                    spatial[index] = count > 1 ? combine(neighborHits.data(), neighborReservoirs.data(), count, rng)
+                                               : reservoirs[index];
+                });
+                std::swap(reservoirs, spatial);
+            }
+
+            forEachPixel(seed + stepsPerPass - 1, [&](const Point2i &pixel, Sampler &rng) {
+                const size_t index = pixelIndex(pixel);
+                const Color value = hits[index].weight * shade(hits[index], reservoirs[index], rng);
+
+                if (pass == 0) {
+                    m_image->get(pixel) = value;
+                } else {
+                    m_image->get(pixel) += value;
+                }
+            });
+
+            std::swap(hits, previousHits);
+            std::swap(reservoirs, previous);
+
+            pass++;
+            stream.normalize(1.0f / pass);
+            if (pass == 1) {
+                // only now all pixels have been written
+                stream.startRegularUpdates();
+            }
+            progress += 1;
+
+            if (m_timeBudget > 0 && timer.getElapsedTime() >= m_timeBudget) {
+                logger(EInfo, "time budget of %.1f seconds exhausted", m_timeBudget);
+                break;
+            }
+        }
+        progress.finish();
+
+        logger(EInfo, "rendered %d samples per pixel in %.1f seconds", pass, timer.getElapsedTime());
+
+        // turn the accumulated sums into the average
+        stream.stopRegularUpdates();
+        *m_image *= 1.0f / pass;
+        stream.normalize(1);
+        stream.update();
+
+        m_image->save();
+    }
+
+    /// @brief Estimates the direct illumination along a ray by resampling the candidates of a single reservoir.
+    Color Li(const Ray &ray, Sampler &rng) override {
+        const PrimaryHit hit = tracePrimary(ray, Color(1), rng);
+        return shade(hit, sampleCandidates(hit, rng), rng);
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "ReSTIRIntegrator[\n"
+            "  candidates = %d,\n"
+            "  spatialIterations = %d,\n"
+            "  spatialNeighbors = %d,\n"
+            "  spatialRadius = %f,\n"
+            "  temporal = %s,\n"
+            "  unbiased = %s,\n"
+            "  sampler = %s,\n"
+            "  image = %s,\n"
+            "]",
+            m_candidates,
+            m_spatialIterations,
+            m_spatialNeighbors,
+            m_spatialRadius,
+            m_temporal,
+            m_unbiased,
+            indent(m_sampler),
+            indent(m_image)
+        );
+    }
+};
+
+}
+
+REGISTER_INTEGRATOR(ReSTIRIntegrator, "restir")
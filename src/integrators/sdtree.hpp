@@ -0,0 +1,401 @@
+#pragma once
+
+#include <lightwave/core.hpp>
+#include <lightwave/math.hpp>
+#include <lightwave/parallel.hpp>
+#include <lightwave/sampler.hpp>
+
+#include <array>
+#include <vector>
+
+namespace lightwave::guiding {
+
+/**
+ * @brief Maps a direction to the unit square using cylindrical coordinates (cosine of the polar angle and azimuth),
+ * which preserves areas: every region of the square covers a solid angle of 4 pi times its area.
+ */
+inline Point2 directionToSquare(const Vector &direction) {
+    const float cosTheta = std::clamp(direction.z(), -1.f, 1.f);
+    float phi = std::atan2(direction.y(), direction.x());
+    if (phi < 0) phi += 2 * Pi;
+    return { std::min((cosTheta + 1) / 2, OneMinusEpsilon), std::min(phi * Inv2Pi, OneMinusEpsilon) };
+}
+
+/// @brief The inverse of @ref directionToSquare .
+inline Vector squareToDirection(const Point2 &p) {
+    const float cosTheta = 2 * p.x() - 1;
+    const float sinTheta = safe_sqrt(1 - sqr(cosTheta));
+    const float phi      = 2 * Pi * p.y();
+    return { sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta };
+}
+
+/**
+ * @brief A quadtree over the square of directions (see @ref directionToSquare ) that approximates the radiance
+ * arriving at a region of space, with finer subdivisions where more light arrives from.
+ * Each node stores the radiance of its four quadrants, and quadrants that are not subdivided further are the leaves
+ * of the tree. The structure is only changed between iterations, so that render threads can record radiance
+ * concurrently by atomically adding to the leaves.
+ */
+class DTree {
+    struct Node {
+        /// @brief The (unnormalized) radiance arriving from each quadrant.
+        std::array<float, 4> sums {};
+        /// @brief The index of the node subdividing each quadrant, or zero for quadrants that are leaves.
+        std::array<int, 4> children {};
+
+        float total() const { return sums[0] + sums[1] + sums[2] + sums[3]; }
+    };
+
+    std::vector<Node> m_nodes;
+    /// @brief The number of radiance samples that have been recorded in this tree.
+    int64_t m_sampleCount = 0;
+
+    /// @brief Finds the quadrant of the given node that contains the point, and maps the point into the quadrant.
+    static int descend(Point2 &p) {
+        const int x = p.x() >= 0.5f;
+        const int y = p.y() >= 0.5f;
+        p = Point2(2 * p.x() - x, 2 * p.y() - y);
+        return x + 2 * y;
+    }
+
+    /// @brief Computes the sums of all inner quadrants from the leaves below them.
+    float propagate(int index) {
+        Node &node = m_nodes[index];
+        for (int quadrant = 0; quadrant < 4; quadrant++) {
+            if (node.children[quadrant]) node.sums[quadrant] = propagate(node.children[quadrant]);
+        }
+        return m_nodes[index].total();
+    }
+
+public:
+    DTree() : m_nodes(1) {}
+
+    /// @brief Adds radiance that has been observed from the given direction (safe to call concurrently).
+    void record(const Vector &direction, float value) {
+        atomicAdd(m_sampleCount, int64_t(1));
+        if (!(value > 0)) return;
+
+        Point2 p = directionToSquare(direction);
+        int index = 0;
+        while (true) {
+            const int quadrant = descend(p);
+            Node &node = m_nodes[index];
+            if (!node.children[quadrant]) {
+                atomicAdd(node.sums[quadrant], value);
+                break;
+            }
+            index = node.children[quadrant];
+        }
+    }
+
+    /// @brief Samples a direction in proportion to the recorded radiance (uniformly if nothing has been recorded).
+    Vector sample(Sampler &rng) const {
+        Point2 origin { 0, 0 };
+        float size = 1;
+        float u = rng.next();
+        int index = 0;
+        while (true) {
+            const Node &node = m_nodes[index];
+            const float total = node.total();
+            if (total <= 0) break;
+
+            // reuse the random number for the decisions along the way down (never picking quadrants without radiance)
+            int last = 3;
+            while (node.sums[last] <= 0) last--;
+            int quadrant = 0;
+            float cdf = 0;
+            for (; quadrant < last; quadrant++) {
+                if (u < cdf + node.sums[quadrant] / total) break;
+                cdf += node.sums[quadrant] / total;
+            }
+            const float probability = node.sums[quadrant] / total;
+            u = std::clamp((u - cdf) / probability, 0.f, OneMinusEpsilon);
+
+            size /= 2;
+            origin = Point2(origin.x() + (quadrant & 1) * size, origin.y() + (quadrant >> 1) * size);
+            if (!node.children[quadrant]) break;
+            index = node.children[quadrant];
+        }
+
+        const Point2 offset = rng.next2D();
+        return squareToDirection(Point2(origin.x() + offset.x() * size, origin.y() + offset.y() * size));
+    }
+
+    /// @brief Returns the density (in solid angle) of @ref sample returning the given direction.
+    float pdf(const Vector &direction) const {
+        Point2 p = directionToSquare(direction);
+        float pdf = Inv4Pi;
+        int index = 0;
+        while (true) {
+            const Node &node = m_nodes[index];
+            const float total = node.total();
+            if (total <= 0) break;
+
+            const int quadrant = descend(p);
+            pdf *= 4 * node.sums[quadrant] / total;
+            if (!node.children[quadrant] || pdf == 0) break;
+            index = node.children[quadrant];
+        }
+        return pdf;
+    }
+
+    /// @brief The number of radiance samples that have been recorded in this tree.
+    int64_t sampleCount() const { return m_sampleCount; }
+    /// @brief The number of nodes of the tree.
+    int numNodes() const { return int(m_nodes.size()); }
+    /// @brief Reports whether any radiance has been recorded, i.e., whether sampling is better than uniform.
+    bool hasRadiance() const { return m_nodes[0].total() > 0; }
+
+    /// @brief Completes the recording phase by computing the sums of all inner quadrants.
+    void build() { propagate(0); }
+
+    /**
+     * @brief Creates an empty tree for the next iteration, in which quadrants are subdivided if they receive more than
+     * the given fraction of the radiance of this (built) tree, and merged otherwise.
+     * Quadrants that are subdivided for the first time are assumed to have their radiance evenly distributed.
+     */
+    DTree refined(float threshold, int maxDepth) const {
+        DTree result;
+        const float total = m_nodes[0].total();
+        if (total <= 0) return result;
+
+        struct Entry {
+            /// @brief The node of this tree that corresponds to the new node (negative if it does not exist).
+            int source;
+            /// @brief The node of the new tree.
+            int target;
+            int depth;
+            /// @brief The fraction of the radiance that arrives from the new node.
+            float fraction;
+        };
+        std::vector<Entry> stack { { 0, 0, 1, 1 } };
+        while (!stack.empty()) {
+            const Entry entry = stack.back();
+            stack.pop_back();
+
+            for (int quadrant = 0; quadrant < 4; quadrant++) {
+                const float fraction =
+                    entry.source >= 0 ? m_nodes[entry.source].sums[quadrant] / total : entry.fraction / 4;
+                if (fraction <= threshold || entry.depth >= maxDepth) continue;
+
+                const int child = int(result.m_nodes.size());
+                result.m_nodes.emplace_back();
+                result.m_nodes[entry.target].children[quadrant] = child;
+                const int source = entry.source >= 0 ? m_nodes[entry.source].children[quadrant] : 0;
+                stack.push_back({ source ? source : -1, child, entry.depth + 1, fraction });
+            }
+        }
+        return result;
+    }
+};
+
+/**
+ * @brief Learns the probability of sampling the Bsdf rather than the directional distribution of a region, by
+ * stochastic gradient descent (Adam) on the KL divergence between the mixture of both strategies and the product of
+ * Bsdf and incident radiance. The probability is parametrized by the logistic function of an unbounded variable.
+ * Render threads accumulate gradients with atomic additions, and the accumulated gradients of each batch (e.g., one
+ * sample per pixel) are applied in a single step once rendering of the batch has finished, so that the probability
+ * stays fixed while it is being read.
+ * @see "Path Guiding in Production" (Müller, 2019)
+ */
+class SamplingFractionOptimizer {
+    static constexpr float LearningRate = 0.1f;
+    static constexpr float Beta1 = 0.9f;
+    static constexpr float Beta2 = 0.999f;
+    /// @brief The strength of the L2 regularization, which keeps the variable from saturating the logistic function.
+    static constexpr float Regularization = 0.01f;
+
+    /// @brief The variable whose logistic function is the sampling fraction.
+    float m_variable = 0;
+    float m_firstMoment = 0;
+    float m_secondMoment = 0;
+    int m_steps = 0;
+    /// @brief The logistic function of @c m_variable .
+    float m_fraction = 0.5f;
+    /// @brief The sum of the gradients that have been recorded since the last step.
+    float m_gradientSum = 0;
+    /// @brief The number of gradients that have been recorded since the last step.
+    int64_t m_gradientCount = 0;
+
+    static float logistic(float x) { return 1 / (1 + std::exp(-x)); }
+
+public:
+    /// @brief Restarts learning from the given sampling fraction.
+    void reset(float fraction) {
+        *this = SamplingFractionOptimizer();
+        m_variable = std::clamp(std::log(fraction / (1 - fraction)), -20.f, 20.f);
+        m_fraction = logistic(m_variable);
+    }
+
+    /// @brief The current probability of sampling the Bsdf.
+    float fraction() const { return m_fraction; }
+
+    /**
+     * @brief Records the gradient for a direction that has been sampled from the mixture (safe to call concurrently).
+     * @param bsdfPdf The density of sampling the direction from the Bsdf.
+     * @param guidedPdf The density of sampling the direction from the directional distribution.
+     * @param samplePdf The density of the mixture the direction has actually been sampled with.
+     * @param product The luminance of the Bsdf value times the radiance arriving from the direction.
+     */
+    void record(float bsdfPdf, float guidedPdf, float samplePdf, float product) {
+        const float mixturePdf = m_fraction * bsdfPdf + (1 - m_fraction) * guidedPdf;
+        const float dLoss_dFraction = -product / (mixturePdf * samplePdf) * (bsdfPdf - guidedPdf);
+        const float gradient = dLoss_dFraction * m_fraction * (1 - m_fraction);
+        if (!std::isfinite(gradient)) return;
+
+        atomicAdd(m_gradientSum, gradient);
+        atomicAdd(m_gradientCount, int64_t(1));
+    }
+
+    /// @brief Takes a step with the average of the recorded gradients (not safe to call while rendering).
+    void step() {
+        if (m_gradientCount == 0) return;
+
+        const float gradient = m_gradientSum / float(m_gradientCount) + Regularization * m_variable;
+        m_gradientSum = 0;
+        m_gradientCount = 0;
+
+        m_steps++;
+        m_firstMoment = Beta1 * m_firstMoment + (1 - Beta1) * gradient;
+        m_secondMoment = Beta2 * m_secondMoment + (1 - Beta2) * gradient * gradient;
+        const float rate =
+            LearningRate * std::sqrt(1 - std::pow(Beta2, float(m_steps))) / (1 - std::pow(Beta1, float(m_steps)));
+        m_variable -= rate * m_firstMoment / (std::sqrt(m_secondMoment) + 1e-8f);
+        m_variable = std::clamp(m_variable, -20.f, 20.f);
+        m_fraction = logistic(m_variable);
+    }
+};
+
+/**
+ * @brief The directional distributions of one region of space: one that is used for sampling (learned in the
+ * previous iteration) and one that radiance is recorded into (which is used for sampling in the next iteration),
+ * together with the probability of sampling the Bsdf instead of them.
+ */
+struct DTreeWrapper {
+    DTree building;
+    DTree sampling;
+    SamplingFractionOptimizer bsdfSamplingFraction;
+};
+
+/**
+ * @brief A spatial-directional tree ("SD-tree") that learns the distribution of incident radiance throughout the
+ * scene while rendering: a binary tree over space, whose leaves each hold a quadtree over directions.
+ * Between iterations, regions of space that have received many samples are split in half, and the directional
+ * quadtrees are refined to resolve the radiance that has been recorded in more detail. During iterations, the
+ * structure stays fixed, so that all render threads can update it concurrently without locks.
+ * @see "Practical Path Guiding for Efficient Light-Transport Simulation" (Müller et al., 2017)
+ */
+class SDTree {
+    struct Node {
+        /// @brief The axis along which the node is split in half.
+        int axis;
+        /// @brief The index of the first child (the second one directly follows it), or zero for leaves.
+        int children;
+        /// @brief For leaves, the index of the directional distributions in @c m_leaves .
+        int leaf;
+    };
+
+    std::vector<Node> m_nodes;
+    std::vector<DTreeWrapper> m_leaves;
+    /// @brief The cube the tree is built over.
+    Bounds m_bounds;
+
+    /// @brief Splits the given leaf (and its children, recursively) as long as it has more than the given samples.
+    void subdivide(int index, int64_t threshold, int64_t sampleCount) {
+        if (sampleCount <= threshold) return;
+
+        const int leaf = m_nodes[index].leaf;
+        const int axis = m_nodes[index].axis;
+        const int first = int(m_nodes.size());
+        m_nodes[index].children = first;
+
+        // both halves start out with the distributions of their parent, and are assumed to receive half its samples
+        DTreeWrapper copy = m_leaves[leaf];
+        m_leaves.push_back(std::move(copy));
+        m_nodes.push_back({ (axis + 1) % 3, 0, leaf });
+        m_nodes.push_back({ (axis + 1) % 3, 0, int(m_leaves.size()) - 1 });
+        subdivide(first, threshold, sampleCount / 2);
+        subdivide(first + 1, threshold, sampleCount / 2);
+    }
+
+public:
+    /// @param bsdfSamplingFraction The probability of sampling the Bsdf that all regions start learning from.
+    SDTree(const Bounds &bounds, float bsdfSamplingFraction) {
+        // a cube keeps the regions of space from becoming elongated
+        const Vector extent = bounds.diagonal();
+        const float size = std::max({ extent.x(), extent.y(), extent.z(), Epsilon }) * (1 + 1e-3f);
+        const Point center = bounds.center();
+        m_bounds = Bounds(center - Vector(size / 2), center + Vector(size / 2));
+
+        m_nodes.push_back({ 0, 0, 0 });
+        m_leaves.emplace_back();
+        m_leaves.back().bsdfSamplingFraction.reset(bsdfSamplingFraction);
+    }
+
+    /// @brief Returns the directional distributions of the region of space that contains the given point.
+    DTreeWrapper &lookup(const Point &point) {
+        const Vector extent = m_bounds.diagonal();
+        Point p;
+        for (int dim = 0; dim < 3; dim++)
+            p[dim] = std::clamp((point[dim] - m_bounds.min()[dim]) / extent[dim], 0.f, OneMinusEpsilon);
+
+        int index = 0;
+        while (m_nodes[index].children) {
+            const Node &node = m_nodes[index];
+            const bool second = p[node.axis] >= 0.5f;
+            p[node.axis] = 2 * p[node.axis] - second;
+            index = node.children + second;
+        }
+        return m_leaves[m_nodes[index].leaf];
+    }
+
+    /**
+     * @brief Prepares the tree for the next iteration once all radiance has been recorded (not safe to call while
+     * rendering).
+     * @param spatialThreshold Regions of space are split if they have received more samples than this.
+     * @param directionalThreshold Directional quadrants are subdivided if they receive more than this fraction of the
+     * radiance of their region.
+     * @param maxDepth The maximum depth of the directional quadtrees.
+     */
+    void refine(int64_t spatialThreshold, float directionalThreshold, int maxDepth) {
+        const int numNodes = int(m_nodes.size());
+        for (int index = 0; index < numNodes; index++) {
+            if (m_nodes[index].children) continue;
+            subdivide(index, spatialThreshold, m_leaves[m_nodes[index].leaf].building.sampleCount());
+        }
+
+        parallel_for(Range(0, int(m_leaves.size())), [&](int leaf) {
+            DTreeWrapper &wrapper = m_leaves[leaf];
+            wrapper.building.build();
+            wrapper.sampling = std::move(wrapper.building);
+            wrapper.building = wrapper.sampling.refined(directionalThreshold, maxDepth);
+        });
+    }
+
+    /// @brief Steps the Bsdf sampling fractions of all regions with the gradients recorded since their last step.
+    void stepBsdfSamplingFractions() {
+        for (auto &leaf : m_leaves)
+            leaf.bsdfSamplingFraction.step();
+    }
+
+    /// @brief The number of regions space is divided into.
+    int numLeaves() const { return int(m_leaves.size()); }
+
+    /// @brief The average probability of sampling the Bsdf over all regions.
+    float averageBsdfSamplingFraction() const {
+        double sum = 0;
+        for (const auto &leaf : m_leaves)
+            sum += leaf.bsdfSamplingFraction.fraction();
+        return float(sum / m_leaves.size());
+    }
+
+    /// @brief The average number of nodes of the directional quadtrees that are used for sampling.
+    float averageDirectionalNodes() const {
+        double sum = 0;
+        for (const auto &leaf : m_leaves)
+            sum += leaf.sampling.numNodes();
+        return float(sum / m_leaves.size());
+    }
+};
+
+}
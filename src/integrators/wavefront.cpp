@@ -0,0 +1,335 @@
+#include <lightwave.hpp>
+
+#include <algorithm>
+
+namespace lightwave {
+
+/**
+ * @brief A path tracer that advances a large batch ("wave") of paths one bounce at a time, instead of tracing each path
+ * to completion before starting the next one.
+ * Each bounce is split into stages that are run over the entire wave: intersecting all rays with the scene, sorting
+ * the hits by material, shading them (which queues shadow rays and continues the paths) and finally tracing all queued
+ * shadow rays in bulk. Since every stage only executes a small part of the renderer, and shading processes all hits
+ * with the same material together, the code and data that are accessed stay hot in the caches.
+ * Whether this is faster than the @c pathtracer integrator depends on the scene: on a single core, it is about 10%
+ * faster for scenes with many textured materials (e.g., @c principled_envmap ), but about 20% slower for simple scenes
+ * with few materials (e.g., @c pathtracing_depth5 takes 69 instead of 58 seconds), where the overhead of the stages
+ * and of storing the path states dominates.
+ *
+ * Only the estimator of the @c pathtracer integrator with its default options is implemented: light sampling with one
+ * sample per vertex for all lights except the background, no Russian roulette, no path splitting and no participating
+ * media. The properties @c mis , @c rrDepth , @c rrMaxSurvival , @c lightSamples and @c maxSplit are rejected, as are
+ * scenes with media. Every path uses the same random numbers as with the @c pathtracer integrator (except for alpha masked
+ * shadow rays, which are traced after the next direction has been sampled).
+ * @note The wave is processed pixel after pixel, sample after sample, so progressive and adaptive rendering and tile
+ * ordering do not apply to this integrator.
+ */
+class WavefrontIntegrator : public SamplingIntegrator {
+    /**
+     * @brief The state of all paths of a wave, stored as separate arrays for each quantity (structure of arrays), so that
+     * stages only pull the quantities they need into the caches.
+     */
+    struct Wave {
+        /// @brief The ray that will be traced next for each path.
+        std::vector<Ray> ray;
+        /// @brief The product of all sampling weights along each path so far.
+        std::vector<Color> throughput;
+        /// @brief The radiance each path has gathered so far.
+        std::vector<Color> radiance;
+        /// @brief The surface each path has hit in the current bounce.
+        std::vector<Intersection> its;
+        /// @brief Whether the ray of each path continues from a non-specular surface, in which case the lights it hits
+        /// have already been accounted for by light sampling.
+        std::vector<char> lightSampled;
+        /// @brief The random number generator of each path.
+        std::vector<Sampler *> sampler;
+        /// @brief The pixel each path contributes to.
+        std::vector<Point2i> pixel;
+
+        /// @brief The shadow ray each path has queued in the current bounce (if its contribution is non-zero).
+        std::vector<Ray> shadowRay;
+        /// @brief The distance to the light sample along the shadow ray.
+        std::vector<float> shadowDistance;
+        /// @brief The radiance that is added to the path if the shadow ray is unoccluded.
+        std::vector<Color> shadowContribution;
+
+        /// @brief The paths that are still being traced.
+        std::vector<int> active;
+        /// @brief The paths that have hit a surface in the current bounce, sorted by material.
+        std::vector<int> hits;
+        /// @brief The paths that have queued a shadow ray in the current bounce.
+        std::vector<int> shadows;
+        /// @brief The material of each path in @c hits , used as key for sorting.
+        std::vector<std::pair<uintptr_t, int>> sortKeys;
+
+        void resize(int size) {
+            ray.resize(size);
+            throughput.resize(size);
+            radiance.resize(size);
+            its.resize(size);
+            lightSampled.resize(size);
+            sampler.resize(size);
+            pixel.resize(size);
+            shadowRay.resize(size);
+            shadowDistance.resize(size);
+            shadowContribution.resize(size);
+            active.reserve(size);
+            hits.reserve(size);
+            shadows.reserve(size);
+            sortKeys.reserve(size);
+        }
+
+        int size() const { return int(ray.size()); }
+    };
+
+    /// @brief The maximum number of path vertices, as for the @c pathtracer integrator.
+    int m_depth;
+    /// @brief The number of paths that are traced together.
+    int m_waveSize;
+    /// @brief Whether hits are sorted by material before shading.
+    bool m_sortByMaterial;
+
+    /// @brief Paths are distributed to threads in chunks of this size, to amortize the cost of scheduling.
+    static constexpr int GrainSize = 256;
+
+    /// @brief Runs a stage for all paths in the given list (in parallel, unless there are only a few of them).
+    template <typename Stage>
+    void runStage(const std::vector<int> &paths, Stage &&stage) {
+        const auto body = [&](int index) {
+            stage(paths[index]);
+            MemoryArena::forThread().reset();
+        };
+        if (int(paths.size()) <= GrainSize) {
+            for (int index = 0; index < int(paths.size()); index++)
+                body(index);
+        } else {
+            parallel_for(Range(0, int(paths.size())), body, GrainSize);
+        }
+    }
+
+    /// @brief Intersects the rays of all active paths with the scene, and terminates the paths that escape it.
+    void intersect(Wave &wave) {
+        runStage(wave.active, [&](int path) {
+            AssertNoAllocations guard { "intersecting a path" };
+            wave.its[path] = m_scene->intersect(wave.ray[path], *wave.sampler[path]);
+            if (!wave.its[path]) {
+                wave.radiance[path] +=
+                    m_scene->evaluateBackground(wave.ray[path].direction).value * wave.throughput[path];
+            }
+        });
+
+        wave.hits.clear();
+        for (int path : wave.active) {
+            if (wave.its[path]) wave.hits.push_back(path);
+        }
+    }
+
+    /// @brief Orders the hits by their material, so that hits with the same material are shaded together.
+    void sortHits(Wave &wave) {
+        if (!m_sortByMaterial) return;
+
+        wave.sortKeys.clear();
+        for (int path : wave.hits) {
+            const Instance *instance = wave.its[path].instance;
+            wave.sortKeys.emplace_back(reinterpret_cast<uintptr_t>(instance->bsdf()), path);
+        }
+        std::sort(wave.sortKeys.begin(), wave.sortKeys.end());
+        for (size_t i = 0; i < wave.sortKeys.size(); i++)
+            wave.hits[i] = wave.sortKeys[i].second;
+    }
+
+    /**
+     * @brief Gathers emission at the hit points, queues shadow rays towards randomly chosen lights, and samples the
+     * direction in which each path continues. Paths that have reached the maximum depth are terminated.
+     */
+    void shade(Wave &wave, int bounce) {
+        const bool lastBounce = bounce == m_depth - 1;
+        runStage(wave.hits, [&](int path) {
+            AssertNoAllocations guard { "shading a path" };
+            const Intersection &its = wave.its[path];
+            Sampler &rng = *wave.sampler[path];
+            if (!(wave.lightSampled[path] && its.instance->light()))
+                wave.radiance[path] += its.evaluateEmission() * wave.throughput[path];
+            wave.shadowContribution[path] = Color(0);
+            if (lastBounce) return;
+
+            const Point origin = wave.ray[path](its.t);
+            if (m_scene->hasLights()) {
+                const LightSample lightSample = m_scene->sampleLight(origin, rng);
+                const DirectLightSample direct =
+                    lightSample.isInvalid() ? DirectLightSample::invalid() : lightSample.light->sampleDirect(origin, rng);
+                if (!direct.isInvalid() && lightSample.light != m_scene->background()) {
+                    const BsdfEval bsdf = its.evaluateBsdf(direct.wi);
+                    wave.shadowRay[path] = Ray(origin, direct.wi);
+                    wave.shadowDistance[path] = direct.distance;
+                    wave.shadowContribution[path] =
+                        bsdf.value * direct.weight / lightSample.probability * wave.throughput[path];
+                }
+            }
+
+            const BsdfSample bsdfSample = its.sampleBsdf(rng);
+            if (bsdfSample.isInvalid()) {
+                // failed samples end the path, as for the pathtracer integrator
+                wave.throughput[path] = Color(0);
+                return;
+            }
+            wave.throughput[path] *= bsdfSample.weight;
+            wave.lightSampled[path] = !bsdfSample.isDelta();
+            wave.ray[path] = Ray(origin, bsdfSample.wi).normalized();
+        });
+
+        wave.shadows.clear();
+        for (int path : wave.hits) {
+            if (wave.shadowContribution[path] != Color(0)) wave.shadows.push_back(path);
+        }
+
+        // paths continue if they have hit a surface (and can still contribute)
+        wave.active.clear();
+        if (lastBounce) return;
+        for (int path : wave.hits) {
+            if (wave.throughput[path] != Color(0)) wave.active.push_back(path);
+        }
+    }
+
+    /// @brief Traces all queued shadow rays, and adds the contribution of the light samples that are visible.
+    void traceShadowRays(Wave &wave) {
+        runStage(wave.shadows, [&](int path) {
+            AssertNoAllocations guard { "tracing a shadow ray" };
+            if (!m_scene->intersect(wave.shadowRay[path], wave.shadowDistance[path], *wave.sampler[path]))
+                wave.radiance[path] += wave.shadowContribution[path];
+        });
+    }
+
+    /// @brief Traces all active paths of the wave until they have terminated.
+    void traceWave(Wave &wave) {
+        for (int bounce = 0; bounce < m_depth && !wave.active.empty(); bounce++) {
+            intersect(wave);
+            sortHits(wave);
+            shade(wave, bounce);
+            traceShadowRays(wave);
+        }
+    }
+
+public:
+    WavefrontIntegrator(const Properties &properties)
+    : SamplingIntegrator(properties, {}) {
+        m_depth = properties.get<int>("depth", 2);
+        m_waveSize = std::max(properties.get<int>("waveSize", 1 << 16), 1);
+        m_sortByMaterial = properties.get<bool>("sortByMaterial", true);
+        for (const char *name : { "mis", "rrDepth", "rrMaxSurvival", "lightSamples", "maxSplit" }) {
+            if (properties.has(name)) {
+                lightwave_throw("the wavefront integrator does not support \"%s\" (use the pathtracer integrator)", name);
+            }
+        }
+    }
+
+    void execute() override {
+        if (!m_image) {
+            lightwave_throw("<integrator /> needs an <image /> child to render into!");
+        }
+        if (m_scene->hasMedia()) {
+            lightwave_throw("the wavefront integrator does not support participating media (use the pathtracer integrator)");
+        }
+
+        const Vector2i resolution = m_scene->camera()->resolution();
+        const int numPixels = resolution.x() * resolution.y();
+        const int samplesPerPixel = m_sampler->samplesPerPixel();
+        // a wave never contains the same pixel twice, so that the results can be written without synchronization
+        const int waveSize = std::min(m_waveSize, numPixels);
+        const int64_t numPaths = int64_t(numPixels) * samplesPerPixel;
+        const int numWaves = int((numPaths + waveSize - 1) / waveSize);
+
+        // pixels accumulate the sum of their samples, which is normalized once all waves are done
+        m_image->initialize(resolution);
+
+        Wave wave;
+        wave.resize(waveSize);
+        std::vector<ref<Sampler>> samplers(waveSize);
+        for (int slot = 0; slot < waveSize; slot++) {
+            samplers[slot] = m_sampler->clone();
+            wave.sampler[slot] = samplers[slot].get();
+        }
+
+        Timer timer;
+        Streaming stream { *m_image };
+        stream.normalize(1.0f / samplesPerPixel);
+        stream.startRegularUpdates();
+        ProgressReporter progress { numWaves };
+
+        for (int64_t first = 0; first < numPaths; first += waveSize) {
+            const int count = int(std::min<int64_t>(waveSize, numPaths - first));
+
+            // generate camera rays, enumerating all pixels for one sample index after another
+            wave.active.resize(count);
+            parallel_for(Range(0, count), [&](int slot) {
+                const int64_t index = first + slot;
+                const int pixelIndex = int(index % numPixels);
+                const Point2i pixel { pixelIndex % resolution.x(), pixelIndex / resolution.x() };
+                Sampler &rng = *wave.sampler[slot];
+                rng.seed(pixel, int(index / numPixels));
+
+                const auto cameraSample = m_scene->camera()->sample(pixel, rng);
+                wave.ray[slot] = cameraSample.ray;
+                wave.throughput[slot] = cameraSample.weight;
+                wave.lightSampled[slot] = false;
+                wave.radiance[slot] = Color(0);
+                wave.pixel[slot] = pixel;
+                wave.active[slot] = slot;
+            }, GrainSize);
+
+            traceWave(wave);
+
+            parallel_for(Range(0, count), [&](int slot) {
+                m_image->get(wave.pixel[slot]) += wave.radiance[slot];
+            }, GrainSize);
+            progress += 1;
+        }
+        progress.finish();
+
+        logger(EInfo, "traced %d paths in waves of %d in %.1f seconds", numPaths, waveSize, timer.getElapsedTime());
+
+        stream.stopRegularUpdates();
+        *m_image *= 1.0f / samplesPerPixel;
+        stream.normalize(1);
+        stream.update();
+
+        m_image->save();
+    }
+
+    /// @brief Traces a single path through the stages of the wavefront renderer.
+    Color Li(const Ray &ray, Sampler &rng) override {
+        static thread_local Wave wave;
+        if (wave.size() == 0) {
+            AllowAllocations setup;
+            wave.resize(1);
+        }
+
+        wave.ray[0] = ray;
+        wave.throughput[0] = Color(1);
+        wave.lightSampled[0] = false;
+        wave.radiance[0] = Color(0);
+        wave.sampler[0] = &rng;
+        wave.active.assign(1, 0);
+        traceWave(wave);
+        return wave.radiance[0];
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "WavefrontIntegrator[\n"
+            "  depth = %d,\n"
+            "  waveSize = %d,\n"
+            "  sampler = %s,\n"
+            "  image = %s,\n"
+            "]",
+            m_depth,
+            m_waveSize,
+            indent(m_sampler),
+            indent(m_image)
+        );
+    }
+};
+
+}
+
+REGISTER_INTEGRATOR(WavefrontIntegrator, "wavefront")
@@ -0,0 +1,238 @@
+#include <lightwave.hpp>
+
+namespace lightwave {
+
+/**
+ * @brief Turns an emissive instance into a light source, so that its emission can be sampled directly (next event
+ * estimation) instead of only being found by Bsdf sampling.
+ * Points are sampled according to the shape of the instance: spheres and rectangles uniformly in the solid angle they
+ * cover as seen from the receiving point, meshes in proportion to the area of their triangles, and groups in
+ * proportion to the area of their children. Light leaves the surface with a cosine distribution when starting light
+ * paths.
+ * Emission that varies over texels (e.g., image textures) is instead sampled in proportion to its brightness, using a
+ * density over texture coordinates that is tabulated per texel, if the texture coordinates of the shape parametrize its
+ * surface (rectangles and spheres). Bright texels thus receive most samples, both for light sampling and when starting
+ * light paths, independent of the solid angle they cover. For other shapes (e.g., meshes), a warning is logged and
+ * textured emission is sampled by area.
+ * @note The instance still needs to be part of the scene (e.g., by referencing it) to be visible to rays.
+ */
+class AreaLight final : public Light {
+    ref<Instance> m_instance;
+    /// @brief The resolution of the grid of texture coordinates used to estimate the average emission.
+    static constexpr int PowerEstimateResolution = 16;
+
+    /**
+     * @brief The density used to sample texture coordinates for textured emission, proportional to the brightness of
+     * each texel times the area it covers (empty if points are sampled by the shape).
+     */
+    Distribution2D m_textureDistribution;
+    /// @brief The power emitted by textured emission, which is integrated per texel while building its density.
+    float m_texturePower = 0;
+
+    Color evaluateEmission(const SurfaceEvent &surface, const Vector &wo) const {
+        return m_instance->emission()->evaluate(surface.uv, surface.frame.toLocal(wo)).value;
+    }
+
+    float emittedLuminance(const Point2 &uv) const {
+        return m_instance->emission()->evaluate(uv, Vector(0, 0, 1)).value.luminance();
+    }
+
+    /// @brief Tabulates textured emission to build the density for sampling texture coordinates.
+    void buildTextureDistribution() {
+        const std::optional<Point2i> resolution = m_instance->emission()->resolution();
+        if (!resolution) return;
+        if (!(m_instance->sampleTexture(Point2(0.5f)).pdf > 0)) {
+            logger(EWarn, "the textured emission of %s cannot be importance sampled, as only rectangles and spheres "
+                          "are parametrized by texture coordinates, sampling it by area instead",
+                   m_instance->id());
+            return;
+        }
+
+        const int width  = resolution->x();
+        const int height = resolution->y();
+
+        // as for environment maps, the corners of the cells are included since filtering can spread bright texels into
+        // neighboring cells, which would otherwise receive zero density
+        std::vector<float> corners(size_t(width + 1) * (height + 1));
+        for (int y = 0; y <= height; y++) {
+            for (int x = 0; x <= width; x++) {
+                corners[size_t(y) * (width + 1) + x] = emittedLuminance({ float(x) / width, float(y) / height });
+            }
+        }
+
+        std::vector<float> weights(size_t(width) * height);
+        double power = 0;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                const Point2 uv { (x + 0.5f) / width, (y + 0.5f) / height };
+                const AreaSample center = m_instance->sampleTexture(uv);
+                const float area = center.pdf > 0 ? 1 / (center.pdf * width * height) : 0;
+
+                const float luminance = emittedLuminance(uv);
+                float bound = luminance;
+                for (int corner = 0; corner < 4; corner++) {
+                    const int cx = x + (corner & 1);
+                    const int cy = y + (corner >> 1);
+                    bound = std::max(bound, corners[size_t(cy) * (width + 1) + cx]);
+                }
+                weights[size_t(y) * width + x] = bound * area;
+                power += luminance * area;
+            }
+        }
+
+        m_textureDistribution = Distribution2D(weights, *resolution);
+        m_texturePower = Pi * float(power);
+        logger(EDebug, "built area light distribution with %dx%d cells", width, height);
+    }
+
+    /// @brief Samples a point on the instance in proportion to the brightness of its textured emission.
+    AreaSample sampleTextured(Sampler &rng) const {
+        float pdf;
+        const Point2 uv = m_textureDistribution.sample(rng.next2D(), pdf);
+        AreaSample sample = m_instance->sampleTexture(uv);
+        sample.pdf *= pdf;
+        return sample;
+    }
+
+    /// @brief Returns the density (in area) of @ref sampleTextured choosing the given surface point.
+    float texturedPdf(const SurfaceEvent &surface) const {
+        return m_textureDistribution.pdf(surface.uv) * m_instance->sampleTexture(surface.uv).pdf;
+    }
+
+    /// @brief Samples a point on the instance for light arriving at the given origin.
+    AreaSample sampleSurface(const Point &origin, Sampler &rng) const {
+        if (m_textureDistribution.empty()) return m_instance->sampleArea(origin, rng);
+        return sampleTextured(rng);
+    }
+
+    /// @brief Returns the density (in area) of @ref sampleSurface choosing the given surface point.
+    float surfacePdf(const Point &origin, const SurfaceEvent &surface) const {
+        if (m_textureDistribution.empty()) return m_instance->areaPdf(origin, surface);
+        return texturedPdf(surface);
+    }
+
+    /// @brief Returns the density (in area) of @ref sampleEmission starting a light path at the given surface point.
+    float emissionSurfacePdf(const SurfaceEvent &surface) const {
+        if (m_textureDistribution.empty()) return m_instance->areaPdf(surface);
+        return texturedPdf(surface);
+    }
+
+public:
+    AreaLight(const Properties &properties) {
+        m_instance = properties.getChild<Instance>();
+        if (!m_instance->emission()) {
+            lightwave_throw("area lights need an instance with an <emission />, %s has none!", indent(m_instance));
+        }
+        m_instance->setLight(this);
+        m_instance->markAsSampled();
+        buildTextureDistribution();
+    }
+
+    DirectLightSample sampleDirect(const Point &origin, Sampler &rng) const override {
+        const AreaSample sample = sampleSurface(origin, rng);
+        if (!(sample.pdf > 0)) return DirectLightSample::invalid();
+
+        const Vector offset = sample.position - origin;
+        const float distance = offset.length();
+        if (distance == 0) return DirectLightSample::invalid();
+        const Vector wi = offset / distance;
+        const float cosTheta = std::abs(sample.frame.normal.dot(wi));
+        if (cosTheta == 0) return DirectLightSample::invalid();
+
+        // convert the density from area to solid angle
+        const float pdf = sample.pdf * sqr(distance) / cosTheta;
+        return {
+            .wi = wi,
+            .weight = evaluateEmission(sample, -wi) / pdf,
+            .distance = distance,
+            .pdf = pdf,
+            .normal = sample.frame.normal,
+            .pdfPosition = emissionSurfacePdf(sample),
+            .uv = sample.uv,
+        };
+    }
+
+    Color evaluateDirect(const Point &origin, const Vector &wi, float distance, Sampler &rng) const override {
+        // find the surface (and hence, normal and texture coordinates) at the point, which is hidden if another part
+        // of the instance lies in front of it (e.g., the far side of a sphere)
+        Intersection its(-wi, distance * (1 + 1e-3f));
+        if (!m_instance->intersect(Ray(origin, wi), its, rng)) return Color(0);
+        if (its.t < distance * (1 - 1e-3f)) return Color(0);
+        return evaluateEmission(its, -wi) * std::abs(its.frame.normal.dot(wi)) / sqr(its.t);
+    }
+
+    float directPdf(const Point &origin, const Intersection &its) const override {
+        const Vector offset = its.position - origin;
+        const float cosTheta = std::abs(its.frame.normal.dot(its.wo));
+        if (cosTheta == 0) return 0;
+        return surfacePdf(origin, its) * offset.lengthSquared() / cosTheta;
+    }
+
+    bool canBeIntersected() const override { return m_instance->isVisible(); }
+
+    std::optional<LightBounds> bounds() const override {
+        return LightBounds {
+            .bounds = m_instance->getBoundingBox(),
+            .power = totalPower(Bounds()),
+            .axis = Vector(0, 0, 1),
+            .cosThetaO = -1,
+            .cosThetaE = 0,
+            .twoSided = false,
+        };
+    }
+
+    float totalPower(const Bounds &sceneBounds) const override {
+        if (!m_textureDistribution.empty()) return m_texturePower;
+
+        // the radiance leaving the surface is estimated from its average over a grid of texture coordinates
+        double radiance = 0;
+        for (int y = 0; y < PowerEstimateResolution; y++) {
+            for (int x = 0; x < PowerEstimateResolution; x++) {
+                const Point2 uv { (x + 0.5f) / PowerEstimateResolution, (y + 0.5f) / PowerEstimateResolution };
+                radiance += m_instance->emission()->evaluate(uv, Vector(0, 0, 1)).value.luminance();
+            }
+        }
+        radiance /= sqr(PowerEstimateResolution);
+        return Pi * m_instance->area() * float(radiance);
+    }
+
+    EmissionSample sampleEmission(const Bounds &sceneBounds, Sampler &rng) const override {
+        const AreaSample sample = m_textureDistribution.empty() ? m_instance->sampleArea(rng) : sampleTextured(rng);
+        if (!(sample.pdf > 0)) return EmissionSample::invalid();
+
+        const Vector local = squareToCosineHemisphere(rng.next2D());
+        const float pdfDirection = cosineHemispherePdf(local);
+        if (pdfDirection == 0) return EmissionSample::invalid();
+        const Vector direction = sample.frame.toWorld(local);
+
+        // the cosine cancels with the density of the direction
+        return {
+            .ray = Ray(sample.position, direction),
+            .weight = evaluateEmission(sample, direction) * Pi / sample.pdf,
+            .normal = sample.frame.normal,
+            .pdfPosition = sample.pdf,
+            .pdfDirection = pdfDirection,
+            .uv = sample.uv,
+        };
+    }
+
+    EmissionPdf emissionPdf(const Ray &ray, const SurfaceEvent &surface, const Bounds &sceneBounds) const override {
+        return {
+            .position = emissionSurfacePdf(surface),
+            .direction = InvPi * std::max(surface.frame.normal.dot(ray.direction), 0.f),
+        };
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "AreaLight[\n"
+            "  instance = %s\n"
+            "]",
+            indent(m_instance)
+        );
+    }
+};
+
+}
+
+REGISTER_LIGHT(AreaLight, "area")
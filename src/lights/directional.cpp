@@ -19,11 +19,44 @@ public:
         d.distance = Infinity;
         d.weight = power;
         d.wi = dir;
+        d.pdf = Infinity;
         return d;
     }
 
+    Color evaluateDirect(const Point &origin, const Vector &wi, float distance, Sampler &rng) const override {
+        return power;
+    }
+
     bool canBeIntersected() const override { return false; }
 
+    float totalPower(const Bounds &sceneBounds) const override {
+        // the light passes through the disk the scene occupies when seen from the direction of the light
+        const float radius = sceneBounds.diagonal().length() / 2;
+        return Pi * sqr(radius) * power.luminance();
+    }
+
+    EmissionSample sampleEmission(const Bounds &sceneBounds, Sampler &rng) const override {
+        // light enters the scene through a disk that faces the light and covers the bounding sphere of the scene
+        const float radius = sceneBounds.diagonal().length() / 2;
+        const Frame frame { dir };
+        const Point2 disk = squareToUniformDiskConcentric(rng.next2D());
+        const Point origin = sceneBounds.center() + radius * (dir + disk.x() * frame.tangent + disk.y() * frame.bitangent);
+
+        const float pdfPosition = 1 / (Pi * sqr(radius));
+        return {
+            .ray = Ray(origin, -dir),
+            .weight = power / pdfPosition,
+            .normal = -dir,
+            .pdfPosition = pdfPosition,
+            .pdfDirection = 1,
+        };
+    }
+
+    EmissionPdf emissionPdf(const Ray &ray, const SurfaceEvent &surface, const Bounds &sceneBounds) const override {
+        const float radius = sceneBounds.diagonal().length() / 2;
+        return { .position = 1 / (Pi * sqr(radius)), .direction = 0 };
+    }
+
     std::string toString() const override {
         return tfm::format("DirectionalLight[\n"
                            "]");
@@ -9,10 +9,59 @@ class EnvironmentMap final : public BackgroundLight {
     /// @brief An optional transform from local-to-world space
     ref<Transform> m_transform;
 
+    /// @brief The density used to sample texture coordinates, proportional to the luminance of the texture weighted by
+    /// the solid angle each texture coordinate covers.
+    Distribution2D m_distribution;
+
+    /// @brief The resolution at which textures that do not consist of texels (e.g., constant textures) are tabulated.
+    static constexpr int DefaultResolution = 32;
+
+    /// @brief Tabulates the texture to build the density for sampling directions.
+    void buildDistribution() {
+        const Point2i resolution = m_texture->resolution().value_or(Point2i(2 * DefaultResolution, DefaultResolution));
+        const int width  = resolution.x();
+        const int height = resolution.y();
+
+        // the texture is sampled at the corners of the cells as well, since filtering can spread texels with
+        // radiance into neighboring cells, which would otherwise receive zero density
+        std::vector<float> corners(size_t(width + 1) * (height + 1));
+        for (int y = 0; y <= height; y++) {
+            for (int x = 0; x <= width; x++) {
+                const Point2 uv { float(x) / width, float(y) / height };
+                corners[size_t(y) * (width + 1) + x] = m_texture->evaluate(uv).luminance();
+            }
+        }
+
+        std::vector<float> weights(size_t(width) * height);
+        for (int y = 0; y < height; y++) {
+            // rows close to the poles cover less solid angle
+            const float sinTheta = std::sin(Pi * (y + 0.5f) / height);
+            for (int x = 0; x < width; x++) {
+                const Point2 uv { (x + 0.5f) / width, (y + 0.5f) / height };
+                float luminance = m_texture->evaluate(uv).luminance();
+                for (int corner = 0; corner < 4; corner++) {
+                    const int cx = x + (corner & 1);
+                    const int cy = y + (corner >> 1);
+                    luminance = std::max(luminance, corners[size_t(cy) * (width + 1) + cx]);
+                }
+                weights[size_t(y) * width + x] = luminance * sinTheta;
+            }
+        }
+
+        m_distribution = Distribution2D(weights, resolution);
+        logger(EDebug, "built environment map distribution with %dx%d cells", width, height);
+    }
+
+    /// @brief Converts a density over texture coordinates into a density over solid angle.
+    static float solidAnglePdf(float pdf, float sinTheta) {
+        return sinTheta > 0 ? pdf / (2 * sqr(Pi) * sinTheta) : 0;
+    }
+
 public:
     EnvironmentMap(const Properties &properties) {
         m_texture   = properties.getChild<Texture>();
         m_transform = properties.getOptionalChild<Transform>();
+        buildDistribution();
     }
 
     BackgroundLightEval evaluate(const Vector &direction) const override {
@@ -25,27 +74,82 @@ public:
 
         warped = Vector2(((atan2(-new_direction[2], new_direction[0]) / Pi) + 1) / 2, (acos(new_direction[1]) / Pi));
 
+        const float sinTheta = safe_sqrt(1 - sqr(new_direction[1]));
         return {
             .value = m_texture->evaluate(warped),
+            .pdf = solidAnglePdf(m_distribution.pdf(warped), sinTheta),
         };
     }
 
     DirectLightSample sampleDirect(const Point &origin,
                                    Sampler &rng) const override {
-        Vector direction = squareToUniformSphere(rng.next2D());
-        auto E           = evaluate(direction);
+        float pdf;
+        const Point2 warped = m_distribution.sample(rng.next2D(), pdf);
+
+        // invert the mapping from directions to texture coordinates used by evaluate
+        const float theta = warped.y() * Pi;
+        const float phi   = (2 * warped.x() - 1) * Pi;
+        const float sinTheta = std::sin(theta);
+        pdf = solidAnglePdf(pdf, sinTheta);
+        if (pdf == 0) return DirectLightSample::invalid();
 
-        // implement better importance sampling here, if you ever need it
-        // (useful for environment maps with bright tiny light sources, like the
-        // sun for example)
+        Vector direction { sinTheta * std::cos(phi), std::cos(theta), -sinTheta * std::sin(phi) };
+        if (m_transform) {
+            direction = m_transform->apply(direction).normalized();
+        }
 
         return {
             .wi     = direction,
-            .weight = E.value / Inv4Pi,
+            .weight = m_texture->evaluate(warped) / pdf,
             .distance = Infinity,
+            .pdf = pdf,
+        };
+    }
+
+    EmissionSample sampleEmission(const Bounds &sceneBounds, Sampler &rng) const override {
+        const DirectLightSample direction = sampleDirect(sceneBounds.center(), rng);
+        if (direction.isInvalid()) return EmissionSample::invalid();
+
+        // light enters the scene through a disk that faces the sampled direction and covers the bounding sphere of the
+        // scene
+        const float radius = sceneBounds.diagonal().length() / 2;
+        const Frame frame { direction.wi };
+        const Point2 disk = squareToUniformDiskConcentric(rng.next2D());
+        const Point origin = sceneBounds.center() +
+                             radius * (direction.wi + disk.x() * frame.tangent + disk.y() * frame.bitangent);
+
+        const float pdfPosition = 1 / (Pi * sqr(radius));
+        return {
+            .ray = Ray(origin, -direction.wi),
+            .weight = direction.weight / pdfPosition,
+            .normal = -direction.wi,
+            .pdfPosition = pdfPosition,
+            .pdfDirection = direction.pdf,
         };
     }
 
+    EmissionPdf emissionPdf(const Ray &ray, const SurfaceEvent &surface, const Bounds &sceneBounds) const override {
+        const float radius = sceneBounds.diagonal().length() / 2;
+        return { .position = 1 / (Pi * sqr(radius)), .direction = evaluate(-ray.direction).pdf };
+    }
+
+    float totalPower(const Bounds &sceneBounds) const override {
+        // average the radiance over a grid of directions that are uniformly distributed over the sphere
+        constexpr int Resolution = 64;
+        double sum = 0;
+        for (int y = 0; y < Resolution; y++) {
+            for (int x = 0; x < 2 * Resolution; x++) {
+                const Point2 sample { (x + 0.5f) / (2 * Resolution), (y + 0.5f) / Resolution };
+                sum += evaluate(squareToUniformSphere(sample)).value.luminance();
+            }
+        }
+        const float averageRadiance = float(sum / (2 * sqr(Resolution)));
+
+        // the light arriving from all directions passes through the disk the scene occupies
+        const float radius = sceneBounds.diagonal().length() / 2;
+        return 4 * Pi * averageRadiance * Pi * sqr(radius);
+    }
+
     std::string toString() const override {
         return tfm::format("EnvironmentMap[\n"
                            "  texture = %s,\n"
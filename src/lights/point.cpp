@@ -19,11 +19,46 @@ public:
         d.distance = (pos - origin).length();
         d.weight = power / (4 * Pi * d.distance * d.distance);
         d.wi = (pos - origin).normalized();
+        d.pdf = Infinity;
         return d;
     }
 
+    Color evaluateDirect(const Point &origin, const Vector &wi, float distance, Sampler &rng) const override {
+        return power / (4 * Pi * distance * distance);
+    }
+
     bool canBeIntersected() const override { return false; }
 
+    float totalPower(const Bounds &sceneBounds) const override {
+        return power.luminance();
+    }
+
+    EmissionSample sampleEmission(const Bounds &sceneBounds, Sampler &rng) const override {
+        // the intensity is power / (4 pi), which cancels with the density of uniform directions
+        return {
+            .ray = Ray(pos, squareToUniformSphere(rng.next2D())),
+            .weight = power,
+            .normal = Vector(0),
+            .pdfPosition = 1,
+            .pdfDirection = Inv4Pi,
+        };
+    }
+
+    EmissionPdf emissionPdf(const Ray &ray, const SurfaceEvent &surface, const Bounds &sceneBounds) const override {
+        return { .position = 1, .direction = Inv4Pi };
+    }
+
+    std::optional<LightBounds> bounds() const override {
+        return LightBounds {
+            .bounds = Bounds(pos, pos),
+            .power = power.luminance(),
+            .axis = Vector(0, 0, 1),
+            .cosThetaO = -1,
+            .cosThetaE = 0,
+            .twoSided = false,
+        };
+    }
+
     std::string toString() const override {
         return tfm::format("PointLight[\n"
                            "]");
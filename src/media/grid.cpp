@@ -0,0 +1,287 @@
+#include <lightwave.hpp>
+
+#include <fstream>
+
+namespace lightwave {
+
+/**
+ * @brief A heterogeneous medium whose density is given by a voxel grid that fills the box [-1,-1,-1]..[+1,+1,+1] in
+ * object coordinates, and is interpolated trilinearly between the centers of the voxels.
+ * Distances are sampled by delta tracking and transmittance is estimated by ratio tracking, both of which step through
+ * a coarse grid of majorants (the maximum density within each cell) that is built at load time. Sparse cells are
+ * crossed in long steps and empty cells without any tentative collision, but every cell a ray passes is still visited,
+ * so that the cost of a ray grows with the resolution of the majorant grid (@c majorantCellSize trades this against
+ * tighter majorants).
+ *
+ * Grids are read from a binary file, which starts with the characters @c LWVG , followed by the version (1), the
+ * encoding (0 for dense, 1 for sparse) and the resolution in x, y and z (all as 32-bit integers). Dense grids continue
+ * with one 32-bit float per voxel, where x varies fastest and z slowest. Sparse grids continue with the number of
+ * voxels that are not empty, followed by the index of each of them (in the same order, as 32-bit integer) along with
+ * its density (as 32-bit float).
+ * @see "Ratio and Delta Tracking" in "Unbiased Global Illumination with Participating Media" (Raab et al., 2008)
+ */
+class GridMedium final : public Medium {
+    static constexpr char Magic[4] = { 'L', 'W', 'V', 'G' };
+    static constexpr uint32_t Version = 1;
+
+    enum class Encoding : uint32_t {
+        Dense  = 0,
+        Sparse = 1,
+    };
+
+    Vector3i m_resolution;
+    std::vector<float> m_density;
+    /// @brief The factor the densities of the grid are multiplied with to obtain the extinction (per unit distance).
+    float m_scale;
+    Color m_albedo;
+    /// @brief The asymmetry of the Henyey-Greenstein phase function (positive values scatter forward).
+    float m_g;
+
+    /// @brief The number of voxels along each axis that share a majorant.
+    int m_majorantCellSize;
+    Vector3i m_majorantResolution;
+    std::vector<float> m_majorants;
+
+    float voxel(int x, int y, int z) const {
+        x = std::clamp(x, 0, m_resolution.x() - 1);
+        y = std::clamp(y, 0, m_resolution.y() - 1);
+        z = std::clamp(z, 0, m_resolution.z() - 1);
+        return m_density[(size_t(z) * m_resolution.y() + y) * m_resolution.x() + x];
+    }
+
+    /// @brief Returns the extinction at a point given in grid coordinates (i.e., in [0,resolution)).
+    float density(const Point &p) const {
+        const float x = p.x() - 0.5f, y = p.y() - 0.5f, z = p.z() - 0.5f;
+        const int x0 = int(std::floor(x)), y0 = int(std::floor(y)), z0 = int(std::floor(z));
+        const float fx = x - x0, fy = y - y0, fz = z - z0;
+
+        float result = 0;
+        for (int corner = 0; corner < 8; corner++) {
+            const int dx = corner & 1, dy = (corner >> 1) & 1, dz = corner >> 2;
+            const float weight = (dx ? fx : 1 - fx) * (dy ? fy : 1 - fy) * (dz ? fz : 1 - fz);
+            if (weight > 0) result += weight * voxel(x0 + dx, y0 + dy, z0 + dz);
+        }
+        return m_scale * result;
+    }
+
+    void load(const std::filesystem::path &path) {
+        std::ifstream file { path, std::ios::binary };
+        if (!file) lightwave_throw("could not read volume grid %s", path);
+
+        char magic[sizeof(Magic)];
+        uint32_t version;
+        Encoding encoding;
+        int32_t resolution[3];
+        file.read(magic, sizeof(magic));
+        file.read(reinterpret_cast<char *>(&version), sizeof(version));
+        file.read(reinterpret_cast<char *>(&encoding), sizeof(encoding));
+        file.read(reinterpret_cast<char *>(resolution), sizeof(resolution));
+        if (!file || !std::equal(magic, magic + sizeof(magic), Magic) || version != Version) {
+            lightwave_throw("%s is not a volume grid of this version", path);
+        }
+        if (resolution[0] <= 0 || resolution[1] <= 0 || resolution[2] <= 0) {
+            lightwave_throw("volume grid %s has an invalid resolution", path);
+        }
+
+        m_resolution = Vector3i(resolution[0], resolution[1], resolution[2]);
+        const size_t voxels = size_t(resolution[0]) * resolution[1] * resolution[2];
+        m_density.assign(voxels, 0);
+        if (encoding == Encoding::Dense) {
+            file.read(reinterpret_cast<char *>(m_density.data()), std::streamsize(voxels * sizeof(float)));
+        } else if (encoding == Encoding::Sparse) {
+            uint32_t count;
+            file.read(reinterpret_cast<char *>(&count), sizeof(count));
+            for (uint32_t i = 0; i < count && file; i++) {
+                uint32_t index;
+                float value;
+                file.read(reinterpret_cast<char *>(&index), sizeof(index));
+                file.read(reinterpret_cast<char *>(&value), sizeof(value));
+                if (index >= voxels) lightwave_throw("volume grid %s has a voxel outside of its resolution", path);
+                m_density[index] = value;
+            }
+        } else {
+            lightwave_throw("volume grid %s has an unknown encoding", path);
+        }
+        if (!file) lightwave_throw("volume grid %s is truncated", path);
+
+        for (float &value : m_density)
+            value = std::max(value, 0.f);
+    }
+
+    /// @brief Builds the grid of majorants, each of which bounds the density that can be interpolated within its cell.
+    void buildMajorants() {
+        for (int dim = 0; dim < 3; dim++)
+            m_majorantResolution[dim] = (m_resolution[dim] + m_majorantCellSize - 1) / m_majorantCellSize;
+        m_majorants.assign(size_t(m_majorantResolution.x()) * m_majorantResolution.y() * m_majorantResolution.z(), 0);
+
+        int nonEmpty = 0;
+        for (int cz = 0; cz < m_majorantResolution.z(); cz++) {
+            for (int cy = 0; cy < m_majorantResolution.y(); cy++) {
+                for (int cx = 0; cx < m_majorantResolution.x(); cx++) {
+                    // interpolation within the cell also reaches the voxels bordering it
+                    float majorant = 0;
+                    const int c = m_majorantCellSize;
+                    for (int z = cz * c - 1; z <= (cz + 1) * c; z++) {
+                        for (int y = cy * c - 1; y <= (cy + 1) * c; y++) {
+                            for (int x = cx * c - 1; x <= (cx + 1) * c; x++) {
+                                majorant = std::max(majorant, voxel(x, y, z));
+                            }
+                        }
+                    }
+                    m_majorants[(size_t(cz) * m_majorantResolution.y() + cy) * m_majorantResolution.x() + cx] =
+                        m_scale * majorant;
+                    nonEmpty += majorant > 0;
+                }
+            }
+        }
+        logger(EDebug, "built %dx%dx%d majorant grid (%d cells not empty)", m_majorantResolution.x(),
+               m_majorantResolution.y(), m_majorantResolution.z(), nonEmpty);
+    }
+
+    /**
+     * @brief Visits the cells of the majorant grid that a ray passes through before @c tMax , in order, by calling
+     * @c visit with the ray in grid coordinates, the range of distances within each cell and its majorant until it
+     * returns @c false .
+     */
+    template <typename F>
+    void traverse(const Point &origin, const Vector &direction, float tMax, F visit) const {
+        // convert from object coordinates in [-1,+1] to grid coordinates in [0,resolution)
+        Point o;
+        Vector d;
+        for (int dim = 0; dim < 3; dim++) {
+            o[dim] = (origin[dim] + 1) / 2 * m_resolution[dim];
+            d[dim] = direction[dim] / 2 * m_resolution[dim];
+        }
+
+        // clip the ray against the bounds of the grid
+        float tEnter = 0, tExit = tMax;
+        for (int dim = 0; dim < 3; dim++) {
+            if (d[dim] == 0) {
+                if (o[dim] < 0 || o[dim] > m_resolution[dim]) return;
+                continue;
+            }
+            float t0 = -o[dim] / d[dim];
+            float t1 = (m_resolution[dim] - o[dim]) / d[dim];
+            if (t0 > t1) std::swap(t0, t1);
+            tEnter = std::max(tEnter, t0);
+            tExit  = std::min(tExit, t1);
+        }
+        if (!(tEnter < tExit)) return;
+
+        // step through the cells of the majorant grid (Amanatides and Woo)
+        const float c = float(m_majorantCellSize);
+        const Point entry = o + tEnter * d;
+        Vector3i cell;
+        Vector3i step;
+        Vector tNext, tDelta;
+        for (int dim = 0; dim < 3; dim++) {
+            cell[dim] = std::clamp(int(entry[dim] / c), 0, m_majorantResolution[dim] - 1);
+            if (d[dim] > 0) {
+                step[dim]   = 1;
+                tNext[dim]  = ((cell[dim] + 1) * c - o[dim]) / d[dim];
+                tDelta[dim] = c / d[dim];
+            } else if (d[dim] < 0) {
+                step[dim]   = -1;
+                tNext[dim]  = (cell[dim] * c - o[dim]) / d[dim];
+                tDelta[dim] = -c / d[dim];
+            } else {
+                step[dim]   = 0;
+                tNext[dim]  = Infinity;
+                tDelta[dim] = Infinity;
+            }
+        }
+
+        float t = tEnter;
+        while (true) {
+            const int axis = tNext.x() < tNext.y() ? (tNext.x() < tNext.z() ? 0 : 2) : (tNext.y() < tNext.z() ? 1 : 2);
+            const float tCellExit = std::min(tNext[axis], tExit);
+            const float majorant =
+                m_majorants[(size_t(cell.z()) * m_majorantResolution.y() + cell.y()) * m_majorantResolution.x() +
+                            cell.x()];
+            if (tCellExit > t && !visit(o, d, t, tCellExit, majorant)) return;
+            if (tCellExit >= tExit) return;
+
+            t = tCellExit;
+            cell[axis] += step[axis];
+            if (cell[axis] < 0 || cell[axis] >= m_majorantResolution[axis]) return;
+            tNext[axis] += tDelta[axis];
+        }
+    }
+
+public:
+    GridMedium(const Properties &properties) {
+        m_scale = properties.get<float>("density", 1);
+        m_albedo = properties.get<Color>("albedo", Color(1));
+        m_g = std::clamp(properties.get<float>("g", 0), -0.99f, 0.99f);
+        m_majorantCellSize = std::max(properties.get<int>("majorantCellSize", 8), 1);
+
+        const std::filesystem::path path = properties.get<std::filesystem::path>("filename");
+        load(path);
+        buildMajorants();
+        logger(EInfo, "loaded %dx%dx%d volume grid from %s", m_resolution.x(), m_resolution.y(), m_resolution.z(),
+               path);
+    }
+
+    MediumSample sampleFreeFlight(const Point &origin, const Vector &direction, float tMax,
+                                  Sampler &rng) const override {
+        MediumSample result = MediumSample::passed();
+        traverse(origin, direction, tMax, [&](const Point &o, const Vector &d, float t, float tCellExit, float majorant) {
+            if (majorant <= 0) return true;
+            while (true) {
+                // tentative collisions happen at the rate of the majorant, and are real with the ratio of the density
+                t -= std::log(1 - rng.next()) / majorant;
+                if (t >= tCellExit) return true;
+                if (rng.next() * majorant < density(o + t * d)) {
+                    result = { .t = t, .weight = m_albedo, .medium = this };
+                    return false;
+                }
+            }
+        });
+        return result;
+    }
+
+    float transmittance(const Point &origin, const Vector &direction, float tMax, Sampler &rng) const override {
+        float transmittance = 1;
+        traverse(origin, direction, tMax, [&](const Point &o, const Vector &d, float t, float tCellExit, float majorant) {
+            if (majorant <= 0) return true;
+            while (true) {
+                // every tentative collision removes the fraction of light that a real collision would
+                t -= std::log(1 - rng.next()) / majorant;
+                if (t >= tCellExit) return true;
+                transmittance *= 1 - density(o + t * d) / majorant;
+                if (transmittance <= 0) return false;
+            }
+        });
+        return transmittance;
+    }
+
+    float evaluatePhase(const Vector &wo, const Vector &wi) const override {
+        return henyeyGreenstein(wo.dot(wi), m_g);
+    }
+
+    PhaseSample samplePhase(const Vector &wo, Sampler &rng) const override {
+        const Vector wi = squareToHenyeyGreenstein(rng.next2D(), wo, m_g);
+        return { .wi = wi, .pdf = evaluatePhase(wo, wi) };
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "GridMedium[\n"
+            "  resolution = %dx%dx%d,\n"
+            "  density = %f,\n"
+            "  albedo = %s,\n"
+            "  g = %f,\n"
+            "  majorantCellSize = %d\n"
+            "]",
+            m_resolution.x(), m_resolution.y(), m_resolution.z(),
+            m_scale,
+            m_albedo,
+            m_g,
+            m_majorantCellSize
+        );
+    }
+};
+
+}
+
+REGISTER_MEDIUM(GridMedium, "grid")
@@ -1,3 +1,4 @@
+#ifdef LW_WITH_OIDN
 #include <lightwave.hpp>
 #include <OpenImageDenoise/oidn.hpp>
 
@@ -66,3 +67,5 @@ public:
 } // namespace lightwave
 
 REGISTER_POSTPROCESS(Denoise, "denoise")
+
+#endif
@@ -0,0 +1,282 @@
+#include <lightwave.hpp>
+
+#include <array>
+
+namespace lightwave {
+
+/**
+ * @brief A denoiser that does not depend on external libraries, which averages each pixel with the pixels of a window
+ * around it that look alike ("non-local means"), guided by auxiliary features of the scene.
+ * Pixels are compared by the color of the patches around them, with differences measured relative to the variance of
+ * the pixel estimates (so that noise alone does not make pixels look different), and by their albedo and normal (so
+ * that edges and textures that are noise free in these features are kept sharp). The variance is read from an optional
+ * @c variance image (e.g., the AOV of the @c aov integrator), or otherwise estimated from the 3x3 neighborhood of each
+ * pixel. The @c albedo and @c normals images are optional as well, but greatly improve the result.
+ *
+ * For each offset within the window, the patch distances of all pixels are computed with separable box filters over
+ * rows of planar color channels, which keeps the work per pixel independent of the patch size. Bands of rows are
+ * denoised in parallel.
+ * @note There are no SIMD intrinsics, so that the denoiser builds wherever the renderer does. The inner loops run over
+ * contiguous floats without branches instead, which the compiler vectorizes for the instruction set of the build, except
+ * for the prefix sums and the exponentials of the weights.
+ * @see "Robust Denoising using Feature and Color Information" (Rousselle et al., 2013)
+ */
+class NLMeansDenoise final : public Postprocess {
+    /// @brief The number of rows that are denoised together by one thread.
+    static constexpr int BandHeight = 16;
+
+    /// @brief An image stored as one contiguous array per color channel.
+    struct Planes {
+        std::array<std::vector<float>, Color::NumComponents> channels;
+
+        Planes() {}
+        Planes(const Image &image) {
+            const size_t size = size_t(image.resolution().x()) * image.resolution().y();
+            for (int c = 0; c < Color::NumComponents; c++) {
+                channels[c].resize(size);
+                for (size_t i = 0; i < size; i++)
+                    channels[c][i] = image.data()[i][c];
+            }
+        }
+
+        bool empty() const { return channels[0].empty(); }
+    };
+
+    ref<Image> m_albedo;
+    ref<Image> m_normals;
+    ref<Image> m_variance;
+    /// @brief The radius of the window of pixels that are averaged (in pixels).
+    int m_radius;
+    /// @brief The radius of the patches that are compared (in pixels).
+    int m_patchRadius;
+    /// @brief The sensitivity to color differences, in units of the standard deviation of the pixels.
+    float m_k;
+    float m_sigmaAlbedo;
+    float m_sigmaNormal;
+
+    /// @brief Estimates the variance of each pixel from the variance of the colors in its 3x3 neighborhood.
+    static Planes estimateVariance(const Planes &color, const Point2i &resolution) {
+        const int width = resolution.x(), height = resolution.y();
+        Planes variance;
+        for (int c = 0; c < Color::NumComponents; c++) {
+            variance.channels[c].resize(color.channels[c].size());
+            parallel_for(Range(0, height), [&](int y) {
+                for (int x = 0; x < width; x++) {
+                    float sum = 0, sumSquares = 0;
+                    int count = 0;
+                    for (int qy = std::max(y - 1, 0); qy <= std::min(y + 1, height - 1); qy++) {
+                        for (int qx = std::max(x - 1, 0); qx <= std::min(x + 1, width - 1); qx++) {
+                            const float value = color.channels[c][size_t(qy) * width + qx];
+                            sum += value;
+                            sumSquares += sqr(value);
+                            count++;
+                        }
+                    }
+                    variance.channels[c][size_t(y) * width + x] =
+                        std::max(sumSquares / count - sqr(sum / count), 0.f) * count / (count - 1);
+                }
+            });
+        }
+        return variance;
+    }
+
+    /**
+     * @brief Computes the color distance of the pixels [x0,x1) of row @c y to the pixels at offset @c dx , @c dy
+     * (which all need to lie within the image).
+     */
+    void colorDistance(const Planes &color, const Planes &variance, int width, int y, int qy, int dx, int x0, int x1,
+                       float *distance) const {
+        constexpr float Regularization = 1e-10f;
+        const float k2 = sqr(m_k);
+        for (int x = x0; x < x1; x++)
+            distance[x] = 0;
+        for (int c = 0; c < Color::NumComponents; c++) {
+            const float *up = color.channels[c].data() + size_t(y) * width;
+            const float *uq = color.channels[c].data() + size_t(qy) * width + dx;
+            const float *vp = variance.channels[c].data() + size_t(y) * width;
+            const float *vq = variance.channels[c].data() + size_t(qy) * width + dx;
+            for (int x = x0; x < x1; x++) {
+                // the expected squared difference due to noise is subtracted (with less weight for the brighter one)
+                const float difference = sqr(up[x] - uq[x]) - (vp[x] + std::min(vp[x], vq[x]));
+                distance[x] += difference / (Regularization + k2 * (vp[x] + vq[x]));
+            }
+        }
+        for (int x = x0; x < x1; x++)
+            distance[x] *= 1.0f / Color::NumComponents;
+    }
+
+    /// @brief Adds the distance of the features of the pixels [x0,x1) of row @c y to those at the given offset.
+    static void featureDistance(const Planes &feature, float sigma, int width, int y, int qy, int dx, int x0, int x1,
+                                float *distance) {
+        if (feature.empty()) return;
+        const float scale = 1 / (2 * sqr(sigma));
+        for (int c = 0; c < Color::NumComponents; c++) {
+            const float *fp = feature.channels[c].data() + size_t(y) * width;
+            const float *fq = feature.channels[c].data() + size_t(qy) * width + dx;
+            for (int x = x0; x < x1; x++)
+                distance[x] += scale * sqr(fp[x] - fq[x]);
+        }
+    }
+
+public:
+    NLMeansDenoise(const Properties &properties) : Postprocess(properties) {
+        m_albedo = properties.get<Image>("albedo", ref<Image>());
+        m_normals = properties.get<Image>("normals", ref<Image>());
+        m_variance = properties.get<Image>("variance", ref<Image>());
+        m_radius = std::max(properties.get<int>("radius", 7), 1);
+        m_patchRadius = std::max(properties.get<int>("patchRadius", 1), 0);
+        m_k = properties.get<float>("k", 0.45f);
+        m_sigmaAlbedo = properties.get<float>("sigmaAlbedo", 0.1f);
+        m_sigmaNormal = properties.get<float>("sigmaNormal", 0.2f);
+    }
+
+    void execute() override {
+        const Point2i resolution = m_input->resolution();
+        const int width = resolution.x(), height = resolution.y();
+        for (const auto &guide : { m_albedo, m_normals, m_variance }) {
+            if (guide && guide->resolution() != resolution) {
+                lightwave_throw("the image %s does not have the resolution of the image to denoise", guide->id());
+            }
+        }
+
+        Timer timer;
+        const Planes color { *m_input };
+        const Planes albedo = m_albedo ? Planes(*m_albedo) : Planes();
+        const Planes normals = m_normals ? Planes(*m_normals) : Planes();
+        const Planes variance = m_variance ? Planes(*m_variance) : estimateVariance(color, resolution);
+
+        m_output->initialize(resolution);
+        const int f = m_patchRadius;
+        const float patchScale = 1.0f / (2 * f + 1);
+        const int numBands = (height + BandHeight - 1) / BandHeight;
+        parallel_for(Range(0, numBands), [&](int band) {
+            const int y0 = band * BandHeight;
+            const int y1 = std::min(y0 + BandHeight, height);
+            const int rows = y1 - y0;
+
+            // the scratch memory of the band is taken from the arena of the thread, which is reused by later bands
+            auto &arena = MemoryArena::forThread();
+            // the distances of the rows of the band, including the rows that the patches reach beyond it
+            float *distances = arena.allocate<float>(size_t(rows + 2 * f) * width);
+            float *filtered = arena.allocate<float>(size_t(rows + 2 * f) * width);
+            float *weights = arena.allocate<float>(size_t(rows) * width);
+            std::fill_n(weights, size_t(rows) * width, 0.f);
+            std::array<float *, Color::NumComponents> sums;
+            for (auto &sum : sums) {
+                sum = arena.allocate<float>(size_t(rows) * width);
+                std::fill_n(sum, size_t(rows) * width, 0.f);
+            }
+            float *prefix = arena.allocate<float>(width + 1);
+            float *feature = arena.allocate<float>(width);
+
+            for (int dy = -m_radius; dy <= m_radius; dy++) {
+                for (int dx = -m_radius; dx <= m_radius; dx++) {
+                    // the pixels whose counterpart at the offset lies within the image
+                    const int x0 = std::max(0, -dx), x1 = std::min(width, width - dx);
+                    if (x0 >= x1) continue;
+
+                    for (int row = 0; row < rows + 2 * f; row++) {
+                        // patches extending beyond the image repeat its border
+                        const int y = std::clamp(y0 - f + row, 0, height - 1);
+                        const int qy = std::clamp(y + dy, 0, height - 1);
+                        float *distance = &distances[size_t(row) * width];
+                        colorDistance(color, variance, width, y, qy, dx, x0, x1, distance);
+                        for (int x = 0; x < x0; x++) distance[x] = distance[x0];
+                        for (int x = x1; x < width; x++) distance[x] = distance[x1 - 1];
+
+                        // box filter along the row using a prefix sum
+                        prefix[0] = 0;
+                        for (int x = 0; x < width; x++)
+                            prefix[x + 1] = prefix[x] + distance[x];
+                        float *out = &filtered[size_t(row) * width];
+                        // the box is clipped only near the ends of the row, which keeps the loop in between simple
+                        const int inner0 = std::min(f, width), inner1 = std::max(width - f, inner0);
+                        const auto clippedBox = [&](int x) {
+                            const int a = std::max(x - f, 0), b = std::min(x + f + 1, width);
+                            out[x] = (prefix[b] - prefix[a]) / (b - a);
+                        };
+                        for (int x = 0; x < inner0; x++) clippedBox(x);
+                        for (int x = inner1; x < width; x++) clippedBox(x);
+                        for (int x = inner0; x < inner1; x++)
+                            out[x] = (prefix[x + f + 1] - prefix[x - f]) * patchScale;
+                    }
+
+                    for (int row = 0; row < rows; row++) {
+                        const int y = y0 + row;
+                        const int qy = y + dy;
+                        if (qy < 0 || qy >= height) continue;
+
+                        // box filter along the columns of the patch, followed by the distance of the features
+                        float *distance = feature;
+                        for (int x = x0; x < x1; x++)
+                            distance[x] = 0;
+                        for (int i = 0; i <= 2 * f; i++) {
+                            const float *in = &filtered[size_t(row + i) * width];
+                            for (int x = x0; x < x1; x++)
+                                distance[x] += in[x];
+                        }
+                        for (int x = x0; x < x1; x++)
+                            distance[x] = std::max(distance[x] * patchScale, 0.f);
+                        featureDistance(albedo, m_sigmaAlbedo, width, y, qy, dx, x0, x1, distance);
+                        featureDistance(normals, m_sigmaNormal, width, y, qy, dx, x0, x1, distance);
+
+                        float *weight = &weights[size_t(row) * width];
+                        for (int x = x0; x < x1; x++) {
+                            distance[x] = std::exp(-distance[x]);
+                            weight[x] += distance[x];
+                        }
+                        for (int c = 0; c < Color::NumComponents; c++) {
+                            const float *uq = color.channels[c].data() + size_t(qy) * width + dx;
+                            float *sum = &sums[c][size_t(row) * width];
+                            for (int x = x0; x < x1; x++)
+                                sum[x] += distance[x] * uq[x];
+                        }
+                    }
+                }
+            }
+
+            for (int row = 0; row < rows; row++) {
+                for (int x = 0; x < width; x++) {
+                    const size_t index = size_t(row) * width + x;
+                    Color &pixel = m_output->get(Point2i(x, y0 + row));
+                    // the pixel itself always has a weight of one
+                    for (int c = 0; c < Color::NumComponents; c++)
+                        pixel[c] = sums[c][index] / weights[index];
+                }
+            }
+            arena.reset();
+        });
+
+        logger(EInfo, "denoised %dx%d image in %.1f seconds", width, height, timer.getElapsedTime());
+        Streaming stream { *m_output };
+        stream.update();
+        m_output->save();
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "NLMeansDenoise[\n"
+            "  radius = %d,\n"
+            "  patchRadius = %d,\n"
+            "  k = %f,\n"
+            "  sigmaAlbedo = %f,\n"
+            "  sigmaNormal = %f,\n"
+            "  albedo = %s,\n"
+            "  normals = %s,\n"
+            "  variance = %s,\n"
+            "]",
+            m_radius,
+            m_patchRadius,
+            m_k,
+            m_sigmaAlbedo,
+            m_sigmaNormal,
+            indent(m_albedo),
+            indent(m_normals),
+            indent(m_variance)
+        );
+    }
+};
+
+} // namespace lightwave
+
+REGISTER_POSTPROCESS(NLMeansDenoise, "nlmeans")
@@ -2,6 +2,7 @@
 
 #include <lightwave/core.hpp>
 #include <lightwave/math.hpp>
+#include <lightwave/parallel.hpp>
 #include <lightwave/shape.hpp>
 
 #include <numeric>
@@ -84,6 +85,14 @@ class AccelerationStructure : public Shape {
      */
     std::vector<int> m_primitiveIndices;
 
+    /// @brief A copy of the BVH placed in the memory of one NUMA node.
+    struct Replica {
+        std::vector<Node> nodes;
+        std::vector<int> primitiveIndices;
+    };
+    /// @brief Copies of the BVH for each NUMA node (empty unless @ref replicatePerNode has been called).
+    std::vector<Replica> m_replicas;
+
     /// @brief Returns the root BVH node.
     const Node &rootNode() const {
         // by convention, this is always the first element of m_nodes
@@ -93,8 +102,11 @@ class AccelerationStructure : public Shape {
     /**
      * @brief Intersects a BVH node, recursing into children (for internal
      * nodes), or intersecting all primitives (for leaf nodes).
+     * The nodes and primitive indices are passed explicitly, since they might
+     * come from a node-local replica of the BVH.
      */
-    bool intersectNode(const Node &node, const Ray &ray, Intersection &its,
+    bool intersectNode(const Node *nodes, const int *primitiveIndices,
+                       const Node &node, const Ray &ray, Intersection &its,
                        Sampler &rng) const {
         // update the statistic tracking how many BVH nodes have been tested for
         // intersection
@@ -108,7 +120,7 @@ class AccelerationStructure : public Shape {
                 its.stats.primCounter++;
                 // test the child for intersection
                 wasIntersected |= intersect(
-                    m_primitiveIndices[node.leftFirst + i], ray, its, rng);
+                    primitiveIndices[node.leftFirst + i], ray, its, rng);
             }
         } else { // internal node
             // test which bounding box is intersected first by the ray.
@@ -116,55 +128,30 @@ class AccelerationStructure : public Shape {
             // intersected in, which can help prune a lot of unnecessary
             // intersection tests.
             const auto leftT =
-                intersectAABB(m_nodes[node.leftChildIndex()].aabb, ray);
+                intersectAABB(nodes[node.leftChildIndex()].aabb, ray);
             const auto rightT =
-                intersectAABB(m_nodes[node.rightChildIndex()].aabb, ray);
+                intersectAABB(nodes[node.rightChildIndex()].aabb, ray);
             if (leftT < rightT) { // left child is hit first; test left child
                                   // first, then right child
                 if (leftT < its.t)
                     wasIntersected |= intersectNode(
-                        m_nodes[node.leftChildIndex()], ray, its, rng);
+                        nodes, primitiveIndices, nodes[node.leftChildIndex()], ray, its, rng);
                 if (rightT < its.t)
                     wasIntersected |= intersectNode(
-                        m_nodes[node.rightChildIndex()], ray, its, rng);
+                        nodes, primitiveIndices, nodes[node.rightChildIndex()], ray, its, rng);
             } else { // right child is hit first; test right child first, then
                      // left child
                 if (rightT < its.t)
                     wasIntersected |= intersectNode(
-                        m_nodes[node.rightChildIndex()], ray, its, rng);
+                        nodes, primitiveIndices, nodes[node.rightChildIndex()], ray, its, rng);
                 if (leftT < its.t)
                     wasIntersected |= intersectNode(
-                        m_nodes[node.leftChildIndex()], ray, its, rng);
+                        nodes, primitiveIndices, nodes[node.leftChildIndex()], ray, its, rng);
             }
         }
         return wasIntersected;
     }
 
-    /// @brief Performs a slab test to intersect a bounding box with a ray,
-    /// returning Infinity in case the ray misses.
-    float intersectAABB(const Bounds &bounds, const Ray &ray) const {
-        // but this only saves us ~1%, so let's not do it. intersect all axes at
-        // once with the minimum slabs of the bounding box
-        const auto t1 = (bounds.min() - ray.origin) / ray.direction;
-        // intersect all axes at once with the maximum slabs of the bounding box
-        const auto t2 = (bounds.max() - ray.origin) / ray.direction;
-
-        // the elementwiseMin picks the near slab for each axis, of which we
-        // then take the maximum
-        const auto tNear = elementwiseMin(t1, t2).maxComponent();
-        // the elementwiseMax picks the far slab for each axis, of which we then
-        // take the minimum
-        const auto tFar = elementwiseMax(t1, t2).minComponent();
-
-        if (tFar < tNear)
-            return Infinity; // the ray does not intersect the bounding box
-        if (tFar < Epsilon)
-            return Infinity; // the bounding box lies behind the ray origin
-
-        return tNear; // return the first intersection with the bounding box
-                      // (may also be negative!)
-    }
-
     /// @brief Computes the axis aligned bounding box for a leaf BVH node
     void computeAABB(Node &node) {
         node.aabb = Bounds::empty();
@@ -344,6 +331,31 @@ class AccelerationStructure : public Shape {
     }
 
 protected:
+    /// @brief Performs a slab test to intersect a bounding box with a ray,
+    /// returning Infinity in case the ray misses.
+    float intersectAABB(const Bounds &bounds, const Ray &ray) const {
+        // but this only saves us ~1%, so let's not do it. intersect all axes at
+        // once with the minimum slabs of the bounding box
+        const auto t1 = (bounds.min() - ray.origin) / ray.direction;
+        // intersect all axes at once with the maximum slabs of the bounding box
+        const auto t2 = (bounds.max() - ray.origin) / ray.direction;
+
+        // the elementwiseMin picks the near slab for each axis, of which we
+        // then take the maximum
+        const auto tNear = elementwiseMin(t1, t2).maxComponent();
+        // the elementwiseMax picks the far slab for each axis, of which we then
+        // take the minimum
+        const auto tFar = elementwiseMax(t1, t2).minComponent();
+
+        if (tFar < tNear)
+            return Infinity; // the ray does not intersect the bounding box
+        if (tFar < Epsilon)
+            return Infinity; // the bounding box lies behind the ray origin
+
+        return tNear; // return the first intersection with the bounding box
+                      // (may also be negative!)
+    }
+
     /// @brief Returns the number of children (individual shapes) that are part
     /// of this acceleration structure.
     virtual int numberOfPrimitives() const = 0;
@@ -376,14 +388,48 @@ protected:
                buildTimer.getElapsedTime() * 1000);
     }
 
+    /**
+     * @brief Creates a copy of the BVH on each NUMA node, so that threads
+     * traversing it do not need to read memory of other nodes. This is
+     * worthwhile for small structures that are traversed by every ray (e.g.,
+     * the top-level BVH of the scene), and has no effect on machines with a
+     * single node.
+     */
+    void replicatePerNode() {
+        const int numNodes = ThreadPool::numNodes();
+        if (numNodes <= 1 || m_nodes.empty())
+            return;
+
+        m_replicas.resize(numNodes);
+        for (int node = 0; node < numNodes; node++) {
+            // the copy is made (and hence first touched) by a thread on the target node
+            ThreadPool::runOnNode(node, [&]() {
+                m_replicas[node].nodes            = m_nodes;
+                m_replicas[node].primitiveIndices = m_primitiveIndices;
+            });
+        }
+        logger(EInfo, "replicated BVH with %ld nodes on %d NUMA nodes",
+               m_nodes.size(), numNodes);
+    }
+
 public:
     bool intersect(const Ray &ray, Intersection &its,
                    Sampler &rng) const override {
         if (m_primitiveIndices.empty())
             return false; // exit early if no children exist
-        if (intersectAABB(rootNode().aabb, ray) <
+
+        const Node *nodes           = m_nodes.data();
+        const int *primitiveIndices = m_primitiveIndices.data();
+        if (!m_replicas.empty()) {
+            const auto &replica = m_replicas[ThreadPool::currentNode()];
+            nodes               = replica.nodes.data();
+            primitiveIndices    = replica.primitiveIndices.data();
+        }
+
+        if (intersectAABB(nodes[0].aabb, ray) <
             its.t) // test root bounding box for potential hit
-            return intersectNode(rootNode(), ray, its, rng);
+            return intersectNode(nodes, primitiveIndices, nodes[0], ray, its,
+                                 rng);
         return false;
     }
 
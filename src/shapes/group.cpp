@@ -11,6 +11,26 @@ namespace lightwave {
  */
 class Group final : public AccelerationStructure {
     std::vector<ref<Shape>> m_children;
+    /// @brief Picks children in proportion to their area, built when the group is first sampled.
+    mutable AliasTable m_childAreas;
+    mutable float m_area = 0;
+    mutable InitOnce m_areaSampling;
+    /// @brief Whether the group is sampled by area, in which case intersections report the density of the point.
+    bool m_sampled = false;
+
+    /// @brief Builds the table that area sampling picks children from, unless it has already been built.
+    void ensureAreaSampling() const {
+        m_areaSampling.ensure([&]() {
+            std::vector<float> areas;
+            double total = 0;
+            for (const auto &child : m_children) {
+                areas.push_back(child->area());
+                total += areas.back();
+            }
+            m_area = float(total);
+            m_childAreas = AliasTable(areas);
+        });
+    }
 
 protected:
     int numberOfPrimitives() const override {
@@ -18,7 +38,11 @@ protected:
     }
 
     bool intersect(int primitiveIndex, const Ray &ray, Intersection &its, Sampler &rng) const override {
-        return m_children[primitiveIndex]->intersect(ray, its, rng);
+        const Shape &child = *m_children[primitiveIndex];
+        if (!child.intersect(ray, its, rng)) return false;
+        // the density of picking the child and then sampling the point on it, as in sampleArea
+        if (m_sampled) its.pdf = m_childAreas.pmf(primitiveIndex) * child.areaPdf(its);
+        return true;
     }
 
     Bounds getBoundingBox(int primitiveIndex) const override {
@@ -33,21 +57,49 @@ public:
     Group(const Properties &properties) {
         m_children = properties.getChildren<Shape>();
         buildAccelerationStructure();
+        if (properties.get<bool>("replicateBvh", false)) {
+            // the top-level BVH is traversed by every ray, so keeping a copy on each NUMA node avoids remote reads
+            replicatePerNode();
+        }
     }
 
     void markAsVisible() override {
         for (auto &child : m_children) child->markAsVisible();
     }
 
+    void markAsSampled() override {
+        ensureAreaSampling();
+        m_sampled = true;
+        for (auto &child : m_children) child->markAsSampled();
+    }
+
+    bool containsMedia() const override {
+        for (const auto &child : m_children) {
+            if (child->containsMedia()) return true;
+        }
+        return false;
+    }
+
     AreaSample sampleArea(Sampler &rng) const override {
-        int childIndex = int(rng.next() * m_children.size());
-        childIndex = std::min(childIndex, int(m_children.size()) - 1);
+        ensureAreaSampling();
+        if (m_children.empty()) return AreaSample::invalid();
 
+        const int childIndex = m_childAreas.sample(rng.next());
         AreaSample sample = m_children[childIndex]->sampleArea(rng);
-        sample.pdf /= m_children.size();
+        sample.pdf *= m_childAreas.pmf(childIndex);
         return sample;
     }
 
+    float areaPdf(const SurfaceEvent &surface) const override {
+        // the density depends on the child the point lies on, which intersection and sampling have accounted for
+        return surface.pdf;
+    }
+
+    float area() const override {
+        ensureAreaSampling();
+        return m_area;
+    }
+
     std::string toString() const override {
         std::stringstream oss;
         oss << "Group[" << std::endl;
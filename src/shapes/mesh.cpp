@@ -1,5 +1,6 @@
 #include <lightwave.hpp>
 
+#include "../core/assetcache.hpp"
 #include "../core/plyparser.hpp"
 #include "accel.hpp"
 
@@ -12,26 +13,87 @@ namespace lightwave {
  */
 class TriangleMesh : public AccelerationStructure {
     /**
-     * @brief The index buffer of the triangles.
-     * The n-th element corresponds to the n-th triangle, and each component of the element corresponds to one
-     * vertex index (into @c m_vertices ) of the triangle.
-     * This list will always contain as many elements as there are triangles.
-     */
-    std::vector<Vector3i> m_triangles;
-    /**
-     * @brief The vertex buffer of the triangles, indexed by m_triangles.
+     * @brief The triangle data of the mesh, shared with all other meshes that use the same file.
+     * The n-th element of the index buffer corresponds to the n-th triangle, and each component of the element
+     * corresponds to one vertex index (into the vertex buffer) of the triangle.
      * Note that multiple triangles can share vertices, hence there can also be fewer than @code 3 * numTriangles @endcode
      * vertices.
      */
-    std::vector<Vertex> m_vertices;
+    cref<MeshData> m_mesh;
     /// @brief The file this mesh was loaded from, for logging and debugging purposes.
     std::filesystem::path m_originalPath;
-    /// @brief Whether to interpolate the normals from m_vertices, or report the geometric normal instead.
+    /// @brief Whether to interpolate the normals from the vertex buffer, or report the geometric normal instead.
     bool m_smoothNormals;
+    /**
+     * @brief The object space bounding box of the mesh.
+     * For lazily loaded meshes, this is read from the PLY header (or a sidecar file) and is all we know about the mesh
+     * until a ray first hits this box. It never changes after construction, since render threads read it concurrently
+     * with the load (and the parent BVH has already been built from it).
+     */
+    Bounds m_bounds;
+    /// @brief Whether the mesh is loaded lazily, i.e., @c m_bounds has been read from the header.
+    bool m_lazy = false;
+    /// @brief Tracks whether the triangle data and BVH have been loaded (always the case unless the mesh is lazy).
+    mutable InitOnce m_residency;
+    /// @brief Picks triangles in proportion to their area, built when the mesh is first sampled.
+    mutable AliasTable m_triangleAreas;
+    mutable float m_area = 0;
+    mutable InitOnce m_areaSampling;
+
+    /// @brief Reads the triangle data from disk and builds the BVH over it.
+    void load() {
+        m_mesh = AssetCache::global().mesh(m_originalPath);
+        buildAccelerationStructure();
+
+        if (m_lazy) {
+            // triangles outside of the header bounds would be missed by rays, so report stale headers loudly
+            const Bounds actual = AccelerationStructure::getBoundingBox();
+            const float tolerance = 1e-4f * m_bounds.diagonal().length();
+            for (int dim = 0; dim < 3; dim++) {
+                if (actual.min()[dim] < m_bounds.min()[dim] - tolerance ||
+                    actual.max()[dim] > m_bounds.max()[dim] + tolerance) {
+                    logger(EError, "the bounds in the header or sidecar file of %s do not contain its triangles", m_originalPath);
+                    break;
+                }
+            }
+        }
+    }
+
+    /// @brief Materializes the mesh if it has not been loaded yet; safe to call concurrently from render threads.
+    void ensureResident() const {
+        m_residency.ensure([&]() {
+            try {
+                const_cast<TriangleMesh *>(this)->load();
+            } catch (const std::exception &e) {
+                // we are on the render path, where we cannot recover from exceptions
+                logger(EError, "could not load lazy mesh %s: %s", m_originalPath, e.what());
+                abort();
+            }
+        });
+    }
+
+    /// @brief Builds the table that area sampling picks triangles from, unless it has already been built.
+    void ensureAreaSampling() const {
+        ensureResident();
+        m_areaSampling.ensure([&]() {
+            std::vector<float> areas(m_mesh->triangles.size());
+            double total = 0;
+            for (size_t i = 0; i < areas.size(); i++) {
+                const Vector3i triangle = m_mesh->triangles[i];
+                const Point v1 = m_mesh->vertices[triangle[0]].position;
+                const Point v2 = m_mesh->vertices[triangle[1]].position;
+                const Point v3 = m_mesh->vertices[triangle[2]].position;
+                areas[i] = (v2 - v1).cross(v3 - v1).length() / 2;
+                total += areas[i];
+            }
+            m_area = float(total);
+            m_triangleAreas = AliasTable(areas);
+        });
+    }
 
 protected:
     int numberOfPrimitives() const override {
-        return int(m_triangles.size());
+        return m_mesh ? int(m_mesh->triangles.size()) : 0;
     }
 
     inline void populate(SurfaceEvent &surf, const Point &position, const Vector &norm, const Vector2 &bary, const Vertex &vert1, const Vertex &vert2, const Vertex &vert3) const {
@@ -60,11 +122,11 @@ protected:
         Vector direction = ray.direction;
         Point origin = ray.origin;
 
-        const Vector3i tri_ind = m_triangles[primitiveIndex];
+        const Vector3i tri_ind = m_mesh->triangles[primitiveIndex];
 
-        const Vertex vert1 = m_vertices[tri_ind[0]];
-        const Vertex vert2 = m_vertices[tri_ind[1]];
-        const Vertex vert3 = m_vertices[tri_ind[2]];
+        const Vertex vert1 = m_mesh->vertices[tri_ind[0]];
+        const Vertex vert2 = m_mesh->vertices[tri_ind[1]];
+        const Vertex vert3 = m_mesh->vertices[tri_ind[2]];
 
         const Point v1 = vert1.position;
         const Point v2 = vert2.position;
@@ -134,18 +196,18 @@ protected:
 
         return true;
         // hints:
-        // * use m_triangles[primitiveIndex] to get the vertex indices of the triangle that should be intersected
-        // * if m_smoothNormals is true, interpolate the vertex normals from m_vertices
+        // * use m_mesh->triangles[primitiveIndex] to get the vertex indices of the triangle that should be intersected
+        // * if m_smoothNormals is true, interpolate the vertex normals from m_mesh->vertices
         //   * make sure that your shading frame stays orthonormal!
         // * if m_smoothNormals is false, use the geometrical normal (can be computed from the vertex positions)
     }
 
     Bounds getBoundingBox(int primitiveIndex) const override {
-        const Vector3i tri_ind = m_triangles[primitiveIndex];
+        const Vector3i tri_ind = m_mesh->triangles[primitiveIndex];
 
-        const Vertex vert1 = m_vertices[tri_ind[0]];
-        const Vertex vert2 = m_vertices[tri_ind[1]];
-        const Vertex vert3 = m_vertices[tri_ind[2]];
+        const Vertex vert1 = m_mesh->vertices[tri_ind[0]];
+        const Vertex vert2 = m_mesh->vertices[tri_ind[1]];
+        const Vertex vert3 = m_mesh->vertices[tri_ind[2]];
 
         const Point v1 = vert1.position;
         const Point v2 = vert2.position;
@@ -160,11 +222,11 @@ protected:
     }
 
     Point getCentroid(int primitiveIndex) const override {
-        const Vector3i tri_ind = m_triangles[primitiveIndex];
+        const Vector3i tri_ind = m_mesh->triangles[primitiveIndex];
 
-        const Vertex vert1 = m_vertices[tri_ind[0]];
-        const Vertex vert2 = m_vertices[tri_ind[1]];
-        const Vertex vert3 = m_vertices[tri_ind[2]];
+        const Vertex vert1 = m_mesh->vertices[tri_ind[0]];
+        const Vertex vert2 = m_mesh->vertices[tri_ind[1]];
+        const Vertex vert3 = m_mesh->vertices[tri_ind[2]];
 
         const Point v1 = vert1.position;
         const Point v2 = vert2.position;
@@ -177,17 +239,63 @@ public:
     TriangleMesh(const Properties &properties) {
         m_originalPath = properties.get<std::filesystem::path>("filename");
         m_smoothNormals = properties.get<bool>("smooth", true);
-        readPLY(m_originalPath.string(), m_triangles, m_vertices);
-        logger(EInfo, "loaded ply with %d triangles, %d vertices",
-            m_triangles.size(),
-            m_vertices.size()
-        );
-        buildAccelerationStructure();
+
+        if (properties.get<bool>("lazy", false)) {
+            if (readPLYBounds(m_originalPath, m_bounds)) {
+                m_lazy = true;
+                logger(EDebug, "deferring load of %s until first hit", m_originalPath);
+                return;
+            }
+            logger(EWarn, "%s provides no bounds in its header or a sidecar file, loading eagerly", m_originalPath);
+        }
+
+        ensureResident();
+        m_bounds = AccelerationStructure::getBoundingBox();
+    }
+
+    bool intersect(const Ray &ray, Intersection &its, Sampler &rng) const override {
+        if (!m_residency.isDone()) {
+            // only materialize the mesh once a ray actually reaches its bounding box
+            if (!(intersectAABB(m_bounds, ray) < its.t))
+                return false;
+            ensureResident();
+        }
+        return AccelerationStructure::intersect(ray, its, rng);
+    }
+
+    Bounds getBoundingBox() const override {
+        return m_bounds;
+    }
+
+    Point getCentroid() const override {
+        return m_bounds.center();
     }
 
     AreaSample sampleArea(Sampler &rng) const override {
-        // only implement this if you need triangle mesh area light sampling for your rendering competition
-        NOT_IMPLEMENTED
+        ensureAreaSampling();
+        if (!(m_area > 0)) return AreaSample::invalid();
+
+        const Vector3i triangle = m_mesh->triangles[m_triangleAreas.sample(rng.next())];
+        const Vertex &vert1 = m_mesh->vertices[triangle[0]];
+        const Vertex &vert2 = m_mesh->vertices[triangle[1]];
+        const Vertex &vert3 = m_mesh->vertices[triangle[2]];
+        const Vector e1 = vert2.position - vert1.position;
+        const Vector e2 = vert3.position - vert1.position;
+
+        // uniformly distributed barycentric coordinates
+        const Point2 rnd = rng.next2D();
+        const float su = std::sqrt(rnd.x());
+        const Vector2 bary { su * (1 - rnd.y()), su * rnd.y() };
+
+        AreaSample sample;
+        populate(sample, vert1.position + bary.x() * e1 + bary.y() * e2, e1.cross(e2), bary, vert1, vert2, vert3);
+        sample.pdf = 1 / m_area;
+        return sample;
+    }
+
+    float area() const override {
+        ensureAreaSampling();
+        return m_area;
     }
 
     std::string toString() const override {
@@ -195,11 +303,13 @@ public:
             "Mesh[\n"
             "  vertices = %d,\n"
             "  triangles = %d,\n"
-            "  filename = \"%s\"\n"
+            "  filename = \"%s\",\n"
+            "  resident = %s\n"
             "]",
-            m_vertices.size(),
-            m_triangles.size(),
-            m_originalPath.generic_string()
+            m_mesh ? m_mesh->vertices.size() : 0,
+            m_mesh ? m_mesh->triangles.size() : 0,
+            m_originalPath.generic_string(),
+            m_residency.isDone() ? "true" : "false"
         );
     }
 };
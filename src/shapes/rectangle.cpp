@@ -28,6 +28,50 @@ class Rectangle : public Shape {
         surf.pdf = 1.0f / 4;
     }
 
+    /// @brief Solid angles below which sampling them is numerically unstable, and the rectangle is sampled by area.
+    static constexpr float MinSolidAngle = 3e-4f;
+
+    /**
+     * @brief The spherical rectangle that the rectangle projects to on the unit sphere around a point, along with the
+     * quantities that are needed to sample it uniformly.
+     * @see "An Area-Preserving Parametrization for Spherical Rectangles" (Ureña et al., 2013)
+     */
+    struct SphericalRectangle {
+        /// @brief The extent of the rectangle relative to the point (with the rectangle lying below the point).
+        float x0, x1, y0, y1, z0;
+        float b0, b1, k;
+        float solidAngle;
+    };
+
+    static SphericalRectangle project(const Point &origin) {
+        SphericalRectangle r;
+        r.x0 = -1 - origin.x();
+        r.x1 = +1 - origin.x();
+        r.y0 = -1 - origin.y();
+        r.y1 = +1 - origin.y();
+        r.z0 = -std::abs(origin.z());
+
+        // the normals of the planes that contain the point and one of the edges
+        const Vector n0 = Vector(0, r.z0, -r.y0).normalized();
+        const Vector n1 = Vector(-r.z0, 0, r.x1).normalized();
+        const Vector n2 = Vector(0, -r.z0, r.y1).normalized();
+        const Vector n3 = Vector(r.z0, 0, -r.x0).normalized();
+        const float g0 = std::acos(std::clamp(-n0.dot(n1), -1.f, 1.f));
+        const float g1 = std::acos(std::clamp(-n1.dot(n2), -1.f, 1.f));
+        const float g2 = std::acos(std::clamp(-n2.dot(n3), -1.f, 1.f));
+        const float g3 = std::acos(std::clamp(-n3.dot(n0), -1.f, 1.f));
+
+        r.b0 = n0.z();
+        r.b1 = n2.z();
+        r.k = 2 * Pi - g2 - g3;
+        r.solidAngle = g0 + g1 - r.k;
+        return r;
+    }
+
+    static bool canSampleSolidAngle(const SphericalRectangle &r) {
+        return r.z0 < 0 && r.solidAngle > MinSolidAngle;
+    }
+
 public:
     Rectangle(const Properties &properties) {
     }
@@ -76,6 +120,46 @@ public:
         return sample;
     }
 
+    AreaSample sampleArea(const Point &origin, Sampler &rng) const override {
+        const SphericalRectangle r = project(origin);
+        if (!canSampleSolidAngle(r)) return sampleArea(rng);
+
+        // pick the column of the rectangle by the solid angle to its left, then the height within the column
+        const Point2 rnd = rng.next2D();
+        const float au = rnd.x() * r.solidAngle + r.k;
+        const float fu = (std::cos(au) * r.b0 - r.b1) / std::sin(au);
+        const float cu = std::clamp(std::copysign(1 / std::sqrt(sqr(fu) + sqr(r.b0)), fu), -1.f, 1.f);
+        const float xu = std::clamp(-(cu * r.z0) / safe_sqrt(1 - sqr(cu)), r.x0, r.x1);
+        const float d = std::sqrt(sqr(xu) + sqr(r.z0));
+        const float h0 = r.y0 / std::sqrt(sqr(d) + sqr(r.y0));
+        const float h1 = r.y1 / std::sqrt(sqr(d) + sqr(r.y1));
+        const float hv = h0 + rnd.y() * (h1 - h0);
+        const float yv = sqr(hv) < 1 - 1e-6f ? hv * d / std::sqrt(1 - sqr(hv)) : r.y1;
+
+        AreaSample sample;
+        populate(sample, Point { std::clamp(origin.x() + xu, -1.f, 1.f), std::clamp(origin.y() + yv, -1.f, 1.f), 0 });
+        sample.pdf = areaPdf(origin, sample);
+        return sample;
+    }
+
+    float areaPdf(const Point &origin, const SurfaceEvent &surface) const override {
+        const SphericalRectangle r = project(origin);
+        if (!canSampleSolidAngle(r)) return 1.0f / 4;
+        // convert the uniform density in solid angle to area
+        const float distance = (surface.position - origin).length();
+        return std::abs(origin.z()) / (r.solidAngle * distance * sqr(distance));
+    }
+
+    float area() const override {
+        return 4;
+    }
+
+    AreaSample sampleTexture(const Point2 &uv) const override {
+        AreaSample sample;
+        populate(sample, Point { 2 * uv.x() - 1, 2 * uv.y() - 1, 0 });
+        return sample;
+    }
+
     std::string toString() const override {
         return "Rectangle[]";
     }
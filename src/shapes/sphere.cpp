@@ -19,6 +19,12 @@ namespace lightwave
          
         // tangent is always parallel to the surface. for sphere, any vector perpendicular to the normal is tangent
         surf.frame.tangent = surf.frame.normal.cross(cv).normalized();
+        if (!(surf.frame.tangent.lengthSquared() > 0)) {
+            // the normal is parallel to the chosen axis (e.g., at [0,0,-1]), so any other axis works
+            cv = Vector(0.f, 0.f, 0.f);
+            cv[(Vector(position).minComponentIndex() + 1) % 3] = 1.0f;
+            surf.frame.tangent = surf.frame.normal.cross(cv).normalized();
+        }
 
         // bitagent is always orthogonal to both the normal and the tangent. according to convention, its defined as normal X tangent
         surf.frame.bitangent = surf.frame.normal.cross(surf.frame.tangent);
@@ -30,6 +36,13 @@ namespace lightwave
         surf.pdf = 1 / (4 * Pi);
     }
     
+    /// @brief The solid angle of the sphere as seen from a point outside of it.
+    static float coneSolidAngle(float distanceSquared) {
+        const float sin2ThetaMax = 1 / distanceSquared;
+        // avoids cancellation for small cones
+        return 2 * Pi * sin2ThetaMax / (1 + safe_sqrt(1 - sin2ThetaMax));
+    }
+
     public:
         Sphere(const Properties &properties) {
         }
@@ -68,12 +81,64 @@ namespace lightwave
             return Point(0.f, 0.f, 0.f);
         } 
         AreaSample sampleArea(Sampler &rng) const override{
-            Vector p = Vector(rng.next(), rng.next(), rng.next()).normalized();
+            const Vector p = squareToUniformSphere(rng.next2D());
 
             AreaSample sample;
             populate(sample, p);
             return sample;
-        } 
+        }
+        AreaSample sampleArea(const Point &origin, Sampler &rng) const override {
+            // points inside the sphere see all of it
+            const float distanceSquared = Vector(origin).lengthSquared();
+            if (distanceSquared <= 1) return sampleArea(rng);
+
+            // sample the cone of directions towards the sphere uniformly, and find the point the direction hits first
+            const float distance = std::sqrt(distanceSquared);
+            const float oneMinusCosThetaMax = coneSolidAngle(distanceSquared) / (2 * Pi);
+            const Point2 rnd = rng.next2D();
+            const float oneMinusCosTheta = rnd.x() * oneMinusCosThetaMax;
+            const float cosTheta = 1 - oneMinusCosTheta;
+            const float sin2Theta = oneMinusCosTheta * (2 - oneMinusCosTheta);
+            const float cosAlpha = sin2Theta * distance + cosTheta * safe_sqrt(1 - sin2Theta * distanceSquared);
+            const float sinAlpha = safe_sqrt(1 - sqr(cosAlpha));
+            const float phi = 2 * Pi * rnd.y();
+
+            const Frame frame { -Vector(origin) / distance };
+            const Vector normal = frame.toWorld(-Vector(sinAlpha * std::cos(phi), sinAlpha * std::sin(phi), cosAlpha));
+
+            AreaSample sample;
+            populate(sample, Point(normal));
+            sample.pdf = areaPdf(origin, sample);
+            return sample;
+        }
+        float areaPdf(const Point &origin, const SurfaceEvent &surface) const override {
+            const Point &position = surface.position;
+            const float distanceSquared = Vector(origin).lengthSquared();
+            if (distanceSquared <= 1) return 1 / (4 * Pi);
+
+            // convert the uniform density in the solid angle of the cone to area
+            const Vector offset = origin - position;
+            const float cosTheta = Vector(position).dot(offset);
+            if (cosTheta <= 0) return 0;
+            return cosTheta / (coneSolidAngle(distanceSquared) * offset.lengthSquared() * offset.length());
+        }
+        float area() const override {
+            return 4 * Pi;
+        }
+        AreaSample sampleTexture(const Point2 &uv) const override {
+            // invert the mapping of populate, where v is proportional to the latitude and u to the longitude
+            const float latitude = Pi * (uv.y() - 0.5f);
+            const float longitude = 2 * Pi * (uv.x() - 0.5f);
+            const float cosLatitude = std::cos(latitude);
+            const Point position { -cosLatitude * std::sin(longitude), -std::sin(latitude),
+                                   -cosLatitude * std::cos(longitude) };
+
+            AreaSample sample;
+            populate(sample, position);
+            // rings of constant latitude shrink towards the poles
+            sample.pdf = cosLatitude > 0 ? 1 / (2 * sqr(Pi) * cosLatitude) : 0;
+            return sample;
+        }
             std::string toString() const override
         {
             return "Sphere[]";
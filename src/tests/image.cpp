@@ -15,6 +15,11 @@ namespace lightwave {
 class CompareImage : public Test {
     /// @brief The integrator to execute and compare against a reference image.
     ref<SamplingIntegrator> m_integrator;
+    /**
+     * @brief An optional post process (e.g., a denoiser) that is executed after the integrator, in which case its output
+     * is compared against the reference instead (the integrator then renders into the images it has been given).
+     */
+    ref<Postprocess> m_postprocess;
     /// @brief The directory the resulting image should be stored to.
     std::filesystem::path m_basePath;
     /// @brief The threshold to compare the MAE (mean absolute error) against.
@@ -27,6 +32,7 @@ class CompareImage : public Test {
 public:
     CompareImage(const Properties &properties) {
         m_integrator = properties.getChild<SamplingIntegrator>();
+        m_postprocess = properties.getOptionalChild<Postprocess>();
         m_thresholdMAE = properties.get<float>("mae", 1e-1);
         m_thresholdME = properties.get<float>("me", 2e-4);
         m_basePath = properties.basePath(); // we store the test image in the same folder as the scene file
@@ -36,11 +42,18 @@ public:
     void execute() override {
         std::filesystem::path referencePath = m_basePath / (id() + "_ref.exr");
 
-        ref<Image> image = std::make_shared<Image>();
-        image->setBasePath(m_basePath);
-        image->setId(id() + "_test");
-        m_integrator->setImage(image);
-        m_integrator->execute();
+        ref<Image> image;
+        if (m_postprocess) {
+            m_integrator->execute();
+            m_postprocess->execute();
+            image = m_postprocess->output();
+        } else {
+            image = std::make_shared<Image>();
+            image->setBasePath(m_basePath);
+            image->setId(id() + "_test");
+            m_integrator->setImage(image);
+            m_integrator->execute();
+        }
 
         if (std::getenv("reference")) {
             image->saveAt(referencePath);
@@ -1,5 +1,7 @@
 #include <lightwave.hpp>
 
+#include "../core/assetcache.hpp"
+
 namespace lightwave {
 
 class ImageTexture : public Texture {
@@ -13,17 +15,50 @@ class ImageTexture : public Texture {
         Bilinear,
     };
 
+    /// @brief The texels, shared with all other textures that use the same file (do not modify).
     ref<Image> m_image;
     float m_exposure;
     BorderMode m_border;
     FilterMode m_filter;
 
+    /// @brief For lazily loaded textures: the file the texels will be read from on first lookup.
+    std::filesystem::path m_lazyPath;
+    /// @brief For lazily loaded textures: whether the file is already in linear color space.
+    bool m_lazyLinear;
+    /// @brief Tracks whether the texels have been loaded (always the case unless the texture is lazy).
+    mutable InitOnce m_residency;
+
+    /// @brief Decodes the image file if this has not happened yet; safe to call concurrently from render threads.
+    void ensureResident() const {
+        m_residency.ensure([&]() {
+            try {
+                const_cast<ImageTexture *>(this)->m_image = AssetCache::global().image(m_lazyPath, m_lazyLinear);
+            } catch (const std::exception &e) {
+                // we are on the render path, where we cannot recover from exceptions
+                logger(EError, "could not load lazy texture %s: %s", m_lazyPath, e.what());
+                abort();
+            }
+        });
+    }
+
 public:
     ImageTexture(const Properties &properties) {
-        if (properties.has("filename")) {
-            m_image = std::make_shared<Image>(properties);
+        if (properties.has("filename") && properties.get<bool>("lazy", false)) {
+            m_lazyPath = properties.get<std::filesystem::path>("filename");
+            m_lazyLinear = properties.get<bool>("linear", false);
+            if (!std::filesystem::is_regular_file(m_lazyPath)) {
+                lightwave_throw("could not find image %s", m_lazyPath);
+            }
+
+            logger(EDebug, "deferring load of %s until first lookup", m_lazyPath);
+        } else if (properties.has("filename")) {
+            m_image = AssetCache::global().image(
+                properties.get<std::filesystem::path>("filename"),
+                properties.get<bool>("linear", false));
+            m_residency.ensure([]() {});
         } else {
             m_image = properties.getChild<Image>();
+            m_residency.ensure([]() {});
         }
         m_exposure = properties.get<float>("exposure", 1);
 
@@ -43,6 +78,8 @@ public:
     }
 
     Color evaluate(const Point2 &uv) const override {
+        ensureResident();
+
         double u, v;
 
         Point2i res = (m_image -> resolution());
@@ -105,6 +142,11 @@ public:
         return ((lu * lv * pix00) + (lu * dy * pix01) + (dx * lv * pix10) + (dx * dy * pix11)) * m_exposure;
     }
 
+    std::optional<Point2i> resolution() const override {
+        ensureResident();
+        return m_image->resolution();
+    }
+
     std::string toString() const override {
         return tfm::format("ImageTexture[\n"
                            "  image = %s,\n"